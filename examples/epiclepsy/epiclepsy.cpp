@@ -24,6 +24,7 @@
 #include "epiclepsy.h"
 #include "showSpectrumHandler.h"
 #include <dspmanager.h>
+#include <dsp/fftPlanCache.h>
 #include <argexception.h>
 #include <SDL_opengl.h>
 #include <unistd.h>
@@ -33,12 +34,14 @@ epiclepsy::epiclepsy(visualiserWin* win, int argc, char* argv[]) : visualiser(wi
 {
 	int noSampleSets = 1;
 	int noLines = 200;
+	bool useFilterBank = false;
+	int noThreads = 1;
 	char opt;
 
 	// Supress errors.
 	opterr = 0;
 	optind = 1;
-	while((opt = getopt(argc, argv, "b:n:")) != -1)
+	while((opt = getopt(argc, argv, "b:n:it:")) != -1)
 	{
 		switch(opt)
 		{
@@ -54,6 +57,15 @@ epiclepsy::epiclepsy(visualiserWin* win, int argc, char* argv[]) : visualiser(wi
 				else
 					throw(argException("-n expects a parameter."));
 				break;
+			case 'i':
+				useFilterBank = true;
+				break;
+			case 't':
+				if(optarg != NULL)
+					noThreads = atoi(optarg);
+				else
+					throw(argException("-t expects a parameter."));
+				break;
 		}
 	}
 
@@ -63,11 +75,24 @@ epiclepsy::epiclepsy(visualiserWin* win, int argc, char* argv[]) : visualiser(wi
 		throw(argException("Song was not specified."));
 	}
 
+	// Big transforms can be split over threads.
+	if(noThreads > 1 && !fftPlanCache::setThreads(noThreads))
+		throw(argException("-t needs FFTW to be built with threads."));
+
 	// this plug-in needs the FFT DSP, set that up here.
 	FFT* fftPlugin = new FFT(noSampleSets);
 	this->fftPlugin = fftPlugin;
 	win->getDSPManager()->registerDSPPlugin(fftPlugin);
 
+	// The filter bank follows the audio much more closely than the
+	// FFT so use it for the background colour if asked to.
+	filterBankPlugin = NULL;
+	if(useFilterBank)
+	{
+		filterBankPlugin = new FilterBank();
+		win->getDSPManager()->registerDSPPlugin(filterBankPlugin);
+	}
+
 	// Set local member variables.
 	this->noLinesToDraw = noLines;
 	
@@ -91,14 +116,19 @@ std::string epiclepsy::usage()
 	theArgs += "-n      This is the number of bars that are shown on the screen\n";
 	theArgs += "        when the 'v' key is pressed and the FFT visualisation is\n";
 	theArgs += "        enabled. The default is 200 bars. If zero is set, the whole\n";
-	theArgs += "        FFT frequency spectrum is shown.";
+	theArgs += "        FFT frequency spectrum is shown.\n";
+	theArgs += "-i      Colour the background with a bank of filters rather than the\n";
+	theArgs += "        FFT, which reacts to the music much faster.\n";
+	theArgs += "-t      The number of threads the FFT is split over when it is large,\n";
+	theArgs += "        which helps with high -b values. mattuliser-fftbench shows\n";
+	theArgs += "        whether it is worth it. The default is 1 thread.";
 	return theArgs;
 }
 
 std::string epiclepsy::usageSmall()
 {
 	std::string theSmallUsage;
-	theSmallUsage = "-b SAMPLE_SETS -n NUMBER_OF_BARS";
+	theSmallUsage = "-b SAMPLE_SETS -n NUMBER_OF_BARS -i -t THREADS";
 	return theSmallUsage;
 }
 
@@ -120,6 +150,10 @@ void epiclepsy::draw()
 		// Check the number of lines to draw.
 		if(noLinesToDraw == 0)
 			noLinesToDraw = data->dataLength;
+
+		// At lower quality levels only draw every few lines, the
+		// averages still use all of them.
+		int lineStep = (int)(1.0f / getQualityScale() + 0.5f);
 		for(int i = 0; i < noLinesToDraw; i++)
 		{
 			// find the argument of the complex number.
@@ -130,7 +164,7 @@ void epiclepsy::draw()
 			complexArg = complexArg / 2000000;
 			
 			// the bottom of the screen in clip co-ordinates is at x=-1. Start from the bottom
-			if(showSpectrum)
+			if(showSpectrum && i % lineStep == 0)
 			{
 				glBegin(GL_LINES);
 				GLfloat xPos = (GLfloat)((i - (float)(noLinesToDraw / 2)) /((float)noLinesToDraw / 2));
@@ -161,9 +195,35 @@ void epiclepsy::draw()
 		hiAvg = hiAvg / 60;
 		
 		// Set the background colour.
-		glClearColor(lowerAvg, medAvg, hiAvg, 1.0f);
+		if(filterBankPlugin == NULL)
+			glClearColor(lowerAvg, medAvg, hiAvg, 1.0f);
+
+		// release the DSP data.
+		fftPlugin->relenquishDSPData();
+	}
+
+	if(filterBankPlugin != NULL)
+	{
+		FilterBankData* bands = (FilterBankData*)filterBankPlugin->getDSPData();
+		if(bands != NULL)
+		{
+			// Split the bands into bass, middle and treble.
+			GLfloat colour[3] = {0, 0, 0};
+			int count[3] = {0, 0, 0};
+			for(int i = 0; i < bands->noBands; i++)
+			{
+				int c = bands->frequencies[i] < 250 ? 0 :
+				        bands->frequencies[i] < 4000 ? 1 : 2;
+				colour[c] += bands->envelope[i];
+				count[c]++;
+			}
+			for(int c = 0; c < 3; c++)
+				if(count[c] > 0)
+					colour[c] = (colour[c] * 2) / count[c];
+
+			// Set the background colour.
+			glClearColor(colour[0], colour[1], colour[2], 1.0f);
+			filterBankPlugin->relenquishDSPData();
+		}
 	}
-	
-	// release the DSP data.
-	fftPlugin->relenquishDSPData();
 }
@@ -27,6 +27,7 @@
 #include <visualiser.h>
 #include <visualiserWin.h>
 #include <dsp/fft.h>
+#include <dsp/filterBank.h>
 
 /**
  * This is a simple visualiser class that
@@ -62,6 +63,12 @@ class epiclepsy : public visualiser
 		 */
 		FFT* fftPlugin;
 
+		/**
+		 * The filter bank used for the background colour, or NULL
+		 * to use the FFT.
+		 */
+		FilterBank* filterBankPlugin;
+
 		int noLinesToDraw;
 };
 
@@ -25,6 +25,7 @@
 #include "../../src/dspmanager.h"
 #include <SDL_opengl.h>
 #include <math.h>
+#include <stdlib.h>
 
 #define OFFSET 0.1
 
@@ -39,6 +40,16 @@ epicpcm::epicpcm(visualiserWin* win) : visualiser(win)
 	PCM* pcmPlugin = new PCM();
 	this->pcmPlugin = pcmPlugin;
 	win->getDSPManager()->registerDSPPlugin(pcmPlugin);
+
+	// Draw a line for each column of pixels.
+	columns = win->width;
+	pcmPlugin->setEnvelopeColumns(columns);
+	vertices = (GLfloat*)calloc(columns * 4, sizeof(GLfloat));
+}
+
+epicpcm::~epicpcm()
+{
+	free(vertices);
 }
 
 
@@ -89,30 +100,29 @@ void epicpcm::draw()
 		
 		// also draw the PCM data.
 		PCMData* pData = (PCMData*)pcmPlugin->getDSPData();
-		if(pData != NULL)
+		if(pData != NULL && pData->envelopeLength == columns)
 		{
-			glBegin(GL_LINES);
-			
-			// loop through each of the samples.
-			for(int i = 0; i < pData->dataLength; i++)
+			// loop through each of the columns.
+			for(int i = 0; i < columns; i++)
 			{
 				// calculate the distance along the x-axis for this line.
-				GLfloat xPos = (i - (pData->dataLength / 2));
-				xPos = xPos / (pData->dataLength / 2.0f);
-				
-				
-				// calculate the sample value, given that it's signed 32bit PCM,
-				// there is a max value of -32768 - 32768.
-				GLfloat samplePoint = pData->data[i] / 32768.0f;
-				
-				// calculate the colour of the bar, inverse to the colours above.
-				glColor3f((lowerAvg + OFFSET), (medAvg + OFFSET), (hiAvg + OFFSET));
-				
-				// set the vertices.
-				//glVertex3f(xPos , 0.0f, 0);
-				glVertex3f(xPos , samplePoint, 0);
+				GLfloat xPos = (i - (columns / 2));
+				xPos = xPos / (columns / 2.0f);
+
+				// calculate the range of the samples, given that they're
+				// signed 16bit PCM, there is a max value of -32768 - 32768.
+				vertices[(i * 4)] = xPos;
+				vertices[(i * 4) + 1] = pData->envelopeMin[i] / 32768.0f;
+				vertices[(i * 4) + 2] = xPos;
+				vertices[(i * 4) + 3] = pData->envelopeMax[i] / 32768.0f;
 			}
-			glEnd();
+
+			// draw with the inverse colour to the background.
+			glColor3f((lowerAvg + OFFSET), (medAvg + OFFSET), (hiAvg + OFFSET));
+			glEnableClientState(GL_VERTEX_ARRAY);
+			glVertexPointer(2, GL_FLOAT, 0, vertices);
+			glDrawArrays(GL_LINES, 0, columns * 2);
+			glDisableClientState(GL_VERTEX_ARRAY);
 		}
 	}
 	
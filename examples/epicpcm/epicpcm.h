@@ -42,6 +42,8 @@ class epicpcm : public visualiser
 		 * construct the plugin.
 		 */
 		epicpcm(visualiserWin* win);
+
+		~epicpcm();
 		
 		/**
 		 * This function is called by the main thread to draw
@@ -54,6 +56,13 @@ class epicpcm : public visualiser
 		 */
 		FFT* fftPlugin;
 		PCM* pcmPlugin;
+
+		/**
+		 * The number of columns that the waveform is drawn in, and
+		 * the vertex array used to draw them.
+		 */
+		int columns;
+		float* vertices;
 };
 
 #endif
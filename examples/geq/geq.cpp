@@ -40,16 +40,15 @@ void geq::draw()
 	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 	glClear(GL_COLOR_BUFFER_BIT);
 	
-	// retrieve audio data.
-	FFTData* data = (FFTData*)fftPlugin->getDSPData();
+	// retrieve audio data for when this frame is shown.
+	FFTData* data = (FFTData*)fftPlugin->getDSPDataAt(win->getFrameTime());
 	if(data != NULL)
 	{
 		// loop through each of the frequency domain values.
 		for(int i = 0; i < data->dataLength; i++)
 		{
-			// find the argument of the complex number.
-			GLfloat complexArg = (GLfloat)sqrtf(pow(data->data[i][0], 2) +
-			                                    pow(data->data[i][1], 2));
+			// get the argument of the complex number.
+			GLfloat complexArg = data->magnitude[i];
 			
 			// scale the data.
 			complexArg = complexArg / 2000000;
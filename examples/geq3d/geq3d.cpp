@@ -113,9 +113,12 @@ void geq3d::draw()
 			glEnd();
 		}
 
-		// If this list is full, then get rid of the
-		// last element.
-		if(fftDataList.size() == desiredListLength)
+		// If this list is full, then get rid of the last
+		// elements. Less history is kept at lower quality levels.
+		size_t depth = (size_t)(desiredListLength * getQualityScale());
+		if(depth < 2)
+			depth = 2;
+		while(fftDataList.size() >= depth)
 		{
 			FFTData* element = (FFTData*)fftDataList.back();
 			fftDataList.pop_back();
@@ -25,6 +25,7 @@
 #include "../../src/dspmanager.h"
 #include <SDL_opengl.h>
 #include <math.h>
+#include <stdlib.h>
 
 pcm::pcm(visualiserWin* win) : visualiser(win)
 {
@@ -32,6 +33,18 @@ pcm::pcm(visualiserWin* win) : visualiser(win)
 	PCM* pcmPlugin = new PCM();
 	this->pcmPlugin = pcmPlugin;
 	win->getDSPManager()->registerDSPPlugin(pcmPlugin);
+
+	// Draw a line for each column of pixels.
+	columns = win->width;
+	pcmPlugin->setEnvelopeColumns(columns);
+	vertices = (GLfloat*)calloc(columns * 4, sizeof(GLfloat));
+	colours = (GLfloat*)calloc(columns * 6, sizeof(GLfloat));
+}
+
+pcm::~pcm()
+{
+	free(vertices);
+	free(colours);
 }
 
 void pcm::draw()
@@ -42,30 +55,43 @@ void pcm::draw()
 	
 	// retrieve audio data.
 	PCMData* data = (PCMData*)pcmPlugin->getDSPData();
-	if(data != NULL)
+	if(data != NULL && data->envelopeLength == columns)
 	{
-			glBegin(GL_LINES);
-		// loop through each of the samples.
-		for(int i = 1; i < data->dataLength; i++)
+		// loop through each of the columns.
+		for(int i = 0; i < columns; i++)
 		{
-			
 			// calculate the distance along the x-axis for this line.
-			GLfloat xPos = (i - (data->dataLength / 2));
-			xPos = xPos / (data->dataLength / 2.0f);
-			
-			
-			// calculate the sample value, given that it's signed 32bit PCM,
-			// there is a max value of -32768 - 32768.
-			GLfloat samplePoint = data->data[i] / 32768.0f;
-			
-			// calculate the colour of the bar, based on the value.
-			glColor3f(fabs(samplePoint), 1 - fabs(samplePoint), 0.0f);
-			
+			GLfloat xPos = (i - (columns / 2));
+			xPos = xPos / (columns / 2.0f);
+
+			// calculate the range of the samples, given that they're
+			// signed 16bit PCM, there is a max value of -32768 - 32768.
+			GLfloat low = data->envelopeMin[i] / 32768.0f;
+			GLfloat high = data->envelopeMax[i] / 32768.0f;
+			GLfloat peak = fabs(low) > fabs(high) ? fabs(low) : fabs(high);
+
 			// set the vertices.
-			//glVertex3f(xPos , 0.0f, 0);
-			glVertex3f(xPos , samplePoint, 0);
+			vertices[(i * 4)] = xPos;
+			vertices[(i * 4) + 1] = low;
+			vertices[(i * 4) + 2] = xPos;
+			vertices[(i * 4) + 3] = high;
+
+			// calculate the colour of the bar, based on the value.
+			for(int j = 0; j < 2; j++)
+			{
+				colours[(i * 6) + (j * 3)] = peak;
+				colours[(i * 6) + (j * 3) + 1] = 1 - peak;
+				colours[(i * 6) + (j * 3) + 2] = 0.0f;
+			}
 		}
-			glEnd();
+
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glEnableClientState(GL_COLOR_ARRAY);
+		glVertexPointer(2, GL_FLOAT, 0, vertices);
+		glColorPointer(3, GL_FLOAT, 0, colours);
+		glDrawArrays(GL_LINES, 0, columns * 2);
+		glDisableClientState(GL_COLOR_ARRAY);
+		glDisableClientState(GL_VERTEX_ARRAY);
 	}
 	
 	// release the DSP data.
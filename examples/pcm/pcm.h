@@ -39,6 +39,8 @@ class pcm : public visualiser
 		 * construct the plugin.
 		 */
 		pcm(visualiserWin* win);
+
+		~pcm();
 		
 		/**
 		 * This function is called by the main thread to draw
@@ -51,6 +53,14 @@ class pcm : public visualiser
 		 * The PCM plugin used to get DSP data.
 		 */
 		PCM* pcmPlugin;
+
+		/**
+		 * The number of columns that the waveform is drawn in, and
+		 * the vertex arrays used to draw them.
+		 */
+		int columns;
+		float* vertices;
+		float* colours;
 };
 
 #endif
@@ -25,43 +25,34 @@
 #include "../../src/dspmanager.h"
 #include <SDL_opengl.h>
 #include <math.h>
+#include <stdlib.h>
+#include <time.h>
 
 #define DEG2RAD 0.0174532925
 
 poly::poly(visualiserWin* win, int no_vertices, double step, bool changeColour)
-: visualiser(win), threshold(3500000)
+: visualiser(win), threshold(0.1f)
 {
-	// this plug-in needs the FFT DSP, set that up here.
-	FFT* fftPlugin = new FFT();
-	this->fftPlugin = fftPlugin;
-	win->getDSPManager()->registerDSPPlugin(fftPlugin);
+	// this plug-in follows the bass with a sliding DFT, set that up here.
+	std::vector<float> bassFrequencies;
+	for(int i = 0; i < 4; i++)
+		bassFrequencies.push_back(40.0f + (20.0f * i));
+	bassPlugin = new SlidingDFT(bassFrequencies);
+	win->getDSPManager()->registerDSPPlugin(bassPlugin);
 	this->no_vertices = no_vertices;
 	this->step = step;
 	this->changeColour = changeColour;
 	hasChanged = false;
-	srand(time(NULL));
-	vec_x = (float*)calloc(no_vertices, sizeof(float));
-	vec_y = (float*)calloc(no_vertices, sizeof(float));
-	vec_dir_x = (float*)calloc(no_vertices, sizeof(float));
-	vec_dir_y = (float*)calloc(no_vertices, sizeof(float));
-	red = (float*)calloc(no_vertices, sizeof(float));
-	green = (float*)calloc(no_vertices, sizeof(float));
-	blue = (float*)calloc(no_vertices, sizeof(float));
-	for(int i = 0; i < no_vertices; i++)
-	{
-		vec_x[i] = (getRand() * 2) - 1;
-		vec_y[i] = (getRand() * 2) - 1;
-		vec_dir_x[i] = (getRand() * 2) - 1;
-		vec_dir_y[i] = (getRand() * 2) - 1;
-		red[i] = getRand();
-		green[i] = getRand();
-		blue[i] = getRand();
-	}
+	vertices = new particles(no_vertices, time(NULL));
+	positions = (float*)calloc(no_vertices * 2, sizeof(float));
+	colours = (float*)calloc(no_vertices * 3, sizeof(float));
 }
 
-double poly::getRand()
+poly::~poly()
 {
-	return (double)rand() / RAND_MAX;
+	delete vertices;
+	free(positions);
+	free(colours);
 }
 
 void poly::draw()
@@ -70,32 +61,20 @@ void poly::draw()
 	glClear(GL_COLOR_BUFFER_BIT);
 	
 	// retrieve audio data.
-	FFTData* data = (FFTData*)fftPlugin->getDSPData();
+	SDFTData* data = (SDFTData*)bassPlugin->getDSPDataAt(win->getFrameTime());
 	if(data != NULL)
 	{
 		float total = 0;
-		for(int i = 0; i < 3; i++)
-		{
-			float complexArg = (float)sqrt(pow(data->data[i][0], 2) +
-			                               pow(data->data[i][1], 2));
-			total += complexArg;
-		}
-		total /= 3;
+		for(int i = 0; i < data->noBins; i++)
+			total += data->magnitude[i];
+		total /= data->noBins;
 		if(total > threshold)
 		{
 			if(!hasChanged)
 			{
-				for(int i = 0; i < no_vertices; i++)
-				{
-					vec_dir_x[i] = (getRand() * 2) - 1;
-					vec_dir_y[i] = (getRand() * 2) - 1;
-					if(changeColour)
-					{
-						red[i] = getRand();
-						green[i] = getRand();
-						blue[i] = getRand();
-					}
-				}
+				vertices->randomiseDirections();
+				if(changeColour)
+					vertices->randomiseColours();
 				hasChanged = true;
 			}
 		}
@@ -103,22 +82,22 @@ void poly::draw()
 		{
 			hasChanged = false;
 		}
+
+		// release the DSP data.
+		bassPlugin->relenquishDSPData();
 	}
-	glBegin(GL_LINE_LOOP);
-	for(int i = 0; i < no_vertices; i++)
-	{
-		// Calculate the new position of the vertex.
-		vec_x[i] = (step * vec_dir_x[i]) + vec_x[i];
-		vec_y[i] = (step * vec_dir_y[i]) + vec_y[i];
-		if(vec_x[i] <= -1 || vec_x[i] >= 1)
-			vec_dir_x[i] = copysign(vec_dir_x[i], -vec_x[i]);
-		if(vec_y[i] < -1 || vec_y[i] >= 1)
-			vec_dir_y[i] = copysign(vec_dir_y[i], -vec_y[i]);
-		glColor3f(red[i], green[i], blue[i]);
-		glVertex3f(vec_x[i], vec_y[i], 0.0f);
-	}
-	glEnd();
-	
-	// release the DSP data.
-	fftPlugin->relenquishDSPData();
+
+	// Calculate the new positions of the vertices.
+	vertices->step(step);
+
+	// Draw the shape in one go.
+	vertices->packPositions(positions);
+	vertices->packColours(colours);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	glVertexPointer(2, GL_FLOAT, 0, positions);
+	glColorPointer(3, GL_FLOAT, 0, colours);
+	glDrawArrays(GL_LINE_LOOP, 0, no_vertices);
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
 }
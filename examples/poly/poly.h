@@ -26,8 +26,9 @@
 
 #include "../../src/visualiser.h"
 #include "../../src/visualiserWin.h"
-#include "../../src/dsp/fft.h"
+#include "../../src/dsp/slidingDFT.h"
 #include "../../src/dsp/pcm.h"
+#include "../../src/util/particles.h"
 
 /**
  * This is a simple visualiser class that
@@ -42,6 +43,8 @@ public:
 	 * construct the plugin.
 	 */
 	poly(visualiserWin* win, int no_vertices, double step, bool changeColour);
+
+	~poly();
 		
 	/**
 	 * This function is called by the main thread to draw
@@ -49,22 +52,17 @@ public:
 	 */
 	void draw();
 private:
-	double getRand();
 	/**
-	 * The FFT plugin used to get DSP data.
+	 * The sliding DFT plugin used to find the beat.
 	 */
-	FFT* fftPlugin;
-	float* vec_x;
+	SlidingDFT* bassPlugin;
 	const float threshold;
-	float* vec_y;
-	float* vec_dir_x;
-	float* vec_dir_y;
+	particles* vertices;
+	float* positions;
+	float* colours;
 	int no_vertices;
 	double step;
 	bool changeColour;
-	float* red;
-	float* green;
-	float* blue;
 	bool hasChanged;
 };
 
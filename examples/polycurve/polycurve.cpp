@@ -23,81 +23,141 @@
 
 #include "polycurve.h"
 #include "../../src/dspmanager.h"
+#include "../../src/util/alignedAlloc.h"
 #include <SDL_opengl.h>
 #include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <exception>
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
 
 #define DEG2RAD 0.0174532925
 
-double factorial(int n)
+// The number of floats that the rows of the coefficent matrix are
+// padded to a multiple of, the same as the control point vectors.
+#define VECTOR_WIDTH PARTICLES_VECTOR_WIDTH
+
+/**
+ * Calculate a Bernstein basis polynomial, the weight of control point
+ * k of a curve of degree n at t. This is worked out from logarithms so
+ * that the binomial coefficent doesn't overflow for large n.
+ * See: http://en.wikipedia.org/wiki/Bernstein_polynomial
+ */
+static double bernstein(int n, int k, double t)
 {
-	//Return the factorial of n (n!).
-	double ans = 1;
-	for(int i = 1; i <= n; i++)
-		ans *= i;
-	return ans;
+	if(t <= 0)
+		return k == 0 ? 1 : 0;
+	if(t >= 1)
+		return k == n ? 1 : 0;
+
+	double logCoefficent = lgamma(n + 1) - lgamma(k + 1) - lgamma(n - k + 1);
+	return exp(logCoefficent + k * log(t) + (n - k) * log(1 - t));
 }
 
-double binco(int n, int k)
+/**
+ * Find the dot products of one row of coefficents with the five
+ * control point vectors. The vectors should be stride floats long.
+ */
+static void evaluatePoint(const float* coefficents, int stride,
+                          const float* x, const float* y,
+                          const float* r, const float* g, const float* b,
+                          float* out)
 {
-	//Return the binormial coefficent of n and k.
-	return factorial(n) / (factorial(k) * factorial(n - k));
+#ifdef __SSE__
+	__m128 sumX = _mm_setzero_ps();
+	__m128 sumY = _mm_setzero_ps();
+	__m128 sumR = _mm_setzero_ps();
+	__m128 sumG = _mm_setzero_ps();
+	__m128 sumB = _mm_setzero_ps();
+	for(int i = 0; i < stride; i += VECTOR_WIDTH)
+	{
+		__m128 c = _mm_load_ps(coefficents + i);
+		sumX = _mm_add_ps(sumX, _mm_mul_ps(c, _mm_load_ps(x + i)));
+		sumY = _mm_add_ps(sumY, _mm_mul_ps(c, _mm_load_ps(y + i)));
+		sumR = _mm_add_ps(sumR, _mm_mul_ps(c, _mm_load_ps(r + i)));
+		sumG = _mm_add_ps(sumG, _mm_mul_ps(c, _mm_load_ps(g + i)));
+		sumB = _mm_add_ps(sumB, _mm_mul_ps(c, _mm_load_ps(b + i)));
+	}
+
+	// Add up the four lanes of each sum. After transposing, each
+	// vector holds one lane from every sum.
+	_MM_TRANSPOSE4_PS(sumX, sumY, sumR, sumG);
+	__m128 sums = _mm_add_ps(_mm_add_ps(sumX, sumY), _mm_add_ps(sumR, sumG));
+	_mm_storeu_ps(out, sums);
+
+	float lanes[VECTOR_WIDTH];
+	_mm_storeu_ps(lanes, sumB);
+	out[4] = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#else
+	float sumX = 0, sumY = 0, sumR = 0, sumG = 0, sumB = 0;
+	for(int i = 0; i < stride; i++)
+	{
+		sumX += coefficents[i] * x[i];
+		sumY += coefficents[i] * y[i];
+		sumR += coefficents[i] * r[i];
+		sumG += coefficents[i] * g[i];
+		sumB += coefficents[i] * b[i];
+	}
+	out[0] = sumX;
+	out[1] = sumY;
+	out[2] = sumR;
+	out[3] = sumG;
+	out[4] = sumB;
+#endif
 }
 
 polycurve::polycurve(visualiserWin* win, int no_vertices, double step, bool changeColour, int resolution)
-: visualiser(win), threshold(3500000)
+: visualiser(win), threshold(0.1f)
 {
-	// this plug-in needs the FFT DSP, set that up here.
-	FFT* fftPlugin = new FFT();
-	this->fftPlugin = fftPlugin;
-	win->getDSPManager()->registerDSPPlugin(fftPlugin);
+	// this plug-in follows the bass with a sliding DFT, set that up here.
+	std::vector<float> bassFrequencies;
+	for(int i = 0; i < 4; i++)
+		bassFrequencies.push_back(40.0f + (20.0f * i));
+	bassPlugin = new SlidingDFT(bassFrequencies);
+	win->getDSPManager()->registerDSPPlugin(bassPlugin);
 	this->no_vertices = no_vertices;
 	this->step = step;
 	this->resolution = resolution;
 	this->changeColour = changeColour;
 	hasChanged = false;
 
-	//Random seed.
-	srand(time(NULL));
-
-	//Allocate vectors.
-	vec_x = (float*)calloc(no_vertices, sizeof(float));
-	vec_y = (float*)calloc(no_vertices, sizeof(float));
-	vec_dir_x = (float*)calloc(no_vertices, sizeof(float));
-	vec_dir_y = (float*)calloc(no_vertices, sizeof(float));
-	red = (float*)calloc(no_vertices, sizeof(float));
-	green = (float*)calloc(no_vertices, sizeof(float));
-	blue = (float*)calloc(no_vertices, sizeof(float));
-	coefficents = (double**)calloc(no_vertices, sizeof(double*));
-
-	double resolutionStep = 1.0 / (double)(resolution - 1);
+	//The control points. Their vectors are padded so that they can
+	//be processed a whole SSE register at a time, the padding is
+	//zero so that it doesn't add anything to the curve.
+	controlPoints = new particles(no_vertices, time(NULL));
+	stride = controlPoints->getStride();
+
+	//The coefficents are stored with a row for each point on the
+	//curve, so each point is found by reading along one row.
+	coefficents = allocAlignedFloats(resolution * stride);
+	if(coefficents == NULL)
+		throw(std::exception());
+	vertices = (float*)calloc(resolution * 2, sizeof(float));
+	colours = (float*)calloc(resolution * 3, sizeof(float));
+
+	double resolutionStep = resolution > 1 ? 1.0 / (double)(resolution - 1) : 0;
 	for(int i = 0; i < no_vertices; i++)
 	{
-		//Generate random data for each control point.
-		vec_x[i] = (getRand() * 2) - 1;
-		vec_y[i] = (getRand() * 2) - 1;
-		vec_dir_x[i] = (getRand() * 2) - 1;
-		vec_dir_y[i] = (getRand() * 2) - 1;
-		red[i] = getRand();
-		green[i] = getRand();
-		blue[i] = getRand();
-
-		//Allocate the line of the coefficents for this control point.
-		coefficents[i] = (double*)calloc(resolution, sizeof(double));
 		for(int j = 0; j < resolution; j++)
 		{
 			//Calculate the coefficent for each control point on the line and for each t value.
 			//See: http://en.wikipedia.org/wiki/B%C3%A9zier_curve
 			//for more info.
-			double coRes = resolutionStep * j;
-			coefficents[i][j] = (double)pow(coRes, i) * pow((1 - coRes), ((no_vertices - 1) - i));
-			coefficents[i][j] *= binco(no_vertices - 1, i);
+			coefficents[(j * stride) + i] =
+				(float)bernstein(no_vertices - 1, i, resolutionStep * j);
 		}
 	}
 }
 
-double polycurve::getRand()
+polycurve::~polycurve()
 {
-	return (double)rand() / RAND_MAX;
+	free(coefficents);
+	free(vertices);
+	free(colours);
+	delete controlPoints;
 }
 
 void polycurve::draw()
@@ -106,33 +166,21 @@ void polycurve::draw()
 	glClear(GL_COLOR_BUFFER_BIT);
 
 	// retrieve audio data.
-	FFTData* data = (FFTData*)fftPlugin->getDSPData();
+	SDFTData* data = (SDFTData*)bassPlugin->getDSPDataAt(win->getFrameTime());
 	if(data != NULL)
 	{
 		float total = 0;
-		for(int i = 0; i < 3; i++)
-		{
-			float complexArg = (float)sqrt(pow(data->data[i][0], 2) +
-			                               pow(data->data[i][1], 2));
-			total += complexArg;
-		}
-		total /= 3;
+		for(int i = 0; i < data->noBins; i++)
+			total += data->magnitude[i];
+		total /= data->noBins;
 
 		if(total > threshold)
 		{
 			if(!hasChanged)
 			{
-				for(int i = 0; i < no_vertices; i++)
-				{
-					vec_dir_x[i] = (getRand() * 2) - 1;
-					vec_dir_y[i] = (getRand() * 2) - 1;
-					if(changeColour)
-					{
-						red[i] = getRand();
-						green[i] = getRand();
-						blue[i] = getRand();
-					}
-				}
+				controlPoints->randomiseDirections();
+				if(changeColour)
+					controlPoints->randomiseColours();
 				hasChanged = true;
 			}
 		}
@@ -140,48 +188,46 @@ void polycurve::draw()
 		{
 			hasChanged = false;
 		}
-	}
 
-	// release the DSP data.
-	fftPlugin->relenquishDSPData();
+		// release the DSP data.
+		bassPlugin->relenquishDSPData();
+	}
 
 	//Update vertex posistions.
-	for(int i = 0; i < no_vertices; i++)
-	{
-		vec_x[i] = (step * vec_dir_x[i]) + vec_x[i];
-		vec_y[i] = (step * vec_dir_y[i]) + vec_y[i];
-		if(vec_x[i] <= -1 || vec_x[i] >= 1)
-			vec_dir_x[i] = copysign(vec_dir_x[i], -vec_x[i]);
-		if(vec_y[i] < -1 || vec_y[i] >= 1)
-			vec_dir_y[i] = copysign(vec_dir_y[i], -vec_y[i]);
-	}
+	controlPoints->step(step);
 
-	glBegin(GL_LINE_STRIP);
-	glColor3f(1.0f, 1.0f, 1.0f);
-	for(int t = 0; t < resolution; t++)
-	{
-		float posX, posY, colRed, colGreen, colBlue;
-		posX = 0;
-		posY = 0;
-		colRed = 0;
-		colGreen = 0;
-		colBlue = 0;
-		for(int i = 0; i < no_vertices; i++)
-		{
-			//For each control point, find the posistions and the colours
-			//of the point, t, from the co-efficents and how much this control point
-			//adds to that property of t.
-			posX += (float)coefficents[i][t] * vec_x[i];
-			posY += (float)coefficents[i][t] * vec_y[i];
-			colRed += (float)coefficents[i][t] * red[i];
-			colGreen += (float)coefficents[i][t] * green[i];
-			colBlue += (float)coefficents[i][t] * blue[i];
-		}
-		//Set the colour of the point, t.
-		glColor3f(colRed, colGreen, colBlue);
+	// At lower quality levels skip some of the points on the curve,
+	// always finishing on the last one.
+	int pointStep = (int)(1.0f / getQualityScale() + 0.5f);
 
-		//Draw the point, t!
-		glVertex3f(posX, posY, 0.0f);
+	//For each point, t, on the curve find the posistion and the
+	//colour from the co-efficents and how much each control point
+	//adds to that property of t.
+	int noPoints = 0;
+	for(int t = 0; t < resolution; t += pointStep)
+	{
+		if(t + pointStep >= resolution)
+			t = resolution - 1;
+
+		float point[5];
+		evaluatePoint(coefficents + (t * stride), stride,
+		              controlPoints->getX(), controlPoints->getY(),
+		              controlPoints->getRed(), controlPoints->getGreen(),
+		              controlPoints->getBlue(), point);
+		vertices[(noPoints * 2)] = point[0];
+		vertices[(noPoints * 2) + 1] = point[1];
+		colours[(noPoints * 3)] = point[2];
+		colours[(noPoints * 3) + 1] = point[3];
+		colours[(noPoints * 3) + 2] = point[4];
+		noPoints++;
 	}
-	glEnd();
+
+	//Draw the curve in one go.
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	glVertexPointer(2, GL_FLOAT, 0, vertices);
+	glColorPointer(3, GL_FLOAT, 0, colours);
+	glDrawArrays(GL_LINE_STRIP, 0, noPoints);
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
 }
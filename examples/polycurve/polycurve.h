@@ -26,8 +26,9 @@
 
 #include "../../src/visualiser.h"
 #include "../../src/visualiserWin.h"
-#include "../../src/dsp/fft.h"
+#include "../../src/dsp/slidingDFT.h"
 #include "../../src/dsp/pcm.h"
+#include "../../src/util/particles.h"
 
 /**
  * This is a simple visualiser class that
@@ -44,30 +45,28 @@ public:
   polycurve(visualiserWin* win, int no_vertices, double step,
             bool changeColour, int resolution);
 
+	~polycurve();
+
 	/**
 	 * This function is called by the main thread to draw
 	 * onto the screen. Here we simply draw the visualiser.
 	 */
 	void draw();
 private:
-	double getRand();
 	/**
-	 * The FFT plugin used to get DSP data.
+	 * The sliding DFT plugin used to find the beat.
 	 */
 	const float threshold;
-	FFT* fftPlugin;
-	double** coefficents; //Coefficents of the curve.
-	float* vec_x; //Control point x cordinate.
-	float* vec_y; //Control point y cordinate.
-	float* vec_dir_x; //Control point x direction.
-	float* vec_dir_y; //Control point y direction.
+	SlidingDFT* bassPlugin;
+	float* coefficents; //Coefficents of the curve, a row for each point.
+	int stride; //The padded length of each row and control point vector.
+	float* vertices; //The posistions of the points on the curve.
+	float* colours; //The colours of the points on the curve.
+	particles* controlPoints; //Control point posistions, directions and colours.
 	int no_vertices; //Number of control points
 	double step; //The step of control point speed.
 	bool changeColour; //Weather we should change the colour.
 	int resolution; //The number of vertices to draw as the curve.
-	float* red; //Red colour vector.
-	float* green; //Green colour vector.
-	float* blue; //Blue colour vector.
 	bool hasChanged; //Weather the beat has changed.
 };
 
@@ -154,6 +154,14 @@ shaders::shaders(visualiserWin* win, int argc, char* argv[]) : visualiser(win)
 	this->fftPlugin = fftPlugin;
 	win->getDSPManager()->registerDSPPlugin(fftPlugin);
 
+	// and the pitch DSP.
+	pitchPlugin = new Pitch();
+	win->getDSPManager()->registerDSPPlugin(pitchPlugin);
+
+	// and the meter DSP.
+	meterPlugin = new Meter();
+	win->getDSPManager()->registerDSPPlugin(meterPlugin);
+
 	// Load and compiler the shader.
 	initShaders(shaderProgram);
 
@@ -172,6 +180,13 @@ std::string shaders::usage()
 	theArgs += "==================\n";
 	theArgs += "\n";
 	theArgs += "-S      The path to GLSL code to use as the fragment shader.\n";
+	theArgs += "\n";
+	theArgs += "The shader is given the uniforms time, resolution, fftAvg, the\n";
+	theArgs += "average of the bass, middle and treble, and pitch, the pitch in Hz\n";
+	theArgs += "and how sure it is from 0 to 1. The pitch is 0 if none is found.\n";
+	theArgs += "The meter uniform is the RMS and true peak of the latest block, the\n";
+	theArgs += "short term loudness in LUFS and the same loudness as an amplitude,\n";
+	theArgs += "which the other levels can be divided by to suit any track.\n";
 	return theArgs;
 }
 
@@ -225,6 +240,24 @@ void shaders::draw()
 	glUniform3f(glGetUniformLocation(program, "fftAvg"),
 	            lowAvg, medAvg, highAvg);
 
+	// The pitch is only updated when there is a new one, the shader
+	// keeps the last value.
+	PitchData* pitch = (PitchData*)pitchPlugin->getDSPData();
+	if(pitch != NULL)
+	{
+		glUniform2f(glGetUniformLocation(program, "pitch"),
+		            pitch->frequency, pitch->confidence);
+		pitchPlugin->relenquishDSPData();
+	}
+
+	MeterData* meter = (MeterData*)meterPlugin->getDSPData();
+	if(meter != NULL)
+	{
+		glUniform4f(glGetUniformLocation(program, "meter"),
+		            meter->rms, meter->truePeak, meter->shortTerm, meter->level);
+		meterPlugin->relenquishDSPData();
+	}
+
 	glUniform2f(glGetUniformLocation(program, "resolution"),
 	            window->width, window->height);
 
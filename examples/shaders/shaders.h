@@ -30,6 +30,8 @@
 #include <visualiser.h>
 #include <visualiserWin.h>
 #include <dsp/fft.h>
+#include <dsp/pitch.h>
+#include <dsp/meter.h>
 
 /**
  * This is a simple visualiser class that
@@ -66,6 +68,16 @@ private:
 	 * The FFT plugin used to get DSP data.
 	 */
 	FFT* fftPlugin;
+
+	/**
+	 * The pitch plugin used for the pitch uniform.
+	 */
+	Pitch* pitchPlugin;
+
+	/**
+	 * The meter plugin used for the meter uniform.
+	 */
+	Meter* meterPlugin;
 };
 
 #endif
@@ -194,9 +194,12 @@ void surface::draw()
 			pAllData = (*i);
 		}
 
-		// If this list is full, then get rid of the
-		// last element.
-		if(fftDataList.size() == desiredListLength)
+		// If this list is full, then get rid of the last
+		// elements. Less history is kept at lower quality levels.
+		size_t depth = (size_t)(desiredListLength * getQualityScale());
+		if(depth < 2)
+			depth = 2;
+		while(fftDataList.size() >= depth)
 		{
 			struct allData* d = fftDataList.back();
 			FFTData* element = (FFTData*)d->fftData;
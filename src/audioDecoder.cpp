@@ -0,0 +1,270 @@
+/****************************************
+ *
+ * audioDecoder.cpp
+ * Define a decoder that reads the audio from a file.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "audioDecoder.h"
+#include "dsp/analysisCache.h"
+extern "C"{
+#include <libavcodec/avcodec.h>
+#include <libavutil/opt.h>
+#include <libavformat/avformat.h>
+#include <libswresample/swresample.h>
+}
+
+pthread_mutex_t audioDecoder::avMutex = PTHREAD_MUTEX_INITIALIZER;
+
+audioDecoder::audioDecoder(const std::string& file)
+{
+	this->file = file;
+	fmtCtx = NULL;
+	codecCtx = NULL;
+	frame = NULL;
+	swr = NULL;
+	audioStream = -1;
+	stopped = false;
+	format.sampleRate = 0;
+	format.sampleFormat = PCM_S16;
+	format.channels = 0;
+	pendingOffset = 0;
+}
+
+audioDecoder::~audioDecoder()
+{
+	close();
+}
+
+bool audioDecoder::open()
+{
+	close();
+
+	pthread_mutex_lock(&avMutex);
+	av_register_all();
+	pthread_mutex_unlock(&avMutex);
+
+	if(avformat_open_input(&fmtCtx, file.c_str(), NULL, NULL) != 0)
+	{
+		fmtCtx = NULL;
+		return false;
+	}
+
+	if(avformat_find_stream_info(fmtCtx, NULL) < 0)
+	{
+		close();
+		return false;
+	}
+
+	for(unsigned int i = 0; i < fmtCtx->nb_streams; i++)
+	{
+		if(fmtCtx->streams[i]->codec->codec_type ==
+		   AVMEDIA_TYPE_AUDIO)
+		{
+			audioStream = i;
+			break;
+		}
+	}
+
+	if(audioStream == -1)
+	{
+		close();
+		return false;
+	}
+
+	AVCodecContext* ctx = fmtCtx->streams[audioStream]->codec;
+	AVCodec* codec = avcodec_find_decoder(ctx->codec_id);
+	if(!codec)
+	{
+		close();
+		return false;
+	}
+
+	pthread_mutex_lock(&avMutex);
+	int ret = avcodec_open2(ctx, codec, NULL);
+	pthread_mutex_unlock(&avMutex);
+	if(ret < 0)
+	{
+		close();
+		return false;
+	}
+	codecCtx = ctx;
+
+	format.sampleRate = codecCtx->sample_rate;
+	format.sampleFormat = PCM_S16;
+	format.channels = codecCtx->channels > 1 ? 2 : 1;
+	if(!initResampler())
+	{
+		close();
+		return false;
+	}
+
+	frame = av_frame_alloc();
+	return true;
+}
+
+void audioDecoder::close()
+{
+	if(frame)
+		av_frame_free(&frame);
+	if(swr)
+		swr_free(&swr);
+	if(codecCtx)
+	{
+		pthread_mutex_lock(&avMutex);
+		avcodec_close(codecCtx);
+		pthread_mutex_unlock(&avMutex);
+		codecCtx = NULL;
+	}
+	if(fmtCtx)
+		avformat_close_input(&fmtCtx);
+
+	audioStream = -1;
+	pending.clear();
+	pendingOffset = 0;
+}
+
+audioSourceMode audioDecoder::getMode() const
+{
+	return AUDIO_SOURCE_PULL;
+}
+
+const pcmFormat& audioDecoder::getFormat() const
+{
+	return format;
+}
+
+bool audioDecoder::setOutputFormat(int sampleRate, int channels)
+{
+	if(!codecCtx || sampleRate <= 0 || channels < 1 || channels > 2)
+		return false;
+
+	format.sampleRate = sampleRate;
+	format.channels = channels;
+	pending.clear();
+	pendingOffset = 0;
+	return initResampler();
+}
+
+uint64_t audioDecoder::getTrackHash() const
+{
+	return analysisCache::hashFile(file);
+}
+
+void audioDecoder::stop()
+{
+	__atomic_store_n(&stopped, true, __ATOMIC_RELEASE);
+}
+
+bool audioDecoder::isStopped() const
+{
+	return __atomic_load_n(&stopped, __ATOMIC_ACQUIRE);
+}
+
+bool audioDecoder::initResampler()
+{
+	if(swr)
+		swr_free(&swr);
+
+	// Some containers don't say what the channels are.
+	int64_t layout = codecCtx->channel_layout;
+	if(layout == 0)
+		layout = av_get_default_channel_layout(codecCtx->channels);
+
+	swr = swr_alloc();
+	av_opt_set_int(swr, "in_channel_layout",  layout, 0);
+	av_opt_set_int(swr, "out_channel_layout",
+	               format.channels == 2 ? AV_CH_LAYOUT_STEREO : AV_CH_LAYOUT_MONO, 0);
+	av_opt_set_int(swr, "in_sample_rate", codecCtx->sample_rate, 0);
+	av_opt_set_int(swr, "out_sample_rate", format.sampleRate, 0);
+	av_opt_set_sample_fmt(swr, "in_sample_fmt", codecCtx->sample_fmt, 0);
+	av_opt_set_sample_fmt(swr, "out_sample_fmt", AV_SAMPLE_FMT_S16,  0);
+	return swr_init(swr) >= 0;
+}
+
+int audioDecoder::read(int16_t* buffer, int noFrames)
+{
+	if(!codecCtx)
+		return 0;
+
+	size_t wanted = (size_t)noFrames * format.channels;
+	size_t copied = 0;
+	while(copied < wanted && !isStopped())
+	{
+		if(pendingOffset == pending.size())
+		{
+			pending.clear();
+			pendingOffset = 0;
+			if(!decodePacket())
+				break;
+			continue;
+		}
+
+		size_t n = pending.size() - pendingOffset;
+		if(n > wanted - copied)
+			n = wanted - copied;
+		memcpy(buffer + copied, &pending[pendingOffset], n * sizeof(int16_t));
+		pendingOffset += n;
+		copied += n;
+	}
+
+	return copied / format.channels;
+}
+
+bool audioDecoder::decodePacket()
+{
+	AVPacket packet;
+	while(av_read_frame(fmtCtx, &packet) >= 0)
+	{
+		if(packet.stream_index != audioStream)
+		{
+			av_free_packet(&packet);
+			continue;
+		}
+
+		int frameDecoded = 0;
+		int ret = avcodec_decode_audio4(codecCtx, frame, &frameDecoded, &packet);
+		av_free_packet(&packet);
+
+		// Skip packets that won't decode.
+		if(ret < 0 || !frameDecoded)
+			continue;
+
+		// Leave room for the resampler to give a few more frames than
+		// it was given.
+		int maxFrames = ((int64_t)frame->nb_samples * format.sampleRate) /
+		                codecCtx->sample_rate + 32;
+		pending.resize(maxFrames * format.channels);
+		uint8_t* out = (uint8_t*)&pending[0];
+		int converted = swr_convert(swr, &out, maxFrames,
+		                            (const uint8_t**)frame->data,
+		                            frame->nb_samples);
+		av_frame_unref(frame);
+
+		if(converted <= 0)
+			continue;
+
+		pending.resize(converted * format.channels);
+		return true;
+	}
+
+	pending.clear();
+	return false;
+}
@@ -0,0 +1,123 @@
+/****************************************
+ *
+ * audioDecoder.h
+ * Declare a decoder that reads the audio from a file.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _AUDIODECODER_H_
+#define _AUDIODECODER_H_
+
+#include <stdint.h>
+#include <pthread.h>
+#include <string>
+#include <vector>
+#include "audioSource.h"
+
+struct AVFormatContext;
+struct AVCodecContext;
+struct AVFrame;
+struct SwrContext;
+
+/**
+ * Decode the first audio stream of a file into signed 16 bit
+ * interleaved samples. It can be read as fast as the file can be
+ * decoded, so it is also used to analyse files without playing them.
+ *
+ * Files with more than two channels are mixed down to stereo.
+ */
+class audioDecoder : public audioSource
+{
+	public:
+		/**
+		 * Create a decoder.
+		 * @param file the path of the file to decode.
+		 */
+		audioDecoder(const std::string& file);
+		virtual ~audioDecoder();
+
+		/**
+		 * Open the file.
+		 * @returns true if the file has an audio stream that
+		 * can be decoded.
+		 */
+		bool open();
+
+		/**
+		 * Close the file, if it is open.
+		 */
+		void close();
+
+		/**
+		 * @returns AUDIO_SOURCE_PULL, the file is played through
+		 * the sound card.
+		 */
+		audioSourceMode getMode() const;
+
+		const pcmFormat& getFormat() const;
+
+		/**
+		 * Resample to a different rate or number of channels.
+		 * @returns false if the resampler couldn't be set up.
+		 */
+		bool setOutputFormat(int sampleRate, int channels);
+
+		int read(int16_t* buffer, int noFrames);
+		void stop();
+
+		/**
+		 * @returns a hash of the file from analysisCache::hashFile().
+		 */
+		uint64_t getTrackHash() const;
+
+	private:
+		/**
+		 * Set up the resampler to convert to format.
+		 * @returns false if it couldn't be set up.
+		 */
+		bool initResampler();
+
+		/**
+		 * Decode the next packet of the audio stream into pending.
+		 * @returns false at the end of the file.
+		 */
+		bool decodePacket();
+
+		bool isStopped() const;
+
+		std::string file;
+		AVFormatContext* fmtCtx;
+		AVCodecContext* codecCtx;
+		AVFrame* frame;
+		SwrContext* swr;
+		int audioStream;
+		bool stopped;
+
+		// The format that samples are read in.
+		pcmFormat format;
+
+		// Samples that have been decoded but not read.
+		std::vector<int16_t> pending;
+		size_t pendingOffset;
+
+		// libav's registration and codec opening aren't thread safe.
+		static pthread_mutex_t avMutex;
+};
+
+#endif
@@ -0,0 +1,121 @@
+/****************************************
+ *
+ * audioSource.h
+ * Declare the interface for sources of audio.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _AUDIOSOURCE_H_
+#define _AUDIOSOURCE_H_
+
+#include <stdint.h>
+#include "pcmFormat.h"
+
+/**
+ * How the audio from a source reaches the listener.
+ */
+typedef enum
+{
+	// The source is pulled from as fast as it is wanted, such as a
+	// file. Its audio is played through the sound card.
+	AUDIO_SOURCE_PULL,
+
+	// The source pushes audio at its own rate as it is being heard
+	// somewhere else, such as MPD's FIFO output.
+	AUDIO_SOURCE_PUSH
+}audioSourceMode;
+
+/**
+ * A pure abstract class for a source of audio.
+ *
+ * Samples are always read as signed 16 bit interleaved frames, at
+ * the sample rate and with the number of channels in getFormat().
+ */
+class audioSource
+{
+	public:
+		virtual ~audioSource() {};
+
+		/**
+		 * Open the source and find out its format.
+		 * @returns false if the source couldn't be opened.
+		 */
+		virtual bool open() = 0;
+
+		/**
+		 * Close the source.
+		 */
+		virtual void close() = 0;
+
+		/**
+		 * @returns how the source's audio is heard.
+		 */
+		virtual audioSourceMode getMode() const = 0;
+
+		/**
+		 * Get the format of the source, this is only valid once
+		 * the source has been opened.
+		 * @returns the format. Its sampleFormat is the format of the
+		 * source itself, read() always gives 16 bit samples.
+		 */
+		virtual const pcmFormat& getFormat() const = 0;
+
+		/**
+		 * Ask for the samples to be read in a different format, eg
+		 * the one that the sound card was opened with. By default
+		 * only the source's own format is accepted.
+		 * @param sampleRate the number of frames per second wanted.
+		 * @param channels the number of channels wanted.
+		 * @returns false if the source can't give that format.
+		 */
+		virtual bool setOutputFormat(int sampleRate, int channels)
+		{
+			return sampleRate == getFormat().sampleRate &&
+			       channels == getFormat().channels;
+		}
+
+		/**
+		 * Read some frames, waiting until they are available.
+		 * @param buffer where to put the samples, it must have space
+		 * for noFrames * channels samples.
+		 * @param noFrames the number of frames wanted.
+		 * @returns the number of frames read. This is only less than
+		 * noFrames at the end of the source or once it has been stopped.
+		 */
+		virtual int read(int16_t* buffer, int noFrames) = 0;
+
+		/**
+		 * Make read() return as soon as possible, now and from now
+		 * on. This can be called from any thread.
+		 */
+		virtual void stop() = 0;
+
+		/**
+		 * Identify the track that is being played so that its
+		 * analysis can be cached.
+		 * @returns a hash of the track or 0 if the source isn't a
+		 * single track.
+		 */
+		virtual uint64_t getTrackHash() const
+		{
+			return 0;
+		}
+};
+
+#endif
@@ -24,6 +24,8 @@
 #ifndef _CIRCULARBUFFER_H_
 #define _CIRCULARBUFFER_H_
 
+#include <stddef.h>
+#include <string.h>
 #include <exception>
 #include <string>
 
@@ -45,49 +47,311 @@ class exception : public std::exception
 };
 
 /**
- * This class implements a circular buffer.
+ * A contiguous run of elements inside the buffer. Reads and
+ * writes that wrap around the end of the buffer are described
+ * by two of these.
  */
+template <typename T>
+struct segment
+{
+	T* data;
+	size_t length;
+};
+
+/**
+ * This class implements a single producer, single consumer
+ * circular buffer.
+ *
+ * The capacity is always rounded up to a power of two so that
+ * indexing is a mask rather than a divide. One thread may write
+ * to the buffer whilst another reads from it without any locking;
+ * the head and tail indices are published with acquire/release
+ * semantics.
+ *
+ * @note T is copied with memcpy, it should be a plain old data type.
+ */
+template <typename T>
 class circularBuffer
 {
 	public:
 		/**
 		 * Construct a circular buffer.
-		 * @param elementSize a size for each element
-		 * to be used for preallocation.
-		 * @param bufferSize the number of elementSize objects
-		 * to be buffered.
+		 * @param bufferSize the minimum number of T elements to be
+		 * buffered. This is rounded up to the next power of two.
 		 */
-		circularBuffer(size_t bufferSize, size_t elementSize);
-		
+		circularBuffer(size_t bufferSize);
+
 		/**
 		 * Free any memory used by the buffer
 		 * object class.
 		 */
 		virtual ~circularBuffer();
-		
+
+		/**
+		 * @returns the number of elements the buffer can hold.
+		 */
+		size_t capacity() const;
+
+		/**
+		 * @returns the number of elements waiting to be read.
+		 * @note only exact when called from the consumer thread.
+		 */
+		size_t size() const;
+
 		/**
-		 * Add data to the buffer.
-		 * @returns a void pointer to pre-allocated
-		 * memory that can be written over.
+		 * @returns the number of elements that can be written.
+		 * @note only exact when called from the producer thread.
 		 */
-		void* add();
-		
+		size_t space() const;
+
 		/**
-		 * get some data off the current head
-		 * of the buffer.
-		 * @returns the pointer to the element in the buffer.
+		 * Add an element to the tail of the buffer.
+		 * @returns false if the buffer is full.
 		 */
-		void* pop();
-		
+		bool tryPush(const T& element);
+
+		/**
+		 * Take an element off the head of the buffer.
+		 * @returns false if the buffer is empty.
+		 */
+		bool tryPop(T& element);
+
+		/**
+		 * Add an element to the tail of the buffer.
+		 * @throws circularBuffer::exception on overflow.
+		 */
+		void push(const T& element);
+
+		/**
+		 * Take an element off the head of the buffer.
+		 * @throws circularBuffer::exception on under run.
+		 */
+		T pop();
+
+		/**
+		 * Copy up to len elements into the buffer.
+		 * @returns the number of elements actually written.
+		 */
+		size_t write(const T* src, size_t len);
+
+		/**
+		 * Copy up to len elements out of the buffer.
+		 * @returns the number of elements actually read.
+		 */
+		size_t read(T* dst, size_t len);
+
+		/**
+		 * Get the free space in the buffer as, at most, two contiguous
+		 * segments that the producer can fill in place. Nothing is made
+		 * visible to the consumer until commitWrite() is called.
+		 * @returns the total length of both segments.
+		 */
+		size_t getWriteSegments(segment<T>& first, segment<T>& second);
+
+		/**
+		 * Publish len elements previously written through
+		 * getWriteSegments().
+		 */
+		void commitWrite(size_t len);
+
+		/**
+		 * Get the readable data as, at most, two contiguous segments
+		 * that the consumer can use in place. The data stays valid
+		 * until commitRead() is called.
+		 * @returns the total length of both segments.
+		 */
+		size_t getReadSegments(segment<T>& first, segment<T>& second);
+
+		/**
+		 * Release len elements previously obtained from
+		 * getReadSegments() back to the producer.
+		 */
+		void commitRead(size_t len);
+
 	private:
-		void* getElement(int index);
-		void* buf;
-		int headIndex;
-		int tailIndex;
-		int elementSize;
-		int bufferSize;
+		// Not copyable.
+		circularBuffer(const circularBuffer&);
+		circularBuffer& operator=(const circularBuffer&);
+
+		void splitSegments(size_t index, size_t len,
+		                   segment<T>& first, segment<T>& second);
+
+		T* buf;
+		size_t bufferSize;
+		size_t mask;
+
+		// The indices are free running and only masked when the buffer
+		// is accessed. They are kept on separate cache lines as each is
+		// written by a different thread.
+		size_t headIndex;
+		char pad1[64 - sizeof(size_t)];
+		size_t tailIndex;
+		char pad2[64 - sizeof(size_t)];
 };
 
+template <typename T>
+circularBuffer<T>::circularBuffer(size_t bufferSize)
+{
+	// Round the size up to a power of two.
+	size_t size = 1;
+	while(size < bufferSize)
+		size <<= 1;
+
+	buf = new T[size]();
+	this->bufferSize = size;
+	mask = size - 1;
+	headIndex = 0;
+	tailIndex = 0;
+}
+
+template <typename T>
+circularBuffer<T>::~circularBuffer()
+{
+	delete[] buf;
+}
+
+template <typename T>
+size_t circularBuffer<T>::capacity() const
+{
+	return bufferSize;
+}
+
+template <typename T>
+size_t circularBuffer<T>::size() const
+{
+	size_t tail = __atomic_load_n(&tailIndex, __ATOMIC_ACQUIRE);
+	size_t head = __atomic_load_n(&headIndex, __ATOMIC_ACQUIRE);
+	return tail - head;
+}
+
+template <typename T>
+size_t circularBuffer<T>::space() const
+{
+	return bufferSize - size();
+}
+
+template <typename T>
+bool circularBuffer<T>::tryPush(const T& element)
+{
+	size_t tail = __atomic_load_n(&tailIndex, __ATOMIC_RELAXED);
+	size_t head = __atomic_load_n(&headIndex, __ATOMIC_ACQUIRE);
+	if(tail - head == bufferSize)
+		return false;
+
+	buf[tail & mask] = element;
+	__atomic_store_n(&tailIndex, tail + 1, __ATOMIC_RELEASE);
+	return true;
+}
+
+template <typename T>
+bool circularBuffer<T>::tryPop(T& element)
+{
+	size_t head = __atomic_load_n(&headIndex, __ATOMIC_RELAXED);
+	size_t tail = __atomic_load_n(&tailIndex, __ATOMIC_ACQUIRE);
+	if(head == tail)
+		return false;
+
+	element = buf[head & mask];
+	__atomic_store_n(&headIndex, head + 1, __ATOMIC_RELEASE);
+	return true;
+}
+
+template <typename T>
+void circularBuffer<T>::push(const T& element)
+{
+	if(!tryPush(element))
+		throw exception("Buffer overflow.");
+}
+
+template <typename T>
+T circularBuffer<T>::pop()
+{
+	T element;
+	if(!tryPop(element))
+		throw exception("Buffer under run.");
+	return element;
+}
+
+template <typename T>
+void circularBuffer<T>::splitSegments(size_t index, size_t len,
+                                      segment<T>& first, segment<T>& second)
+{
+	size_t offset = index & mask;
+	size_t firstLength = bufferSize - offset;
+	if(firstLength > len)
+		firstLength = len;
+
+	first.data = buf + offset;
+	first.length = firstLength;
+	second.data = buf;
+	second.length = len - firstLength;
+}
+
+template <typename T>
+size_t circularBuffer<T>::getWriteSegments(segment<T>& first, segment<T>& second)
+{
+	size_t tail = __atomic_load_n(&tailIndex, __ATOMIC_RELAXED);
+	size_t head = __atomic_load_n(&headIndex, __ATOMIC_ACQUIRE);
+	size_t len = bufferSize - (tail - head);
+	splitSegments(tail, len, first, second);
+	return len;
+}
+
+template <typename T>
+void circularBuffer<T>::commitWrite(size_t len)
+{
+	size_t tail = __atomic_load_n(&tailIndex, __ATOMIC_RELAXED);
+	__atomic_store_n(&tailIndex, tail + len, __ATOMIC_RELEASE);
+}
+
+template <typename T>
+size_t circularBuffer<T>::getReadSegments(segment<T>& first, segment<T>& second)
+{
+	size_t head = __atomic_load_n(&headIndex, __ATOMIC_RELAXED);
+	size_t tail = __atomic_load_n(&tailIndex, __ATOMIC_ACQUIRE);
+	size_t len = tail - head;
+	splitSegments(head, len, first, second);
+	return len;
+}
+
+template <typename T>
+void circularBuffer<T>::commitRead(size_t len)
+{
+	size_t head = __atomic_load_n(&headIndex, __ATOMIC_RELAXED);
+	__atomic_store_n(&headIndex, head + len, __ATOMIC_RELEASE);
+}
+
+template <typename T>
+size_t circularBuffer<T>::write(const T* src, size_t len)
+{
+	segment<T> first, second;
+	size_t available = getWriteSegments(first, second);
+	if(len > available)
+		len = available;
+
+	// Only copy what was asked for, the segments cover all the free space.
+	size_t firstLength = first.length < len ? first.length : len;
+	memcpy(first.data, src, sizeof(T) * firstLength);
+	memcpy(second.data, src + firstLength, sizeof(T) * (len - firstLength));
+	commitWrite(len);
+	return len;
+}
+
+template <typename T>
+size_t circularBuffer<T>::read(T* dst, size_t len)
+{
+	segment<T> first, second;
+	size_t available = getReadSegments(first, second);
+	if(len > available)
+		len = available;
+
+	size_t firstLength = first.length < len ? first.length : len;
+	memcpy(dst, first.data, sizeof(T) * firstLength);
+	memcpy(dst + firstLength, second.data, sizeof(T) * (len - firstLength));
+	commitRead(len);
+	return len;
+}
+
 }
 
 #endif
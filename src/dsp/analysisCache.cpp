@@ -0,0 +1,280 @@
+/****************************************
+ *
+ * analysisCache.cpp
+ * Define a cache for precomputed analysis.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <vector>
+#include "analysisCache.h"
+
+// FNV-1a constants.
+#define HASH_OFFSET 14695981039346656037ULL
+#define HASH_PRIME 1099511628211ULL
+
+analysisCache::analysisCache()
+{
+	map = NULL;
+	mapLength = 0;
+	header = NULL;
+	fd = -1;
+	record = NULL;
+	hopsFilled = 0;
+}
+
+analysisCache::~analysisCache()
+{
+	if(isWriting())
+		finish();
+	close();
+}
+
+uint64_t analysisCache::hashFile(const std::string& path)
+{
+	int file = open(path.c_str(), O_RDONLY);
+	if(file == -1)
+		return 0;
+
+	uint64_t hash = HASH_OFFSET;
+	uint8_t buf[65536];
+	ssize_t noRead;
+	while((noRead = read(file, buf, sizeof(buf))) > 0)
+	{
+		for(ssize_t i = 0; i < noRead; i++)
+		{
+			hash ^= buf[i];
+			hash *= HASH_PRIME;
+		}
+	}
+	::close(file);
+
+	if(noRead < 0)
+		return 0;
+	return hash;
+}
+
+std::string analysisCache::cachePath(const std::string& dir, uint64_t fileHash,
+                                     const analysisParameters& params)
+{
+	char name[128];
+	snprintf(name, sizeof(name), "/%016llx-%u-%u-%u-%u-%u.mac",
+	         (unsigned long long)fileHash, params.sampleRate, params.channels,
+	         params.hopSize, params.windowSize, params.channelMode);
+	return dir + name;
+}
+
+uint32_t analysisCache::hopStrideFor(const analysisParameters& params)
+{
+	uint32_t length = sizeof(float) * (params.noBins + params.noBands + 1);
+	return (length + 15) & ~15;
+}
+
+bool analysisCache::openForReading(const std::string& dir, uint64_t fileHash,
+                                   const analysisParameters& params)
+{
+	close();
+
+	int file = open(cachePath(dir, fileHash, params).c_str(), O_RDONLY);
+	if(file == -1)
+		return false;
+
+	struct stat st;
+	if(fstat(file, &st) != 0 || st.st_size < (off_t)sizeof(analysisCacheHeader))
+	{
+		::close(file);
+		return false;
+	}
+
+	void* mapping = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, file, 0);
+	::close(file);
+	if(mapping == MAP_FAILED)
+		return false;
+
+	// Check that this is the cache we're after and that it is
+	// as long as it claims to be.
+	const analysisCacheHeader* h = (const analysisCacheHeader*)mapping;
+	if(memcmp(h->magic, ANALYSIS_CACHE_MAGIC, sizeof(h->magic)) != 0 ||
+	   h->version != ANALYSIS_CACHE_VERSION ||
+	   h->headerSize != sizeof(analysisCacheHeader) ||
+	   h->fileHash != fileHash ||
+	   memcmp(&h->parameters, &params, sizeof(params)) != 0 ||
+	   h->hopStride != hopStrideFor(params) ||
+	   !h->complete ||
+	   h->headerSize + (h->noHops * h->hopStride) > (uint64_t)st.st_size)
+	{
+		munmap(mapping, st.st_size);
+		return false;
+	}
+
+	map = mapping;
+	mapLength = st.st_size;
+	header = h;
+	return true;
+}
+
+bool analysisCache::openForWriting(const std::string& dir, uint64_t fileHash,
+                                   const analysisParameters& params)
+{
+	close();
+
+	path = cachePath(dir, fileHash, params);
+	// The results are written to a file of their own and moved into
+	// place once finished, so that other FFTs or processes writing
+	// the same cache never see half of one.
+	std::vector<char> name(path.begin(), path.end());
+	const char suffix[] = ".XXXXXX";
+	name.insert(name.end(), suffix, suffix + sizeof(suffix));
+	fd = mkstemp(&name[0]);
+	if(fd == -1)
+		return false;
+	fchmod(fd, 0644);
+	tempPath = &name[0];
+
+	memset(&writeHeader, 0, sizeof(writeHeader));
+	memcpy(writeHeader.magic, ANALYSIS_CACHE_MAGIC, sizeof(writeHeader.magic));
+	writeHeader.version = ANALYSIS_CACHE_VERSION;
+	writeHeader.headerSize = sizeof(analysisCacheHeader);
+	writeHeader.fileHash = fileHash;
+	writeHeader.parameters = params;
+	writeHeader.hopStride = hopStrideFor(params);
+	record = (float*)calloc(1, writeHeader.hopStride);
+	hopsFilled = 0;
+	return true;
+}
+
+void analysisCache::writeHop(uint64_t hop, const float* spectrum,
+                             const float* bands, float onset)
+{
+	if(fd == -1)
+		return;
+
+	const analysisParameters& p = writeHeader.parameters;
+	memcpy(record, spectrum, sizeof(float) * p.noBins);
+	memcpy(record + p.noBins, bands, sizeof(float) * p.noBands);
+	record[p.noBins + p.noBands] = onset;
+
+	// Fill in anything that was skipped, the DSP manager drops blocks
+	// if it is still busy with the last one.
+	uint64_t first = hop;
+	if(hop > writeHeader.noHops)
+	{
+		first = writeHeader.noHops;
+		hopsFilled += hop - first;
+	}
+
+	for(uint64_t i = first; i <= hop; i++)
+	{
+		off_t offset = sizeof(analysisCacheHeader) + (i * writeHeader.hopStride);
+		if(pwrite(fd, record, writeHeader.hopStride, offset) != writeHeader.hopStride)
+			return;
+	}
+
+	if(hop >= writeHeader.noHops)
+		writeHeader.noHops = hop + 1;
+}
+
+bool analysisCache::finish()
+{
+	if(fd == -1)
+		return false;
+
+	// If too many hops were skipped then the analysis isn't usable.
+	bool keep = writeHeader.noHops > 0 && hopsFilled * 20 <= writeHeader.noHops;
+	if(keep)
+	{
+		writeHeader.complete = 1;
+		keep = pwrite(fd, &writeHeader, sizeof(writeHeader), 0) == sizeof(writeHeader);
+	}
+
+	::close(fd);
+	fd = -1;
+	free(record);
+	record = NULL;
+
+	if(keep)
+		keep = rename(tempPath.c_str(), path.c_str()) == 0;
+	if(!keep)
+		unlink(tempPath.c_str());
+	return keep;
+}
+
+void analysisCache::close()
+{
+	if(map)
+		munmap(map, mapLength);
+	map = NULL;
+	mapLength = 0;
+	header = NULL;
+
+	if(fd != -1)
+	{
+		::close(fd);
+		fd = -1;
+		unlink(tempPath.c_str());
+	}
+	free(record);
+	record = NULL;
+}
+
+bool analysisCache::isReading() const
+{
+	return header != NULL;
+}
+
+bool analysisCache::isWriting() const
+{
+	return fd != -1;
+}
+
+uint64_t analysisCache::getNoHops() const
+{
+	return header ? header->noHops : 0;
+}
+
+const float* analysisCache::getRecord(uint64_t hop) const
+{
+	if(!header || hop >= header->noHops)
+		return NULL;
+	return (const float*)((const uint8_t*)map + header->headerSize +
+	                      (hop * header->hopStride));
+}
+
+const float* analysisCache::getSpectrum(uint64_t hop) const
+{
+	return getRecord(hop);
+}
+
+const float* analysisCache::getBands(uint64_t hop) const
+{
+	const float* r = getRecord(hop);
+	return r ? r + header->parameters.noBins : NULL;
+}
+
+float analysisCache::getOnset(uint64_t hop) const
+{
+	const float* r = getRecord(hop);
+	return r ? r[header->parameters.noBins + header->parameters.noBands] : 0;
+}
@@ -0,0 +1,208 @@
+/****************************************
+ *
+ * analysisCache.h
+ * Declare a cache for precomputed analysis.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _ANALYSISCACHE_H_
+#define _ANALYSISCACHE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+#define ANALYSIS_CACHE_MAGIC "MTLZANLS"
+#define ANALYSIS_CACHE_VERSION 2
+
+/**
+ * The parameters that an analysis was made with. A cache file is
+ * only used if all of these match.
+ */
+typedef struct
+{
+	uint32_t sampleRate;
+	uint32_t channels;
+
+	// The number of frames between each analysis.
+	uint32_t hopSize;
+
+	// The number of frames that each analysis covers.
+	uint32_t windowSize;
+
+	// The number of values stored for each analysis.
+	uint32_t noBins;
+	uint32_t noBands;
+
+	// Which of the channels were analysed, a fftChannelMode.
+	uint32_t channelMode;
+}analysisParameters;
+
+/**
+ * The header at the start of a cache file.
+ *
+ * It is followed by noHops records, each hopStride bytes long and
+ * made up of noBins floats for the spectrum, noBands floats for the
+ * band energies and a single float for the onset strength, padded to
+ * a multiple of 16 bytes. Record n holds the analysis of the hop that
+ * starts at frame n * hopSize. All values are in the native byte order.
+ */
+typedef struct
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t headerSize;
+	uint64_t fileHash;
+	analysisParameters parameters;
+	uint32_t hopStride;
+
+	// Only set once the file has been finished.
+	uint32_t complete;
+	uint64_t noHops;
+}analysisCacheHeader;
+
+/**
+ * A per track cache of analysis results.
+ *
+ * The first time a track is analysed the results for each hop are
+ * written to a file named after a hash of the track and the analysis
+ * parameters. On later plays the file is memory mapped so that a
+ * result is just a pointer into the file.
+ */
+class analysisCache
+{
+	public:
+		analysisCache();
+
+		/**
+		 * Closes the cache. If it was being written it is
+		 * finished first.
+		 */
+		virtual ~analysisCache();
+
+		/**
+		 * Hash the contents of a file.
+		 * @param path the file to hash.
+		 * @returns the hash, or 0 if the file couldn't be read.
+		 */
+		static uint64_t hashFile(const std::string& path);
+
+		/**
+		 * Get the path of the cache file for a track.
+		 * @param dir the directory that holds the cache files.
+		 * @param fileHash the hash of the track from hashFile().
+		 * @param params the parameters of the analysis.
+		 */
+		static std::string cachePath(const std::string& dir, uint64_t fileHash,
+		                             const analysisParameters& params);
+
+		/**
+		 * Map an existing cache file.
+		 * @returns false if the file doesn't exist, isn't complete or
+		 * was made with different parameters.
+		 */
+		bool openForReading(const std::string& dir, uint64_t fileHash,
+		                    const analysisParameters& params);
+
+		/**
+		 * Start a new cache file. Nothing is visible at the final path
+		 * until finish() is called.
+		 * @returns false if the file couldn't be created.
+		 */
+		bool openForWriting(const std::string& dir, uint64_t fileHash,
+		                    const analysisParameters& params);
+
+		/**
+		 * Write the analysis for a hop. If hops have been skipped since
+		 * the last one written, they are filled in with this one.
+		 * @param hop the index of the hop.
+		 * @param spectrum noBins values.
+		 * @param bands noBands values.
+		 * @param onset the onset strength.
+		 */
+		void writeHop(uint64_t hop, const float* spectrum,
+		              const float* bands, float onset);
+
+		/**
+		 * Finish writing the cache. The file is only kept if no more
+		 * than one in twenty of the hops had to be filled in.
+		 * @returns true if the file was kept.
+		 */
+		bool finish();
+
+		/**
+		 * Close the cache without keeping anything being written.
+		 */
+		void close();
+
+		/**
+		 * @returns true if the cache has been mapped for reading.
+		 */
+		bool isReading() const;
+
+		/**
+		 * @returns true if the cache is being written.
+		 */
+		bool isWriting() const;
+
+		/**
+		 * @returns the number of hops in a mapped cache.
+		 */
+		uint64_t getNoHops() const;
+
+		/**
+		 * Get the spectrum of a hop from a mapped cache.
+		 * @returns a pointer to noBins values, or NULL if the hop
+		 * is out of range.
+		 */
+		const float* getSpectrum(uint64_t hop) const;
+
+		/**
+		 * Get the band energies of a hop from a mapped cache.
+		 * @returns a pointer to noBands values, or NULL if the hop
+		 * is out of range.
+		 */
+		const float* getBands(uint64_t hop) const;
+
+		/**
+		 * Get the onset strength of a hop from a mapped cache.
+		 * @returns the onset strength, or 0 if the hop is out of
+		 * range.
+		 */
+		float getOnset(uint64_t hop) const;
+
+	private:
+		static uint32_t hopStrideFor(const analysisParameters& params);
+		const float* getRecord(uint64_t hop) const;
+
+		// The mapping of a cache being read.
+		void* map;
+		size_t mapLength;
+		const analysisCacheHeader* header;
+
+		// A cache being written.
+		int fd;
+		std::string path;
+		std::string tempPath;
+		analysisCacheHeader writeHeader;
+		float* record;
+		uint64_t hopsFilled;
+};
+
+#endif
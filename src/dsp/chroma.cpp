@@ -0,0 +1,248 @@
+/****************************************
+ *
+ * chroma.cpp
+ * Define a chroma plugin class.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "chroma.h"
+
+// How much each pitch class fits in a major and minor key on C, see
+// Krumhansl, "Cognitive Foundations of Musical Pitch".
+static const float majorProfile[CHROMA_NO_CLASSES] =
+	{6.35f, 2.23f, 3.48f, 2.33f, 4.38f, 4.09f, 2.52f, 5.19f, 2.39f, 3.66f, 2.29f, 2.88f};
+static const float minorProfile[CHROMA_NO_CLASSES] =
+	{6.33f, 2.68f, 3.52f, 5.38f, 2.60f, 3.53f, 2.54f, 4.75f, 3.98f, 2.69f, 3.34f, 3.17f};
+
+static const char* keyNames[CHROMA_NO_KEYS] =
+{
+	"C major", "C# major", "D major", "D# major", "E major", "F major",
+	"F# major", "G major", "G# major", "A major", "A# major", "B major",
+	"C minor", "C# minor", "D minor", "D# minor", "E minor", "F minor",
+	"F# minor", "G minor", "G# minor", "A minor", "A# minor", "B minor"
+};
+
+/**
+ * Find the correlation of two sets of CHROMA_NO_CLASSES values, with
+ * the second rotated by shift classes.
+ */
+static float correlate(const float* a, const float* b, int shift)
+{
+	float meanA = 0;
+	float meanB = 0;
+	for(int i = 0; i < CHROMA_NO_CLASSES; i++)
+	{
+		meanA += a[i];
+		meanB += b[i];
+	}
+	meanA /= CHROMA_NO_CLASSES;
+	meanB /= CHROMA_NO_CLASSES;
+
+	float product = 0;
+	float squaresA = 0;
+	float squaresB = 0;
+	for(int i = 0; i < CHROMA_NO_CLASSES; i++)
+	{
+		float x = a[i] - meanA;
+		float y = b[(i - shift + CHROMA_NO_CLASSES) % CHROMA_NO_CLASSES] - meanB;
+		product += x * y;
+		squaresA += x * x;
+		squaresB += y * y;
+	}
+	if(squaresA <= 0 || squaresB <= 0)
+		return 0;
+	return product / sqrtf(squaresA * squaresB);
+}
+
+Chroma::Chroma(FFT* fftPlugin, bool estimateKey, double minFreq,
+               double maxFreq, double tuning)
+{
+	PCMDataMutex = new pthread_mutex_t;
+	pthread_mutex_init(PCMDataMutex, NULL);
+
+	this->fftPlugin = fftPlugin;
+	this->estimateKey = estimateKey;
+	this->minFreq = minFreq;
+	this->maxFreq = maxFreq;
+	this->tuning = tuning;
+	noBins = 0;
+	sampleRate = 0;
+	for(int i = 0; i < CHROMA_NO_CLASSES; i++)
+	{
+		chroma[i] = 0;
+		running[i] = 0;
+	}
+	key = -1;
+	keyCorrelation = 0;
+	time = 0;
+	hasData = false;
+	ChromaDataStruct = new ChromaData;
+}
+
+Chroma::~Chroma()
+{
+	delete ChromaDataStruct;
+	pthread_mutex_destroy(PCMDataMutex);
+	delete PCMDataMutex;
+}
+
+const char* Chroma::keyName(int key)
+{
+	if(key < 0 || key >= CHROMA_NO_KEYS)
+		return "unknown";
+	return keyNames[key];
+}
+
+void Chroma::makeTable(int noBins, int sampleRate)
+{
+	this->noBins = noBins;
+	this->sampleRate = sampleRate;
+	tableBin.clear();
+	tableClass.clear();
+	tableWeight.clear();
+
+	// A semitone is about 6% of its frequency wide, so below this
+	// the bins are too coarse to tell notes apart.
+	double nyquist = sampleRate / 2.0;
+	double binWidth = nyquist / noBins;
+	double resolvable = binWidth / (pow(2.0, 1.0 / 12) - 1);
+	double bottom = minFreq > resolvable ? minFreq : resolvable;
+	double top = maxFreq < nyquist ? maxFreq : nyquist;
+
+	int first = (int)ceil(bottom / binWidth);
+	int last = (int)floor(top / binWidth);
+	if(last >= noBins)
+		last = noBins - 1;
+
+	for(int j = first; j <= last; j++)
+	{
+		// The pitch of the bin in semitones, with C at a multiple
+		// of 12, shared between the semitones either side.
+		double pitch = (12 * log2((j * binWidth) / tuning)) + 9;
+		double below = floor(pitch);
+		float fraction = (float)(pitch - below);
+		int lower = (((int)below % CHROMA_NO_CLASSES) + CHROMA_NO_CLASSES) %
+		            CHROMA_NO_CLASSES;
+
+		tableBin.push_back(j);
+		tableClass.push_back(lower);
+		tableWeight.push_back(1 - fraction);
+		tableBin.push_back(j);
+		tableClass.push_back((lower + 1) % CHROMA_NO_CLASSES);
+		tableWeight.push_back(fraction);
+	}
+}
+
+void Chroma::processPCMBlock(PCMBlock* block)
+{
+	// Skip this block rather than wait if the spectrum is in use.
+	FFTData* data = (FFTData*)fftPlugin->tryGetDSPData();
+	if(data == NULL)
+		return;
+
+	// Each spectrum is only added to the running chroma once, even
+	// if the FFT plugin skipped a block.
+	if(hasData && data->time == time)
+	{
+		fftPlugin->relenquishDSPData();
+		return;
+	}
+
+	int bins = data->dataLength;
+	if((int)magnitude.size() != bins)
+		magnitude.resize(bins);
+	memcpy(&magnitude[0], data->magnitude, sizeof(float) * bins);
+	uint64_t spectrumTime = data->time;
+	fftPlugin->relenquishDSPData();
+
+	// Attempt to process the data, if not - skip this set of samples.
+	if(pthread_mutex_trylock(PCMDataMutex) != 0)
+		return;
+
+	int rate = block->sampleRate ? block->sampleRate : PCM_DEFAULT_SAMPLE_RATE;
+	if(bins != noBins || rate != sampleRate)
+		makeTable(bins, rate);
+
+	// Fold the spectrum.
+	float folded[CHROMA_NO_CLASSES];
+	for(int i = 0; i < CHROMA_NO_CLASSES; i++)
+		folded[i] = 0;
+	int noEntries = tableBin.size();
+	for(int i = 0; i < noEntries; i++)
+		folded[tableClass[i]] += tableWeight[i] * magnitude[tableBin[i]];
+
+	float strongest = 0;
+	for(int i = 0; i < CHROMA_NO_CLASSES; i++)
+		strongest = folded[i] > strongest ? folded[i] : strongest;
+	for(int i = 0; i < CHROMA_NO_CLASSES; i++)
+		chroma[i] = strongest > 0 ? folded[i] / strongest : 0;
+
+	if(estimateKey)
+	{
+		for(int i = 0; i < CHROMA_NO_CLASSES; i++)
+			running[i] = (running[i] * CHROMA_KEY_DECAY) + chroma[i];
+		findKey();
+	}
+
+	time = spectrumTime;
+	hasData = true;
+	pthread_mutex_unlock(PCMDataMutex);
+}
+
+void Chroma::findKey()
+{
+	key = -1;
+	keyCorrelation = -1;
+	for(int k = 0; k < CHROMA_NO_KEYS; k++)
+	{
+		const float* profile = k < CHROMA_NO_CLASSES ? majorProfile : minorProfile;
+		float r = correlate(running, profile, k % CHROMA_NO_CLASSES);
+		if(r > keyCorrelation)
+		{
+			key = k;
+			keyCorrelation = r;
+		}
+	}
+}
+
+void* Chroma::getDSPData()
+{
+	// Ensure we have some data
+	if(!hasData)
+		return NULL;
+
+	// grab the mutex
+	pthread_mutex_lock(PCMDataMutex);
+
+	// set the structure variables
+	ChromaDataStruct->chroma = chroma;
+	ChromaDataStruct->key = estimateKey ? key : -1;
+	ChromaDataStruct->keyCorrelation = estimateKey ? keyCorrelation : 0;
+	ChromaDataStruct->time = time;
+
+	return (void*)ChromaDataStruct;
+}
+
+void Chroma::relenquishDSPData()
+{
+	pthread_mutex_unlock(PCMDataMutex);
+}
@@ -0,0 +1,143 @@
+/****************************************
+ *
+ * chroma.h
+ * Declare a chroma plugin class.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CHROMA_H_
+#define _CHROMA_H_
+
+#include <pthread.h>
+#include <vector>
+#include "dsp.h"
+#include "fft.h"
+
+// The number of pitch classes in an octave.
+#define CHROMA_NO_CLASSES 12
+
+// The number of keys the key estimate picks from, a major and minor
+// key for each pitch class.
+#define CHROMA_NO_KEYS 24
+
+// How much of the running chroma used for the key is kept each hop.
+#define CHROMA_KEY_DECAY 0.995f
+
+typedef struct
+{
+	// The strength of each pitch class, starting at C. The
+	// strongest is scaled to 1.
+	float* chroma;
+
+	// The most likely key, 0-11 for C to B major and 12-23 for C to B
+	// minor, or -1 if the key isn't being estimated. See
+	// Chroma::keyName().
+	int key;
+
+	// How well the key fits, the correlation of its profile with the
+	// running chroma from -1 to 1.
+	float keyCorrelation;
+
+	// The time of the spectrum that was folded.
+	uint64_t time;
+}ChromaData;
+
+/**
+ * Fold the spectrum from a FFT plugin into the twelve pitch classes,
+ * so that a note gives the same result in any octave.
+ *
+ * Each bin of the spectrum is worked out as a pitch, and split between
+ * the pitch classes of the two semitones either side of it. This is
+ * kept as a table of bin, class and weight that is made when the size
+ * of the spectrum or the sample rate changes, so folding a spectrum is
+ * one pass over the table. Bins below the point where they are wider
+ * than a semitone are left out as they can't tell notes apart.
+ *
+ * The key can also be estimated by correlating a slowly decaying
+ * average of the chroma with the Krumhansl-Kessler key profiles.
+ *
+ * @note this reads the FFT plugin's results for each block, so it must
+ * be registered with the DSPManager after the FFT plugin.
+ */
+class Chroma : public DSP
+{
+	public:
+		/**
+		 * Construct the chroma plugin.
+		 * @param fftPlugin the FFT plugin whose spectrum is used. This
+		 * isn't deleted by the chroma plugin.
+		 * @param estimateKey whether to estimate the key.
+		 * @param minFreq the lowest frequency folded in Hz.
+		 * @param maxFreq the highest frequency folded in Hz.
+		 * @param tuning the frequency of A4 in Hz.
+		 */
+		Chroma(FFT* fftPlugin, bool estimateKey = false, double minFreq = 55,
+		       double maxFreq = 5000, double tuning = 440);
+		virtual ~Chroma();
+		void processPCMBlock(PCMBlock* block);
+		void* getDSPData();
+		void relenquishDSPData();
+
+		/**
+		 * Get the name of a key, eg "A minor".
+		 * @param key a key from ChromaData.
+		 */
+		static const char* keyName(int key);
+
+	private:
+		/**
+		 * Make the table for a spectrum of noBins bins.
+		 */
+		void makeTable(int noBins, int sampleRate);
+
+		/**
+		 * Find the key that best fits the running chroma.
+		 */
+		void findKey();
+
+		pthread_mutex_t* PCMDataMutex;
+		FFT* fftPlugin;
+		bool estimateKey;
+		double minFreq;
+		double maxFreq;
+		double tuning;
+
+		// The spectrum the table was made for.
+		int noBins;
+		int sampleRate;
+
+		// The table, entry i adds weight[i] of bin[i] to class[i].
+		std::vector<int> tableBin;
+		std::vector<int> tableClass;
+		std::vector<float> tableWeight;
+
+		// The magnitude of each bin of the latest spectrum, only used
+		// by the DSP thread.
+		std::vector<float> magnitude;
+
+		float chroma[CHROMA_NO_CLASSES];
+		float running[CHROMA_NO_CLASSES];
+		int key;
+		float keyCorrelation;
+		uint64_t time;
+		bool hasData;
+		ChromaData* ChromaDataStruct;
+};
+
+#endif
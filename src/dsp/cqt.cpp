@@ -0,0 +1,254 @@
+/****************************************
+ *
+ * cqt.cpp
+ * Define a constant-Q transform plugin class.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "cqt.h"
+#include "fftPlanCache.h"
+
+CQT::CQT(int binsPerOctave, double minFreq, double maxFreq)
+{
+	PCMDataMutex = new pthread_mutex_t;
+	pthread_mutex_init(PCMDataMutex, NULL);
+
+	this->binsPerOctave = binsPerOctave;
+	this->minFreq = minFreq;
+	this->maxFreq = maxFreq;
+	sampleRate = 0;
+	fftLength = 0;
+	samples = NULL;
+	mixed = NULL;
+	mixedCapacity = 0;
+	in = NULL;
+	out = NULL;
+	time = 0;
+	hasData = false;
+	CQTDataStruct = new CQTData;
+}
+
+CQT::~CQT()
+{
+	freeKernels();
+	free(mixed);
+	delete CQTDataStruct;
+	pthread_mutex_destroy(PCMDataMutex);
+	delete PCMDataMutex;
+}
+
+void CQT::freeKernels()
+{
+	if(in)
+		fftw_free(in);
+	if(out)
+		fftw_free(out);
+	if(samples)
+		delete samples;
+	in = NULL;
+	out = NULL;
+	samples = NULL;
+	rowStart.clear();
+	columns.clear();
+	kernelReal.clear();
+	kernelImag.clear();
+	magnitude.clear();
+	frequencies.clear();
+}
+
+void CQT::makeKernels(int sampleRate)
+{
+	this->sampleRate = sampleRate;
+
+	// Each bin is Q cycles of its centre frequency long.
+	double Q = 1.0 / (pow(2.0, 1.0 / binsPerOctave) - 1);
+	double top = maxFreq < sampleRate / 2.0 ? maxFreq : sampleRate / 2.0;
+	int noBins = (int)floor(binsPerOctave * log2(top / minFreq)) + 1;
+	if(noBins < 1)
+		noBins = 1;
+
+	// The FFT has to be long enough for the lowest bin.
+	int longest = (int)ceil((Q * sampleRate) / minFreq);
+	fftLength = 1;
+	while(fftLength < longest)
+		fftLength <<= 1;
+
+	in = (double*)fftw_malloc(sizeof(double) * fftLength);
+	out = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * ((fftLength / 2) + 1));
+	samples = new circularBuffer::circularBuffer<float>(fftLength);
+	magnitude.assign(noBins, 0);
+	frequencies.resize(noBins);
+
+	fftw_complex* temporal = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * fftLength);
+	fftw_complex* spectral = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * fftLength);
+	std::vector<float> rowReal((fftLength / 2) + 1);
+	std::vector<float> rowImag((fftLength / 2) + 1);
+
+	rowStart.push_back(0);
+	for(int k = 0; k < noBins; k++)
+	{
+		double freq = minFreq * pow(2.0, (double)k / binsPerOctave);
+		int length = (int)ceil((Q * sampleRate) / freq);
+		frequencies[k] = (float)freq;
+
+		// A Hamming windowed sinusoid in the middle of the frame,
+		// scaled so that a sine wave of amplitude 1 gives 1.
+		memset(temporal, 0, sizeof(fftw_complex) * fftLength);
+		int start = (fftLength - length) / 2;
+		double windowSum = 0;
+		for(int n = 0; n < length; n++)
+			windowSum += 0.54 - 0.46 * cos((2 * M_PI * n) / (length - 1));
+		for(int n = 0; n < length; n++)
+		{
+			double window = 0.54 - 0.46 * cos((2 * M_PI * n) / (length - 1));
+			double phase = (2 * M_PI * Q * n) / length;
+			temporal[start + n][0] = (2 * window / windowSum) * cos(phase);
+			temporal[start + n][1] = (2 * window / windowSum) * sin(phase);
+		}
+		fftw_execute_dft(fftPlanCache::getDFT(fftLength), temporal, spectral);
+
+		// By Parseval's theorem the correlation with the kernel is the
+		// correlation of the spectra divided by the length. Only the
+		// positive frequencies are kept as the input is real.
+		float largest = 0;
+		for(int j = 0; j <= fftLength / 2; j++)
+		{
+			rowReal[j] = (float)(spectral[j][0] / fftLength);
+			rowImag[j] = (float)(-spectral[j][1] / fftLength);
+			float size = hypotf(rowReal[j], rowImag[j]);
+			if(size > largest)
+				largest = size;
+		}
+		for(int j = 0; j <= fftLength / 2; j++)
+		{
+			if(hypotf(rowReal[j], rowImag[j]) < largest * CQT_KERNEL_THRESHOLD)
+				continue;
+			columns.push_back(j);
+			kernelReal.push_back(rowReal[j]);
+			kernelImag.push_back(rowImag[j]);
+		}
+		rowStart.push_back(columns.size());
+	}
+
+	fftw_free(temporal);
+	fftw_free(spectral);
+}
+
+void CQT::processPCMBlock(PCMBlock* block)
+{
+	int noFrames = block->dataLength / block->channels;
+	int rate = block->sampleRate ? block->sampleRate : PCM_DEFAULT_SAMPLE_RATE;
+
+	// Attempt to process the data, if not - skip this set of samples.
+	if(pthread_mutex_trylock(PCMDataMutex) != 0)
+		return;
+
+	if(rate != sampleRate)
+	{
+		freeKernels();
+		makeKernels(rate);
+	}
+
+	// Average the channels.
+	if(noFrames > mixedCapacity)
+	{
+		mixedCapacity = noFrames;
+		mixed = (float*)realloc(mixed, sizeof(float) * mixedCapacity);
+	}
+	pcmMixDown(block, mixed);
+
+	// Slide the window along. Until it is full the end is padded
+	// with silence.
+	float* newest = mixed;
+	if(noFrames > fftLength)
+	{
+		newest += noFrames - fftLength;
+		noFrames = fftLength;
+	}
+	int excess = (int)samples->size() + noFrames - fftLength;
+	if(excess > 0)
+		samples->commitRead(excess);
+	samples->write(newest, noFrames);
+
+	circularBuffer::segment<float> first, second;
+	int noSamples = samples->getReadSegments(first, second);
+	for(size_t i = 0; i < first.length; i++)
+		in[i] = first.data[i];
+	for(size_t i = 0; i < second.length; i++)
+		in[first.length + i] = second.data[i];
+	for(int i = noSamples; i < fftLength; i++)
+		in[i] = 0;
+
+	fftw_execute_dft_r2c(fftPlanCache::getR2C(fftLength), in, out);
+
+	// Multiply the spectrum by the sparse kernels.
+	int noBins = magnitude.size();
+	for(int k = 0; k < noBins; k++)
+	{
+		float real = 0;
+		float imag = 0;
+		for(int j = rowStart[k]; j < rowStart[k + 1]; j++)
+		{
+			float xReal = (float)out[columns[j]][0];
+			float xImag = (float)out[columns[j]][1];
+			real += (xReal * kernelReal[j]) - (xImag * kernelImag[j]);
+			imag += (xReal * kernelImag[j]) + (xImag * kernelReal[j]);
+		}
+		magnitude[k] = sqrtf((real * real) + (imag * imag));
+	}
+
+	// The middle of the window is heard half a window before the
+	// end of this block.
+	time = block->presentationTime;
+	if(block->sampleRate)
+	{
+		time += ((uint64_t)(block->dataLength / block->channels) * 1000000) / rate;
+		time -= ((uint64_t)fftLength * 500000) / rate;
+	}
+	hasData = true;
+
+	pthread_mutex_unlock(PCMDataMutex);
+}
+
+void* CQT::getDSPData()
+{
+	// Ensure we have some data
+	if(!hasData)
+		return NULL;
+
+	// grab the mutex
+	pthread_mutex_lock(PCMDataMutex);
+
+	// set the structure variables
+	CQTDataStruct->magnitude = &magnitude[0];
+	CQTDataStruct->noBins = magnitude.size();
+	CQTDataStruct->frequencies = &frequencies[0];
+	CQTDataStruct->binsPerOctave = binsPerOctave;
+	CQTDataStruct->time = time;
+
+	return (void*)CQTDataStruct;
+}
+
+void CQT::relenquishDSPData()
+{
+	pthread_mutex_unlock(PCMDataMutex);
+}
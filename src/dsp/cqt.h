@@ -0,0 +1,125 @@
+/****************************************
+ *
+ * cqt.h
+ * Declare a constant-Q transform plugin class.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CQT_H_
+#define _CQT_H_
+
+#include <fftw3.h>
+#include <pthread.h>
+#include <vector>
+#include "dsp.h"
+#include "../circularBuffer.h"
+
+// Spectral kernel values smaller than this fraction of the largest one
+// for their bin are dropped. See Brown and Puckette, "An efficient
+// algorithm for the calculation of a constant Q transform".
+#define CQT_KERNEL_THRESHOLD 0.0054
+
+typedef struct
+{
+	// The magnitude of each bin. A sine wave at the centre frequency
+	// of a bin with an amplitude of 1 gives a magnitude of about 1.
+	float* magnitude;
+	int noBins;
+
+	// The centre frequency of each bin in Hz.
+	float* frequencies;
+	int binsPerOctave;
+
+	// When the middle of the longest kernel is heard.
+	uint64_t time;
+}CQTData;
+
+/**
+ * Work out a constant-Q spectrum, where the bins are spaced evenly
+ * in pitch rather than in frequency, so there are as many bins in the
+ * bass as there are in each octave of the treble.
+ *
+ * Each bin is the correlation of the samples with a windowed sinusoid
+ * that is a fixed number of cycles long, so the low bins look at much
+ * more audio than the high ones. Rather than doing each correlation
+ * separately the kernels are transformed into the frequency domain
+ * once, where they are mostly zero. Each block then only costs one FFT
+ * of the longest kernel's length and a sparse matrix-vector product.
+ */
+class CQT : public DSP
+{
+	public:
+		/**
+		 * Construct the constant-Q plugin. The kernels are made when
+		 * the sample rate is known.
+		 * @param binsPerOctave the number of bins in each octave.
+		 * @param minFreq the centre frequency of the lowest bin in Hz.
+		 * @param maxFreq the highest frequency to analyse in Hz, it is
+		 * limited to below half the sample rate.
+		 */
+		CQT(int binsPerOctave = 12, double minFreq = 32.70,
+		    double maxFreq = 8000);
+		virtual ~CQT();
+		void processPCMBlock(PCMBlock* block);
+		void* getDSPData();
+		void relenquishDSPData();
+
+	private:
+		/**
+		 * Make the spectral kernels for a sample rate.
+		 */
+		void makeKernels(int sampleRate);
+
+		/**
+		 * Free the kernels and the buffers that depend on them.
+		 */
+		void freeKernels();
+
+		pthread_mutex_t* PCMDataMutex;
+		int binsPerOctave;
+		double minFreq;
+		double maxFreq;
+		int sampleRate;
+
+		// The length of the FFT, long enough for the lowest bin.
+		int fftLength;
+
+		// The spectral kernels as a compressed sparse row matrix with
+		// a row for each bin. The values are complex, split into their
+		// real and imaginary parts.
+		std::vector<int> rowStart;
+		std::vector<int> columns;
+		std::vector<float> kernelReal;
+		std::vector<float> kernelImag;
+
+		// The last fftLength frames of the averaged channels.
+		circularBuffer::circularBuffer<float>* samples;
+		float* mixed;
+		int mixedCapacity;
+		double* in;
+		fftw_complex* out;
+
+		std::vector<float> magnitude;
+		std::vector<float> frequencies;
+		uint64_t time;
+		bool hasData;
+		CQTData* CQTDataStruct;
+};
+
+#endif
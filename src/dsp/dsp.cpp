@@ -0,0 +1,55 @@
+/****************************************
+ *
+ * dsp.cpp
+ * Define the helpers shared by the DSP plugins.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "dsp.h"
+
+void pcmMixDown(const PCMBlock* block, float* out)
+{
+	int noFrames = block->dataLength / block->channels;
+	int noPlanes = block->channels < PCM_MAX_CHANNELS ? block->channels :
+	                                                    PCM_MAX_CHANNELS;
+	float scale = 1.0f / noPlanes;
+
+	if(block->planes[0] != NULL)
+	{
+		memcpy(out, block->planes[0], sizeof(float) * noFrames);
+		for(int c = 1; c < noPlanes; c++)
+			for(int i = 0; i < noFrames; i++)
+				out[i] += block->planes[c][i];
+		if(noPlanes > 1)
+			for(int i = 0; i < noFrames; i++)
+				out[i] *= scale;
+		return;
+	}
+
+	scale /= 32768.0f;
+	for(int i = 0; i < noFrames; i++)
+	{
+		const int16_t* frame = block->data + (i * block->channels);
+		int total = 0;
+		for(int c = 0; c < noPlanes; c++)
+			total += frame[c];
+		out[i] = total * scale;
+	}
+}
@@ -25,13 +25,99 @@
 #define _DSP_H_
 
 #include <stdint.h>
+#include <string>
+#include "../pcmFormat.h"
+
+// The sample rate that plugins assume for blocks that don't say
+// what theirs is.
+#define PCM_DEFAULT_SAMPLE_RATE 44100
 
 /**
- * A pure abstract class for defining a DSP plugin.
+ * A block of PCM data along with when it will be heard.
+ */
+typedef struct
+{
+	// The raw 16 bit signed PCM data, interleaved if there
+	// is more than one channel.
+	int16_t* data;
+
+	// The number of samples in data.
+	int dataLength;
+
+	// The sequence number of this block.
+	int SEQ;
+
+	// The format of the data. The sample rate is 0 if it isn't
+	// known, see PCM_DEFAULT_SAMPLE_RATE.
+	int sampleRate;
+	int channels;
+	pcmChannelLayout layout;
+
+	// The number of frames in data.
+	int noFrames;
+
+	// The samples of each channel as floats from -1 to 1, each
+	// plane is noFrames long. The DSPManager splits these out of
+	// data once for all of the plugins. Unused planes are NULL, if
+	// planes[0] is NULL then they haven't been split out.
+	float* planes[PCM_MAX_CHANNELS];
+
+	// The frame number of the first sample since
+	// playback started.
+	uint64_t samplePosition;
+
+	// The time, from monotonicTimeUs(), that the first
+	// sample will come out of the speakers.
+	uint64_t presentationTime;
+}PCMBlock;
+
+/**
+ * Average the channels of a block down to mono, for plugins that
+ * analyse a single signal. The block's planes are used if they have
+ * been split out.
+ * @param block the PCM data to mix.
+ * @param out where to put the mixed samples, from -1 to 1, at least
+ * as many floats as there are frames in the block.
+ */
+void pcmMixDown(const PCMBlock* block, float* out);
+
+/**
+ * An abstract class for defining a DSP plugin.
+ *
+ * Results that carry a time give when, from monotonicTimeUs(), the
+ * audio they describe is heard, normally the middle of the samples
+ * that were analysed, as that is what getDSPDataAt() is asked for.
  */
 class DSP
 {
 	public:
+		virtual ~DSP() {};
+
+		/**
+		 * Process some PCM data that there isn't any format or timing
+		 * information for. The data is treated as mono and passed to
+		 * processPCMBlock().
+		 * @param data the raw 16 bit signed PCM data.
+		 * @param len the number of samples in the buffer data.
+		 * @param SEQ the sequence number of this batch of PCM data.
+		 */
+		void processPCMData(int16_t* data, int len, int SEQ)
+		{
+			PCMBlock block;
+			block.data = data;
+			block.dataLength = len;
+			block.SEQ = SEQ;
+			block.sampleRate = 0;
+			block.channels = 1;
+			block.layout = PCM_LAYOUT_MONO;
+			block.noFrames = len;
+			for(int i = 0; i < PCM_MAX_CHANNELS; i++)
+				block.planes[i] = NULL;
+			block.samplePosition = 0;
+			block.presentationTime = 0;
+			processPCMBlock(&block);
+		}
+
 		/**
 		 * This function is called to process the PCM data. It is called by the
 		 * DSP worker thread and should run as fast as possible. If work is still
@@ -39,11 +125,9 @@ class DSP
 		 * then that batch of samples is discarded. You can use the SEQ number to
 		 * detect this. It will be incremented every time the DSPManager
 		 * class attempts to process PCM data.
-		 * @param data the raw 16 bit signed PCM data.
-		 * @param len the number of samples in the buffer data.
-		 * @param SEQ the sequence number of this batch of PCM data.
+		 * @param block the PCM data, its format and timing information.
 		 */
-		virtual void processPCMData(int16_t* data, int len, int SEQ) = 0;
+		virtual void processPCMBlock(PCMBlock* block) = 0;
 		
 		/**
 		 * This function is called by the visualiser class to get the PCM data.
@@ -52,6 +136,20 @@ class DSP
 		 * @returns a void pointer to the processed PCM data.
 		 */
 		virtual void* getDSPData() = 0;
+
+		/**
+		 * Get the DSP data for the audio that is heard at a certain time.
+		 * Plugins that keep a history of their results can use this to
+		 * interpolate between them, by default the latest data is returned.
+		 * @note the same locking rules as getDSPData() apply.
+		 * @param time the time, from monotonicTimeUs(), that the data will
+		 * be shown.
+		 * @returns a void pointer to the processed PCM data.
+		 */
+		virtual void* getDSPDataAt(uint64_t time)
+		{
+			return getDSPData();
+		}
 		
 		/**
 		 * This function should be called by the visualiser plugin to signify that
@@ -59,6 +157,15 @@ class DSP
 		 * during the next cycle.
 		 */
 		virtual void relenquishDSPData() = 0;
+
+		/**
+		 * This function is called when a new track starts playing. Plugins
+		 * that are able to should keep their results for the track in
+		 * cacheDir and use them rather than processing it again.
+		 * @param trackHash a hash of the track's file, 0 if unknown.
+		 * @param cacheDir the directory to keep cached results in.
+		 */
+		virtual void setTrack(uint64_t trackHash, const std::string& cacheDir) {};
 };
 
 #endif
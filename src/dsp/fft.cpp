@@ -23,9 +23,15 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #include "fft.h"
+#include "fftPlanCache.h"
 
-FFT::FFT(int noSampleSets)
+// Samples are scaled back up to the range of 16 bit samples before
+// the FFT, as that is what the visualisers are tuned for.
+#define SAMPLE_SCALE 32768.0
+
+FFT::FFT(int noSampleSets, fftChannelMode channelMode)
 {
 	// Initialise mutex
 	PCMDataMutex = new pthread_mutex_t;
@@ -35,10 +41,26 @@ FFT::FFT(int noSampleSets)
 	FFTDataStruct = new FFTData;
 	in = NULL;
 	out = NULL;
+	dataLength = 0;
+	amplitudeScale = 0;
 	this->noSampleSets = noSampleSets;
-	noSampleSetsInList = 0;
-	head = NULL;
-	tail = NULL;
+	this->channelMode = channelMode;
+	mixed = NULL;
+	mixedCapacity = 0;
+	planeStorage = NULL;
+	planeStorageCapacity = 0;
+	samples = NULL;
+	historyHead = 0;
+	historyCount = 0;
+	interpolated = NULL;
+	for(int i = 0; i < FFT_HISTORY_LENGTH; i++)
+	{
+		history[i].magnitude = NULL;
+		history[i].storage = NULL;
+	}
+	cache = new analysisCache();
+	trackHash = 0;
+	cacheOpened = false;
 }
 
 FFT::~FFT()
@@ -48,92 +70,319 @@ FFT::~FFT()
 		fftw_free(in);
 	if(out)
 		fftw_free(out);
+	if(samples)
+		delete samples;
 	if(FFTDataStruct)
 		delete FFTDataStruct;
+	for(int i = 0; i < FFT_HISTORY_LENGTH; i++)
+		free(history[i].storage);
+	free(interpolated);
+	free(mixed);
+	free(planeStorage);
+	delete cache;
 	delete PCMDataMutex;
 }
 
-void FFT::processPCMData(int16_t* data, int len, int SEQ)
+int FFT::mixChannels(PCMBlock* block)
 {
-	if(in == NULL)
-		in = (fftw_complex*)fftw_malloc((sizeof(fftw_complex) * len) * noSampleSets);
-	if(out == NULL)
-		out = (fftw_complex*)fftw_malloc((sizeof(fftw_complex) * len) * noSampleSets);
-	
-	// Attempt to process the data, if not - skip this set of samples.
-	if(pthread_mutex_trylock(PCMDataMutex) == 0)
+	int noFrames = block->dataLength / block->channels;
+	int noPlanes = block->channels < PCM_MAX_CHANNELS ? block->channels :
+	                                                    PCM_MAX_CHANNELS;
+	float* const* planes = block->planes;
+
+	// Split the channels out here if the block doesn't have them.
+	float* ownPlanes[PCM_MAX_CHANNELS];
+	if(planes[0] == NULL)
 	{
-		if(noSampleSets > 1)
+		if(noFrames * noPlanes > planeStorageCapacity)
 		{
-			// we need to add to the list.
+			planeStorageCapacity = noFrames * noPlanes;
+			planeStorage = (float*)realloc(planeStorage,
+			                               sizeof(float) * planeStorageCapacity);
+		}
+		for(int c = 0; c < noPlanes; c++)
+			ownPlanes[c] = planeStorage + (c * noFrames);
+		pcmDeinterleave(block->data, noFrames, block->channels, ownPlanes);
+		planes = ownPlanes;
+	}
 
-			// TODO: Ideally this should use a circular buffer that is
-			// preallocated so that memory isn't allocated and free'd for
-			// each set of samples, which, could be slow.
+	if(noFrames > mixedCapacity)
+	{
+		mixedCapacity = noFrames;
+		mixed = (float*)realloc(mixed, sizeof(float) * mixedCapacity);
+	}
 
-			// Create and initalise the struct.
-			linkedPCMData* newData = (linkedPCMData*)calloc(1, sizeof(newData));
-			newData->data = (int16_t*)calloc(len, sizeof(int16_t));
-			memcpy(newData->data, data, sizeof(int16_t) * len);
-			newData->dataLength = len;
-			newData->next = NULL;
+	// Mono audio is the same whichever way it is mixed, apart from
+	// having no side signal.
+	if(noPlanes == 1)
+	{
+		if(channelMode == FFT_CHANNEL_SIDE)
+			memset(mixed, 0, sizeof(float) * noFrames);
+		else
+			memcpy(mixed, planes[0], sizeof(float) * noFrames);
+		return noFrames;
+	}
 
-			// Now add it to the list.
-			if(head == NULL)
-			{
-				// We have an empty list.
-				head = newData;
-				tail = newData;
-			}
-			else
+	switch(channelMode)
+	{
+		case FFT_CHANNEL_SIDE:
+			for(int i = 0; i < noFrames; i++)
+				mixed[i] = (planes[0][i] - planes[1][i]) * 0.5f;
+			break;
+		case FFT_CHANNEL_LEFT:
+			memcpy(mixed, planes[0], sizeof(float) * noFrames);
+			break;
+		case FFT_CHANNEL_RIGHT:
+			memcpy(mixed, planes[1], sizeof(float) * noFrames);
+			break;
+		default:
+		{
+			float scale = 1.0f / noPlanes;
+			for(int i = 0; i < noFrames; i++)
 			{
-				tail->next = newData;
-				tail = newData;
+				float total = 0;
+				for(int c = 0; c < noPlanes; c++)
+					total += planes[c][i];
+				mixed[i] = total * scale;
 			}
-
-			noSampleSetsInList++;
+			break;
 		}
-		// We locked the mutex, now do some processing.
-		if(noSampleSets == 1)
-			for(int i = 0; i < len; i++)
-				in[i][0] = data[i];
-		else
+	}
+
+	return noFrames;
+}
+
+void FFT::processPCMBlock(PCMBlock* block)
+{
+	int len = block->dataLength / block->channels;
+	int windowLength = len * noSampleSets;
+
+	if(in == NULL)
+	{
+		in = (double*)fftw_malloc(sizeof(double) * windowLength);
+		out = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * ((windowLength / 2) + 1));
+		samples = new circularBuffer::circularBuffer<float>(windowLength);
+
+		int maxLength = windowLength / 2;
+		for(int i = 0; i < FFT_HISTORY_LENGTH; i++)
 		{
-			linkedPCMData* current = head;
-			int indexOffset = 0;
-			while(current)
-			{
-				for(int i = 0 ; i < current->dataLength; i++)
-					in[i + indexOffset][0] = current->data[i];
+			history[i].storage = (float*)calloc(maxLength, sizeof(float));
+			history[i].magnitude = history[i].storage;
+		}
+		interpolated = (float*)calloc(maxLength, sizeof(float));
+	}
+	
+	// Attempt to process the data, if not - skip this set of samples.
+	if(pthread_mutex_trylock(PCMDataMutex) == 0)
+	{
+		if(!cacheOpened)
+			openCache(block);
 
-				indexOffset += current->dataLength;
-				current = current->next;
-			}
+		// Look the result up if this track has been analysed before.
+		uint64_t hop = 0;
+		if(block->sampleRate)
+			hop = block->samplePosition / len;
+		if(cache->isReading() && addCachedToHistory(analysisTime(block), hop))
+		{
+			amplitudeScale = 1.0 / (SAMPLE_SCALE * block->channels * dataLength);
+			pthread_mutex_unlock(PCMDataMutex);
+			return;
 		}
+
+		// Slide the window along, dropping the oldest block.
+		mixChannels(block);
+		int excess = (int)samples->size() + len - windowLength;
+		if(excess > 0)
+			samples->commitRead(excess);
+		samples->write(mixed, len);
+
+		// Copy the window into the FFT input. Until enough blocks
+		// have arrived the end is padded with silence. The samples
+		// are scaled so that a window has the same energy as the
+		// interleaved samples that used to be analysed.
+		double scale = SAMPLE_SCALE * block->channels;
+		circularBuffer::segment<float> first, second;
+		int noSamples = samples->getReadSegments(first, second);
+		for(size_t i = 0; i < first.length; i++)
+			in[i] = first.data[i] * scale;
+		for(size_t i = 0; i < second.length; i++)
+			in[first.length + i] = second.data[i] * scale;
+		for(int i = noSamples; i < windowLength; i++)
+			in[i] = 0;
+
 		// Perform the FFT
-		fftw_plan p;
-		p = fftw_plan_dft_1d(len * noSampleSets, in, out, FFTW_FORWARD, FFTW_MEASURE);
-		fftw_execute(p);
+		fftw_execute_dft_r2c(fftPlanCache::getR2C(windowLength), in, out);
 		
-		// set the number of output frquency domain values.
-		dataLength = (len * noSampleSets)/4;
+		// set the number of output frquency domain values, every
+		// bin up to the Nyquist frequency.
+		dataLength = windowLength / 2;
+		amplitudeScale = 1.0 / (SAMPLE_SCALE * block->channels * dataLength);
 
+		FFTHistoryEntry* entry = addToHistory(analysisTime(block));
+		if(cache->isWriting())
+			cache->writeHop(hop, entry->magnitude, entry->bands, entry->onset);
 
-		// Pop off an element if we are at the right size.
-		if(noSampleSetsInList == noSampleSets)
-		{
-			linkedPCMData* old = head;
-			head = head->next;
-			free(old->data);
-			free(old);
-			noSampleSetsInList--;
-		}
-		// destroy the plan and unlock the mutex so the data can be accessed.
-		fftw_destroy_plan(p);
+		// unlock the mutex so the data can be accessed.
 		pthread_mutex_unlock(PCMDataMutex);
 	}
 }
 
+uint64_t FFT::analysisTime(PCMBlock* block)
+{
+	// The analysed samples end with this block, so the middle
+	// of them is heard half the window before the block ends.
+	uint64_t time = block->presentationTime;
+	if(block->sampleRate)
+	{
+		uint64_t blockUs = ((uint64_t)(block->dataLength / block->channels) * 1000000) /
+		                   block->sampleRate;
+		time += blockUs;
+		time -= (blockUs * noSampleSets) / 2;
+	}
+	return time;
+}
+
+void FFT::setTrack(uint64_t trackHash, const std::string& cacheDir)
+{
+	pthread_mutex_lock(PCMDataMutex);
+
+	// Finish off the cache for the last track.
+	if(cache->isWriting())
+		cache->finish();
+	cache->close();
+
+	// The history may point into the cache that was just closed.
+	for(int i = 0; i < FFT_HISTORY_LENGTH; i++)
+		history[i].magnitude = history[i].storage;
+	historyCount = 0;
+
+	this->trackHash = trackHash;
+	this->cacheDir = cacheDir;
+	cacheOpened = false;
+	pthread_mutex_unlock(PCMDataMutex);
+}
+
+void FFT::openCache(PCMBlock* block)
+{
+	cacheOpened = true;
+	if(trackHash == 0 || block->sampleRate == 0)
+		return;
+
+	analysisParameters params;
+	params.sampleRate = block->sampleRate;
+	params.channels = block->channels;
+	params.hopSize = block->dataLength / block->channels;
+	params.windowSize = params.hopSize * noSampleSets;
+	params.noBins = params.windowSize / 2;
+	params.noBands = FFT_NO_BANDS;
+	params.channelMode = channelMode;
+
+	if(!cache->openForReading(cacheDir, trackHash, params))
+		cache->openForWriting(cacheDir, trackHash, params);
+}
+
+FFTHistoryEntry* FFT::nextHistoryEntry(uint64_t time)
+{
+	historyHead = (historyHead + 1) % FFT_HISTORY_LENGTH;
+	if(historyCount < FFT_HISTORY_LENGTH)
+		historyCount++;
+
+	FFTHistoryEntry* entry = &history[historyHead];
+	entry->time = time;
+	return entry;
+}
+
+FFTHistoryEntry* FFT::addToHistory(uint64_t time)
+{
+	FFTHistoryEntry* previous = historyCount ? &history[historyHead] : NULL;
+	FFTHistoryEntry* entry = nextHistoryEntry(time);
+	entry->magnitude = entry->storage;
+
+	// Find the magnitude of each bin and how much it has risen by.
+	float rise = 0;
+	for(int i = 0; i < dataLength; i++)
+	{
+		entry->magnitude[i] = (float)sqrt((out[i][0] * out[i][0]) +
+		                                  (out[i][1] * out[i][1]));
+		if(previous && entry->magnitude[i] > previous->magnitude[i])
+			rise += entry->magnitude[i] - previous->magnitude[i];
+	}
+	entry->onset = rise / dataLength;
+
+	// Average the octave bands.
+	int start = 0;
+	for(int b = 0; b < FFT_NO_BANDS; b++)
+	{
+		int end = dataLength >> (FFT_NO_BANDS - 1 - b);
+		float total = 0;
+		for(int i = start; i < end; i++)
+			total += entry->magnitude[i];
+		entry->bands[b] = end > start ? total / (end - start) : 0;
+		start = end;
+	}
+
+	return entry;
+}
+
+bool FFT::addCachedToHistory(uint64_t time, uint64_t hop)
+{
+	const float* spectrum = cache->getSpectrum(hop);
+	if(spectrum == NULL)
+		return false;
+
+	dataLength = (int)(cache->getBands(hop) - spectrum);
+	FFTHistoryEntry* entry = nextHistoryEntry(time);
+	entry->magnitude = (float*)spectrum;
+	memcpy(entry->bands, cache->getBands(hop), sizeof(entry->bands));
+	entry->onset = cache->getOnset(hop);
+
+	// Keep the complex output meaningful for visualisers that use
+	// it, it has the right modulus but no phase.
+	for(int i = 0; i < dataLength; i++)
+	{
+		out[i][0] = spectrum[i];
+		out[i][1] = 0;
+	}
+	return true;
+}
+
+void FFT::interpolateHistory(uint64_t time)
+{
+	// Walk back from the newest entry to find the pair either
+	// side of the requested time.
+	FFTHistoryEntry* newer = &history[historyHead];
+	FFTHistoryEntry* older = newer;
+	for(int i = 1; i < historyCount; i++)
+	{
+		int index = (historyHead - i + FFT_HISTORY_LENGTH) % FFT_HISTORY_LENGTH;
+		older = &history[index];
+		if(older->time <= time)
+			break;
+		newer = older;
+	}
+
+	// Hold the newest or oldest result if the time is outside
+	// of the history.
+	float t;
+	if(time >= newer->time || older == newer)
+	{
+		older = newer;
+		t = 0;
+	}
+	else if(time <= older->time)
+		t = 0;
+	else
+		t = (float)(time - older->time) / (float)(newer->time - older->time);
+
+	for(int i = 0; i < dataLength; i++)
+		interpolated[i] = older->magnitude[i] +
+		                  (t * (newer->magnitude[i] - older->magnitude[i]));
+	for(int b = 0; b < FFT_NO_BANDS; b++)
+		interpolatedBands[b] = older->bands[b] +
+		                       (t * (newer->bands[b] - older->bands[b]));
+	interpolatedOnset = older->onset + (t * (newer->onset - older->onset));
+}
+
 void* FFT::getDSPData()
 {
 	// Ensure we have some data
@@ -143,10 +392,67 @@ void* FFT::getDSPData()
 	// grab the mutex
 	pthread_mutex_lock(PCMDataMutex);
 	
+	return (void*)latestData();
+}
+
+void* FFT::tryGetDSPData()
+{
+	// Ensure we have some data
+	if(out == NULL)
+		return out;
+
+	// Don't wait if the data is being used.
+	if(pthread_mutex_trylock(PCMDataMutex) != 0)
+		return NULL;
+
+	return (void*)latestData();
+}
+
+FFTData* FFT::latestData()
+{
 	// set the structure variables
 	FFTDataStruct->data = out;
 	FFTDataStruct->dataLength = dataLength;
+	FFTDataStruct->amplitudeScale = amplitudeScale;
+	FFTDataStruct->magnitude = history[historyHead].magnitude;
+	FFTDataStruct->bands = history[historyHead].bands;
+	FFTDataStruct->noBands = FFT_NO_BANDS;
+	FFTDataStruct->onset = history[historyHead].onset;
+	FFTDataStruct->time = history[historyHead].time;
 	
+	return FFTDataStruct;
+}
+
+void* FFT::getDSPDataAt(uint64_t time)
+{
+	// Ensure we have some data
+	if(out == NULL)
+		return out;
+
+	// grab the mutex
+	pthread_mutex_lock(PCMDataMutex);
+
+	// set the structure variables
+	FFTDataStruct->data = out;
+	FFTDataStruct->dataLength = dataLength;
+	FFTDataStruct->amplitudeScale = amplitudeScale;
+	FFTDataStruct->noBands = FFT_NO_BANDS;
+	if(historyCount > 0)
+	{
+		interpolateHistory(time);
+		FFTDataStruct->magnitude = interpolated;
+		FFTDataStruct->bands = interpolatedBands;
+		FFTDataStruct->onset = interpolatedOnset;
+		FFTDataStruct->time = time;
+	}
+	else
+	{
+		FFTDataStruct->magnitude = history[historyHead].magnitude;
+		FFTDataStruct->bands = history[historyHead].bands;
+		FFTDataStruct->onset = 0;
+		FFTDataStruct->time = 0;
+	}
+
 	return (void*)FFTDataStruct;
 }
 
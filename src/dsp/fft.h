@@ -26,20 +26,74 @@
 
 #include <fftw3.h>
 #include <pthread.h>
+#include <string>
 #include "dsp.h"
+#include "analysisCache.h"
+#include "../circularBuffer.h"
+
+// The number of past results kept for interpolation.
+#define FFT_HISTORY_LENGTH 8
+
+// The number of octave wide bands the spectrum is summarised into.
+#define FFT_NO_BANDS 8
+
+/**
+ * Which signal the FFT plugin analyses. To analyse each channel
+ * separately register a plugin for each one.
+ */
+typedef enum
+{
+	// The average of all of the channels.
+	FFT_CHANNEL_MID,
+
+	// Half the difference between the left and right channels.
+	FFT_CHANNEL_SIDE,
+
+	// Just the left or right channel. Mono audio is used as it is.
+	FFT_CHANNEL_LEFT,
+	FFT_CHANNEL_RIGHT
+}fftChannelMode;
 
 typedef struct
 {
 	fftw_complex* data;
 	int dataLength;
+
+	// What to multiply a magnitude by to get the amplitude, from 0
+	// to 1, of a sine wave in that bin.
+	float amplitudeScale;
+
+	// The modulus of each element in data. When the data is
+	// requested for a certain time this is interpolated between
+	// the two results either side of that time.
+	// @note this may point into a read only cache file.
+	float* magnitude;
+
+	// The mean magnitude of each octave band, the last band ends
+	// at dataLength and each one below is half as wide.
+	float* bands;
+	int noBands;
+
+	// The onset strength, the mean rise in magnitude since the
+	// previous result.
+	float onset;
+
+	// The time that the middle of the analysed samples is heard.
+	uint64_t time;
 }FFTData;
 
-typedef struct lpcmd
+/**
+ * A past FFT result.
+ */
+typedef struct
 {
-	int16_t* data;
-	int dataLength;
-	struct lpcmd* next;
-}linkedPCMData;
+	// Either storage or a spectrum in the analysis cache.
+	float* magnitude;
+	float* storage;
+	float bands[FFT_NO_BANDS];
+	float onset;
+	uint64_t time;
+}FFTHistoryEntry;
 
 /**
  * Perform a FFT on the PCM data and send
@@ -52,24 +106,118 @@ class FFT : public DSP
 		 * Construct the FFT plugin.
 		 *
 		 * @param noSampleSets This will determine the number of sets
-		 * of samples that the plugin stores to do the FFT.
+		 * of samples that the plugin stores to do the FFT. Large
+		 * transforms can be split over threads with
+		 * fftPlanCache::setThreads().
+		 * @param channelMode which signal to analyse when there is
+		 * more than one channel.
 		 */
-		FFT(int noSampleSets = 1);
+		FFT(int noSampleSets = 1, fftChannelMode channelMode = FFT_CHANNEL_MID);
 		virtual ~FFT();
-		void processPCMData(int16_t* data, int len, int SEQ);
+		void processPCMBlock(PCMBlock* block);
 		void* getDSPData();
+		void* getDSPDataAt(uint64_t time);
 		void relenquishDSPData();
+
+		/**
+		 * Get the latest result without waiting for the lock, for
+		 * plugins that use the spectrum on the DSP worker thread.
+		 * @note relenquishDSPData() must be called if this doesn't
+		 * return NULL.
+		 * @returns the latest FFTData, or NULL if there isn't any yet
+		 * or the lock is held.
+		 */
+		void* tryGetDSPData();
+
+		/**
+		 * Use an analysis cache for a track. If there is a cache file
+		 * for the track the FFT isn't run, the results are looked up
+		 * from the cache instead. Otherwise a cache file is written
+		 * as the track is played.
+		 */
+		void setTrack(uint64_t trackHash, const std::string& cacheDir);
 	
 	private:
+		/**
+		 * Make the signal that is analysed from the block's channels.
+		 * @returns the number of frames written to mixed.
+		 */
+		int mixChannels(PCMBlock* block);
+
+		/**
+		 * Work out when the middle of the analysed samples is heard.
+		 */
+		uint64_t analysisTime(PCMBlock* block);
+
+		/**
+		 * Open the cache for the current track once the format
+		 * of the data is known.
+		 */
+		void openCache(PCMBlock* block);
+
+		/**
+		 * Move on to the next history entry.
+		 * @returns the entry to fill in.
+		 */
+		FFTHistoryEntry* nextHistoryEntry(uint64_t time);
+
+		/**
+		 * Store the modulus of the latest result in the history.
+		 * @returns the new history entry.
+		 */
+		FFTHistoryEntry* addToHistory(uint64_t time);
+
+		/**
+		 * Store a result from the cache in the history.
+		 * @returns false if the cache doesn't have the hop.
+		 */
+		bool addCachedToHistory(uint64_t time, uint64_t hop);
+
+		/**
+		 * Interpolate the history to find the magnitude at time.
+		 */
+		void interpolateHistory(uint64_t time);
+
+		/**
+		 * Fill in the FFTData with the latest result.
+		 * @note the caller must hold the lock.
+		 */
+		FFTData* latestData();
+
 		pthread_mutex_t* PCMDataMutex;
-		linkedPCMData* head;
-		linkedPCMData* tail;
 		int noSampleSets;
-		int noSampleSetsInList;
-		fftw_complex* in;
+		fftChannelMode channelMode;
+
+		// The signal made from the latest block, and somewhere to
+		// split out the channels of blocks that didn't come with them.
+		float* mixed;
+		int mixedCapacity;
+		float* planeStorage;
+		int planeStorageCapacity;
+
+		// The last noSampleSets blocks of the signal.
+		circularBuffer::circularBuffer<float>* samples;
+		double* in;
 		fftw_complex* out;
 		int dataLength;
+		float amplitudeScale;
 		FFTData* FFTDataStruct;
+
+		// A ring of past results, historyHead is the newest.
+		FFTHistoryEntry history[FFT_HISTORY_LENGTH];
+		int historyHead;
+		int historyCount;
+
+		// Where interpolated results are written.
+		float* interpolated;
+		float interpolatedBands[FFT_NO_BANDS];
+		float interpolatedOnset;
+
+		// The analysis cache for the current track.
+		analysisCache* cache;
+		uint64_t trackHash;
+		std::string cacheDir;
+		bool cacheOpened;
 };
 
 #endif
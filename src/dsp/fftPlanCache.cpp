@@ -0,0 +1,149 @@
+/****************************************
+ *
+ * fftPlanCache.cpp
+ * Define a process wide cache of FFTW plans.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <pthread.h>
+#include <map>
+#include <utility>
+#include "fftPlanCache.h"
+
+enum
+{
+	PLAN_DFT,
+	PLAN_R2C,
+	PLAN_C2R,
+	PLAN_R2R
+};
+
+// Plans are keyed by type, kind, size and number of threads.
+typedef std::pair<std::pair<int, int>, std::pair<int, int> > planKey;
+typedef std::map<planKey, fftw_plan> planMap;
+
+static pthread_mutex_t planMutex = PTHREAD_MUTEX_INITIALIZER;
+static planMap plans;
+
+// The threads asked for with setThreads().
+static int planThreads = 1;
+static int planThreadThreshold = FFT_PLAN_THREAD_THRESHOLD;
+#ifdef HAVE_FFTW_THREADS
+static bool threadsInitialised = false;
+#endif
+
+fftw_plan fftPlanCache::getDFT(int n)
+{
+	return getPlan(PLAN_DFT, n, FFTW_R2HC);
+}
+
+fftw_plan fftPlanCache::getR2C(int n)
+{
+	return getPlan(PLAN_R2C, n, FFTW_R2HC);
+}
+
+fftw_plan fftPlanCache::getC2R(int n)
+{
+	return getPlan(PLAN_C2R, n, FFTW_R2HC);
+}
+
+fftw_plan fftPlanCache::getR2R(int n, fftw_r2r_kind kind)
+{
+	return getPlan(PLAN_R2R, n, kind);
+}
+
+bool fftPlanCache::setThreads(int noThreads, int threshold)
+{
+#ifdef HAVE_FFTW_THREADS
+	pthread_mutex_lock(&planMutex);
+	if(!threadsInitialised)
+		threadsInitialised = fftw_init_threads() != 0;
+	planThreads = threadsInitialised && noThreads > 1 ? noThreads : 1;
+	planThreadThreshold = threshold;
+	bool ok = threadsInitialised;
+	pthread_mutex_unlock(&planMutex);
+	return ok;
+#else
+	pthread_mutex_lock(&planMutex);
+	planThreadThreshold = threshold;
+	pthread_mutex_unlock(&planMutex);
+	return noThreads <= 1;
+#endif
+}
+
+int fftPlanCache::getThreads(int n)
+{
+	pthread_mutex_lock(&planMutex);
+	int threads = n >= planThreadThreshold ? planThreads : 1;
+	pthread_mutex_unlock(&planMutex);
+	return threads;
+}
+
+fftw_plan fftPlanCache::getPlan(int type, int n, fftw_r2r_kind kind)
+{
+	pthread_mutex_lock(&planMutex);
+	int threads = n >= planThreadThreshold ? planThreads : 1;
+	planKey key(std::make_pair(type, (int)kind), std::make_pair(n, threads));
+
+	planMap::iterator i = plans.find(key);
+	if(i != plans.end())
+	{
+		pthread_mutex_unlock(&planMutex);
+		return i->second;
+	}
+
+#ifdef HAVE_FFTW_THREADS
+	// The number of threads is part of the planner's state, which
+	// the mutex protects along with the rest of it.
+	if(threadsInitialised)
+		fftw_plan_with_nthreads(threads);
+#endif
+
+	// FFTW_MEASURE scribbles over the arrays, so plan on some
+	// scratch ones rather than the caller's.
+	fftw_complex* in = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * n);
+	fftw_complex* out = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * n);
+
+	fftw_plan p = NULL;
+	switch(type)
+	{
+		case PLAN_DFT:
+			p = fftw_plan_dft_1d(n, in, out, FFTW_FORWARD, FFTW_MEASURE);
+			break;
+		case PLAN_R2C:
+			p = fftw_plan_dft_r2c_1d(n, (double*)in, out, FFTW_MEASURE);
+			break;
+		case PLAN_C2R:
+			p = fftw_plan_dft_c2r_1d(n, in, (double*)out, FFTW_MEASURE);
+			break;
+		case PLAN_R2R:
+			p = fftw_plan_r2r_1d(n, (double*)in, (double*)out, kind, FFTW_MEASURE);
+			break;
+	}
+
+	fftw_free(in);
+	fftw_free(out);
+
+	plans[key] = p;
+	pthread_mutex_unlock(&planMutex);
+	return p;
+}
@@ -0,0 +1,102 @@
+/****************************************
+ *
+ * fftPlanCache.h
+ * Declare a process wide cache of FFTW plans.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FFTPLANCACHE_H_
+#define _FFTPLANCACHE_H_
+
+#include <fftw3.h>
+
+// The default size from which transforms are split over threads, if
+// threads have been asked for. Below this the cost of handing work to
+// the threads is more than they save.
+#define FFT_PLAN_THREAD_THRESHOLD 16384
+
+/**
+ * FFTW's planner is slow and isn't thread safe, but executing a plan
+ * is. This keeps one plan for each kind and size of transform that is
+ * shared by every thread in the process.
+ *
+ * The plans are made out of place on arrays from fftw_malloc(), so they
+ * must be executed with the new-array execute functions, eg
+ * fftw_execute_dft_r2c(), on distinct arrays that were also allocated
+ * with fftw_malloc().
+ *
+ * If FFTW was built with threads, transforms from a certain size up can
+ * be planned to use more than one thread, see setThreads().
+ */
+class fftPlanCache
+{
+	public:
+		/**
+		 * Get a forward complex to complex plan.
+		 * @param n the size of the transform.
+		 */
+		static fftw_plan getDFT(int n);
+
+		/**
+		 * Get a real to complex plan. The output has n / 2 + 1 elements.
+		 * @param n the size of the transform.
+		 */
+		static fftw_plan getR2C(int n);
+
+		/**
+		 * Get a complex to real plan. The input has n / 2 + 1 elements.
+		 * @note the input array is destroyed when the plan is executed.
+		 * @param n the size of the transform.
+		 */
+		static fftw_plan getC2R(int n);
+
+		/**
+		 * Get a real to real plan, such as a DCT.
+		 * @param n the size of the transform.
+		 * @param kind the kind of transform.
+		 */
+		static fftw_plan getR2R(int n, fftw_r2r_kind kind);
+
+		/**
+		 * Set how many threads plans made from now on use. Plans that
+		 * have already been made are kept as they are.
+		 * @param noThreads the number of threads, 1 to not use threads.
+		 * @param threshold the size from which transforms use the
+		 * threads, smaller ones always use one thread.
+		 * @returns false if FFTW wasn't built with threads, in which
+		 * case one thread is always used.
+		 */
+		static bool setThreads(int noThreads,
+		                       int threshold = FFT_PLAN_THREAD_THRESHOLD);
+
+		/**
+		 * Get the number of threads a transform of size n would be
+		 * planned with.
+		 */
+		static int getThreads(int n);
+
+	private:
+		/**
+		 * Find a plan in the cache, or make it.
+		 * @param type which of the get functions wants the plan.
+		 */
+		static fftw_plan getPlan(int type, int n, fftw_r2r_kind kind);
+};
+
+#endif
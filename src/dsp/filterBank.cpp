@@ -0,0 +1,233 @@
+/****************************************
+ *
+ * filterBank.cpp
+ * Define a filter bank plugin class.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <exception>
+#include "filterBank.h"
+#include "../util/alignedAlloc.h"
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+// Added to every frame so that the filters never decay into denormal
+// numbers during silence, which are very slow to work with.
+#define FILTERBANK_DENORMAL_OFFSET 1e-18f
+
+FilterBank::FilterBank(int noBands, double minFreq, double maxFreq,
+                       double attackTime, double releaseTime)
+{
+	PCMDataMutex = new pthread_mutex_t;
+	pthread_mutex_init(PCMDataMutex, NULL);
+
+	this->noBands = noBands;
+	this->minFreq = minFreq;
+	this->maxFreq = maxFreq;
+	this->attackTime = attackTime;
+	this->releaseTime = releaseTime;
+	stride = (noBands + 3) & ~3;
+	sampleRate = 0;
+	attack = 0;
+	release = 0;
+
+	b0 = allocAlignedFloats(stride);
+	b2 = allocAlignedFloats(stride);
+	a1 = allocAlignedFloats(stride);
+	a2 = allocAlignedFloats(stride);
+	z1 = allocAlignedFloats(stride);
+	z2 = allocAlignedFloats(stride);
+	level = allocAlignedFloats(stride);
+	if(b0 == NULL || b2 == NULL || a1 == NULL || a2 == NULL ||
+	   z1 == NULL || z2 == NULL || level == NULL)
+		throw(std::exception());
+
+	// Space the bands evenly in pitch.
+	frequencies.resize(noBands);
+	for(int b = 0; b < noBands; b++)
+	{
+		double position = noBands > 1 ? (double)b / (noBands - 1) : 0;
+		frequencies[b] = (float)(minFreq * pow(maxFreq / minFreq, position));
+	}
+
+	envelope.assign(noBands, 0);
+	time = 0;
+	hasData = false;
+	FilterBankDataStruct = new FilterBankData;
+}
+
+FilterBank::~FilterBank()
+{
+	free(b0);
+	free(b2);
+	free(a1);
+	free(a2);
+	free(z1);
+	free(z2);
+	free(level);
+	delete FilterBankDataStruct;
+	pthread_mutex_destroy(PCMDataMutex);
+	delete PCMDataMutex;
+}
+
+void FilterBank::setSampleRate(int sampleRate)
+{
+	this->sampleRate = sampleRate;
+
+	// Each band reaches halfway to its neighbours.
+	double bandwidth = noBands > 1 ? log2(maxFreq / minFreq) / (noBands - 1) : 1;
+
+	// Band-pass filters with a peak gain of 1, see the Audio EQ
+	// Cookbook by Robert Bristow-Johnson.
+	for(int b = 0; b < noBands; b++)
+	{
+		double centre = frequencies[b];
+		if(centre > sampleRate * 0.45)
+			centre = sampleRate * 0.45;
+		double w = (2 * M_PI * centre) / sampleRate;
+		double alpha = sin(w) * sinh((log(2.0) / 2) * bandwidth * (w / sin(w)));
+		double scale = 1 / (1 + alpha);
+		b0[b] = (float)(alpha * scale);
+		b2[b] = (float)(-alpha * scale);
+		a1[b] = (float)(-2 * cos(w) * scale);
+		a2[b] = (float)((1 - alpha) * scale);
+	}
+
+	attack = (float)(1 - exp(-1 / (attackTime * sampleRate)));
+	release = (float)(1 - exp(-1 / (releaseTime * sampleRate)));
+
+	// Start again from silence.
+	memset(z1, 0, sizeof(float) * stride);
+	memset(z2, 0, sizeof(float) * stride);
+	memset(level, 0, sizeof(float) * stride);
+}
+
+void FilterBank::processPCMBlock(PCMBlock* block)
+{
+	int noFrames = block->dataLength / block->channels;
+	int rate = block->sampleRate ? block->sampleRate : PCM_DEFAULT_SAMPLE_RATE;
+
+	if(rate != sampleRate)
+		setSampleRate(rate);
+
+	// Average the channels.
+	if((int)mixed.size() < noFrames)
+		mixed.resize(noFrames);
+	pcmMixDown(block, &mixed[0]);
+	for(int i = 0; i < noFrames; i++)
+		mixed[i] += FILTERBANK_DENORMAL_OFFSET;
+
+	// Run the whole block through four bands at a time, so their
+	// state stays in registers. The filters are in transposed direct
+	// form II:
+	//   y = b0 * x + z1
+	//   z1 = z2 - a1 * y
+	//   z2 = b2 * x - a2 * y
+	// The state is only used by this thread so the lock isn't needed.
+#ifdef __SSE__
+	__m128 vAttack = _mm_set1_ps(attack);
+	__m128 vRelease = _mm_set1_ps(release);
+	__m128 signMask = _mm_set1_ps(-0.0f);
+	for(int b = 0; b < stride; b += 4)
+	{
+		__m128 vb0 = _mm_load_ps(b0 + b);
+		__m128 vb2 = _mm_load_ps(b2 + b);
+		__m128 va1 = _mm_load_ps(a1 + b);
+		__m128 va2 = _mm_load_ps(a2 + b);
+		__m128 vz1 = _mm_load_ps(z1 + b);
+		__m128 vz2 = _mm_load_ps(z2 + b);
+		__m128 vLevel = _mm_load_ps(level + b);
+		for(int i = 0; i < noFrames; i++)
+		{
+			__m128 x = _mm_set1_ps(mixed[i]);
+			__m128 y = _mm_add_ps(_mm_mul_ps(vb0, x), vz1);
+			vz1 = _mm_sub_ps(vz2, _mm_mul_ps(va1, y));
+			vz2 = _mm_sub_ps(_mm_mul_ps(vb2, x), _mm_mul_ps(va2, y));
+
+			// Move the envelope towards the rectified output at the
+			// attack rate if it is rising and release rate if not.
+			__m128 rectified = _mm_andnot_ps(signMask, y);
+			__m128 rising = _mm_cmpgt_ps(rectified, vLevel);
+			__m128 rate = _mm_or_ps(_mm_and_ps(rising, vAttack),
+			                        _mm_andnot_ps(rising, vRelease));
+			vLevel = _mm_add_ps(vLevel,
+			                    _mm_mul_ps(rate, _mm_sub_ps(rectified, vLevel)));
+		}
+		_mm_store_ps(z1 + b, vz1);
+		_mm_store_ps(z2 + b, vz2);
+		_mm_store_ps(level + b, vLevel);
+	}
+#else
+	for(int b = 0; b < noBands; b++)
+	{
+		for(int i = 0; i < noFrames; i++)
+		{
+			float x = mixed[i];
+			float y = (b0[b] * x) + z1[b];
+			z1[b] = z2[b] - (a1[b] * y);
+			z2[b] = (b2[b] * x) - (a2[b] * y);
+
+			// Move the envelope towards the rectified output at the
+			// attack rate if it is rising and release rate if not.
+			float rectified = fabsf(y);
+			float rate = rectified > level[b] ? attack : release;
+			level[b] += rate * (rectified - level[b]);
+		}
+	}
+#endif
+
+	// Make the new envelopes available if nobody is reading the last
+	// ones, otherwise they will be picked up after the next block.
+	if(pthread_mutex_trylock(PCMDataMutex) != 0)
+		return;
+
+	for(int b = 0; b < noBands; b++)
+		envelope[b] = level[b];
+	time = block->presentationTime + (((uint64_t)noFrames * 1000000) / rate);
+	hasData = true;
+
+	pthread_mutex_unlock(PCMDataMutex);
+}
+
+void* FilterBank::getDSPData()
+{
+	// Ensure we have some data
+	if(!hasData)
+		return NULL;
+
+	// grab the mutex
+	pthread_mutex_lock(PCMDataMutex);
+
+	// set the structure variables
+	FilterBankDataStruct->envelope = &envelope[0];
+	FilterBankDataStruct->noBands = noBands;
+	FilterBankDataStruct->frequencies = &frequencies[0];
+	FilterBankDataStruct->time = time;
+
+	return (void*)FilterBankDataStruct;
+}
+
+void FilterBank::relenquishDSPData()
+{
+	pthread_mutex_unlock(PCMDataMutex);
+}
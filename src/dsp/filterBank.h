@@ -0,0 +1,123 @@
+/****************************************
+ *
+ * filterBank.h
+ * Declare a filter bank plugin class.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FILTERBANK_H_
+#define _FILTERBANK_H_
+
+#include <pthread.h>
+#include <vector>
+#include "dsp.h"
+
+typedef struct
+{
+	// The envelope of each band. As the envelopes rise much faster
+	// than they fall they sit near the peaks, a steady sine wave of
+	// amplitude A at the centre of a band gives a little under A.
+	float* envelope;
+	int noBands;
+
+	// The centre frequency of each band in Hz.
+	const float* frequencies;
+
+	// The time that the last sample filtered is heard.
+	uint64_t time;
+}FilterBankData;
+
+/**
+ * Split the audio into bands with a bank of band-pass filters and
+ * follow the level of each one.
+ *
+ * This doesn't have to wait for a block to fill up as the FFT plugin
+ * does, so the envelopes lag the audio by only a few milliseconds.
+ * Each band is a biquad filter followed by an envelope follower that
+ * rises with the attack time and falls with the release time.
+ *
+ * The filter coefficents and state are kept in an array for each term
+ * so that four bands are filtered at once with SSE.
+ */
+class FilterBank : public DSP
+{
+	public:
+		/**
+		 * Construct the filter bank plugin.
+		 * @param noBands the number of bands, spaced evenly in
+		 * pitch between minFreq and maxFreq.
+		 * @param minFreq the centre of the lowest band in Hz.
+		 * @param maxFreq the centre of the highest band in Hz.
+		 * @param attackTime the time the envelopes take to rise, in
+		 * seconds.
+		 * @param releaseTime the time the envelopes take to fall, in
+		 * seconds.
+		 */
+		FilterBank(int noBands = 16, double minFreq = 60, double maxFreq = 12000,
+		           double attackTime = 0.005, double releaseTime = 0.15);
+		virtual ~FilterBank();
+		void processPCMBlock(PCMBlock* block);
+		void* getDSPData();
+		void relenquishDSPData();
+
+	private:
+		/**
+		 * Work out the filter and envelope coefficents for a sample
+		 * rate.
+		 */
+		void setSampleRate(int sampleRate);
+
+		pthread_mutex_t* PCMDataMutex;
+		int noBands;
+		int sampleRate;
+		double minFreq;
+		double maxFreq;
+		double attackTime;
+		double releaseTime;
+
+		// The number of bands rounded up to a multiple of four.
+		int stride;
+
+		// The coefficents of each filter, normalised so a0 is 1. b1
+		// is always 0 for a band-pass filter.
+		float* b0;
+		float* b2;
+		float* a1;
+		float* a2;
+
+		// The state of each filter and envelope, only used by the
+		// DSP thread.
+		float* z1;
+		float* z2;
+		float* level;
+
+		// How far each envelope moves towards the filter output every
+		// frame when it is rising and falling.
+		float attack;
+		float release;
+
+		std::vector<float> frequencies;
+		std::vector<float> envelope;
+		std::vector<float> mixed;
+		uint64_t time;
+		bool hasData;
+		FilterBankData* FilterBankDataStruct;
+};
+
+#endif
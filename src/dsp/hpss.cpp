@@ -0,0 +1,145 @@
+/****************************************
+ *
+ * hpss.cpp
+ * Define a harmonic/percussive separation plugin class.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "hpss.h"
+
+HPSS::HPSS(FFT* fftPlugin, int timeLength, int frequencyLength)
+: frequencyMedian(frequencyLength | 1)
+{
+	PCMDataMutex = new pthread_mutex_t;
+	pthread_mutex_init(PCMDataMutex, NULL);
+
+	this->fftPlugin = fftPlugin;
+	this->timeLength = timeLength;
+	this->frequencyLength = frequencyLength | 1;
+	lastTime = 0;
+	harmonicTotal = 0;
+	percussiveTotal = 0;
+	time = 0;
+	hasData = false;
+	HPSSDataStruct = new HPSSData;
+}
+
+HPSS::~HPSS()
+{
+	delete HPSSDataStruct;
+	pthread_mutex_destroy(PCMDataMutex);
+	delete PCMDataMutex;
+}
+
+void HPSS::processPCMBlock(PCMBlock* block)
+{
+	// Skip this block rather than wait if the spectrum is in use.
+	FFTData* data = (FFTData*)fftPlugin->tryGetDSPData();
+	if(data == NULL)
+		return;
+	if(hasData && data->time == lastTime)
+	{
+		fftPlugin->relenquishDSPData();
+		return;
+	}
+
+	// Undo the FFT's scaling so that a sine wave of amplitude A has
+	// a magnitude of A.
+	int bins = data->dataLength;
+	if((int)magnitude.size() != bins)
+		magnitude.resize(bins);
+	float scale = data->amplitudeScale;
+	for(int j = 0; j < bins; j++)
+		magnitude[j] = data->magnitude[j] * scale;
+	uint64_t spectrumTime = data->time;
+	fftPlugin->relenquishDSPData();
+
+	// Attempt to process the data, if not - skip this set of samples.
+	if(pthread_mutex_trylock(PCMDataMutex) != 0)
+		return;
+
+	if((int)timeMedians.size() != bins)
+	{
+		timeMedians.assign(bins, slidingMedian(timeLength));
+		harmonic.resize(bins);
+		percussive.resize(bins);
+	}
+
+	// Slide the frequency median up the bins, reflecting the spectrum
+	// at each end so every bin has a full window.
+	int half = frequencyLength / 2;
+	frequencyMedian.clear();
+	for(int j = -half; j < half; j++)
+		frequencyMedian.insert(magnitude[abs(j) < bins ? abs(j) : bins - 1]);
+
+	harmonicTotal = 0;
+	percussiveTotal = 0;
+	for(int j = 0; j < bins; j++)
+	{
+		int ahead = j + half;
+		if(ahead >= bins)
+			ahead = (2 * (bins - 1)) - ahead;
+		if(ahead < 0)
+			ahead = 0;
+		float across = frequencyMedian.insert(magnitude[ahead]);
+		float along = timeMedians[j].insert(magnitude[j]);
+
+		// Share the bin out with soft masks.
+		float h = along * along;
+		float p = across * across;
+		float mask = h + p > 0 ? h / (h + p) : 0.5f;
+		harmonic[j] = magnitude[j] * mask;
+		percussive[j] = magnitude[j] - harmonic[j];
+		harmonicTotal += harmonic[j];
+		percussiveTotal += percussive[j];
+	}
+
+	lastTime = spectrumTime;
+	time = spectrumTime;
+	hasData = true;
+	pthread_mutex_unlock(PCMDataMutex);
+}
+
+void* HPSS::getDSPData()
+{
+	// Ensure we have some data
+	if(!hasData)
+		return NULL;
+
+	// grab the mutex
+	pthread_mutex_lock(PCMDataMutex);
+
+	// set the structure variables
+	HPSSDataStruct->harmonic = &harmonic[0];
+	HPSSDataStruct->percussive = &percussive[0];
+	HPSSDataStruct->dataLength = harmonic.size();
+	HPSSDataStruct->harmonicTotal = harmonicTotal;
+	HPSSDataStruct->percussiveTotal = percussiveTotal;
+	HPSSDataStruct->time = time;
+
+	return (void*)HPSSDataStruct;
+}
+
+void HPSS::relenquishDSPData()
+{
+	pthread_mutex_unlock(PCMDataMutex);
+}
@@ -0,0 +1,112 @@
+/****************************************
+ *
+ * hpss.h
+ * Declare a harmonic/percussive separation plugin class.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _HPSS_H_
+#define _HPSS_H_
+
+#include <pthread.h>
+#include <vector>
+#include "dsp.h"
+#include "fft.h"
+#include "../util/slidingMedian.h"
+
+typedef struct
+{
+	// The harmonic and percussive parts of the magnitude of each bin.
+	// A sine wave of amplitude A gives about A between them.
+	float* harmonic;
+	float* percussive;
+	int dataLength;
+
+	// The sum of each part over all of the bins.
+	float harmonicTotal;
+	float percussiveTotal;
+
+	// The time of the spectrum that was separated.
+	uint64_t time;
+}HPSSData;
+
+/**
+ * Split the spectrum from a FFT plugin into its harmonic and
+ * percussive parts, see Fitzgerald, "Harmonic/Percussive Separation
+ * using Median Filtering".
+ *
+ * Steady notes are lines along time in a spectrogram and drum hits
+ * are lines up the frequencies. Taking the median of each bin over the
+ * last few spectra keeps the first and removes the second, taking the
+ * median over the neighbouring bins does the opposite. Each bin is
+ * then shared between the parts in proportion to the square of the two
+ * medians.
+ *
+ * The medians are kept with a slidingMedian for each bin over time and
+ * one that is slid up the bins of each spectrum, so each spectrum costs
+ * O(bins * log length) however long the filters are.
+ *
+ * @note this reads the FFT plugin's results for each block, so it must
+ * be registered with the DSPManager after the FFT plugin.
+ */
+class HPSS : public DSP
+{
+	public:
+		/**
+		 * Construct the separation plugin.
+		 * @param fftPlugin the FFT plugin whose spectrum is used. This
+		 * isn't deleted by the separation plugin.
+		 * @param timeLength the number of spectra the harmonic
+		 * median is taken over.
+		 * @param frequencyLength the number of bins the percussive
+		 * median is taken over, rounded up to an odd number.
+		 */
+		HPSS(FFT* fftPlugin, int timeLength = 17, int frequencyLength = 17);
+		virtual ~HPSS();
+		void processPCMBlock(PCMBlock* block);
+		void* getDSPData();
+		void relenquishDSPData();
+
+	private:
+		pthread_mutex_t* PCMDataMutex;
+		FFT* fftPlugin;
+		int timeLength;
+		int frequencyLength;
+
+		// The magnitude of each bin of the latest spectrum, only used
+		// by the DSP thread.
+		std::vector<float> magnitude;
+
+		// The time of the last spectrum used, so that one isn't
+		// counted twice if the FFT plugin skipped a block.
+		uint64_t lastTime;
+
+		std::vector<slidingMedian> timeMedians;
+		slidingMedian frequencyMedian;
+
+		std::vector<float> harmonic;
+		std::vector<float> percussive;
+		float harmonicTotal;
+		float percussiveTotal;
+		uint64_t time;
+		bool hasData;
+		HPSSData* HPSSDataStruct;
+};
+
+#endif
@@ -0,0 +1,255 @@
+/****************************************
+ *
+ * mel.cpp
+ * Define a mel filterbank plugin class.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "mel.h"
+#include "fftPlanCache.h"
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+// Band powers are floored at this before the log is taken.
+#define MEL_MIN_POWER 1e-10
+
+/**
+ * Convert between Hz and mels.
+ */
+static double hzToMel(double hz)
+{
+	return 2595 * log10(1 + (hz / 700));
+}
+
+static double melToHz(double mel)
+{
+	return 700 * (pow(10, mel / 2595) - 1);
+}
+
+/**
+ * Find the dot product of two arrays of floats.
+ */
+static float dotProduct(const float* a, const float* b, int length)
+{
+	int i = 0;
+	float total = 0;
+
+#ifdef __SSE__
+	__m128 sum = _mm_setzero_ps();
+	for(; i + 4 <= length; i += 4)
+		sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+
+	float lanes[4];
+	_mm_storeu_ps(lanes, sum);
+	total = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+
+	for(; i < length; i++)
+		total += a[i] * b[i];
+	return total;
+}
+
+Mel::Mel(FFT* fftPlugin, int noBands, int noCoefficents,
+         double minFreq, double maxFreq)
+{
+	PCMDataMutex = new pthread_mutex_t;
+	pthread_mutex_init(PCMDataMutex, NULL);
+
+	this->fftPlugin = fftPlugin;
+	this->noBands = noBands;
+	this->noCoefficents = noCoefficents < noBands ? noCoefficents : noBands;
+	this->minFreq = minFreq;
+	this->maxFreq = maxFreq;
+	noBins = 0;
+	sampleRate = 0;
+	bands.assign(noBands, 0);
+	frequencies.assign(noBands, 0);
+	coefficents.assign(this->noCoefficents, 0);
+
+	logBands = NULL;
+	cepstrum = NULL;
+	if(this->noCoefficents > 0)
+	{
+		logBands = (double*)fftw_malloc(sizeof(double) * noBands);
+		cepstrum = (double*)fftw_malloc(sizeof(double) * noBands);
+	}
+
+	lastTime = 0;
+	hasData = false;
+	MelDataStruct = new MelData;
+}
+
+Mel::~Mel()
+{
+	if(logBands)
+		fftw_free(logBands);
+	if(cepstrum)
+		fftw_free(cepstrum);
+	delete MelDataStruct;
+	pthread_mutex_destroy(PCMDataMutex);
+	delete PCMDataMutex;
+}
+
+void Mel::makeFilters(int noBins, int sampleRate)
+{
+	this->noBins = noBins;
+	this->sampleRate = sampleRate;
+	rowStart.clear();
+	firstBin.clear();
+	weights.clear();
+
+	// The spectrum has a bin for each binWidth Hz up to half the
+	// sample rate.
+	double nyquist = sampleRate / 2.0;
+	double binWidth = nyquist / noBins;
+	double top = maxFreq > 0 && maxFreq < nyquist ? maxFreq : nyquist;
+
+	// The edges of the bands are evenly spaced in mels, each band
+	// runs from the centre of the one below to the centre of the
+	// one above.
+	double lowMel = hzToMel(minFreq);
+	double highMel = hzToMel(top);
+	std::vector<double> edges(noBands + 2);
+	for(int b = 0; b < noBands + 2; b++)
+		edges[b] = melToHz(lowMel + (((highMel - lowMel) * b) / (noBands + 1)));
+
+	rowStart.push_back(0);
+	for(int b = 0; b < noBands; b++)
+	{
+		double left = edges[b];
+		double centre = edges[b + 1];
+		double right = edges[b + 2];
+		frequencies[b] = (float)centre;
+
+		int first = (int)ceil(left / binWidth);
+		int last = (int)floor(right / binWidth);
+		if(last >= noBins)
+			last = noBins - 1;
+
+		// Narrow bands at the bottom can fall between two bins, give
+		// them the nearest one.
+		if(last < first)
+		{
+			first = (int)floor((centre / binWidth) + 0.5);
+			if(first >= noBins)
+				first = noBins - 1;
+			firstBin.push_back(first);
+			weights.push_back(1);
+			rowStart.push_back(weights.size());
+			continue;
+		}
+
+		firstBin.push_back(first);
+		for(int j = first; j <= last; j++)
+		{
+			double freq = j * binWidth;
+			double weight;
+			if(freq <= centre)
+				weight = centre > left ? (freq - left) / (centre - left) : 1;
+			else
+				weight = right > centre ? (right - freq) / (right - centre) : 1;
+			weights.push_back(weight > 0 ? (float)weight : 0);
+		}
+		rowStart.push_back(weights.size());
+	}
+}
+
+void Mel::processPCMBlock(PCMBlock* block)
+{
+	// Skip this block rather than wait if the spectrum is in use.
+	FFTData* data = (FFTData*)fftPlugin->tryGetDSPData();
+	if(data == NULL)
+		return;
+	if(hasData && data->time == lastTime)
+	{
+		fftPlugin->relenquishDSPData();
+		return;
+	}
+
+	// Undo the FFT's scaling so that a sine wave of amplitude A has
+	// a power of A squared.
+	int bins = data->dataLength;
+	if((int)power.size() != bins)
+		power.resize(bins);
+	float scale = data->amplitudeScale;
+	for(int j = 0; j < bins; j++)
+	{
+		float amplitude = data->magnitude[j] * scale;
+		power[j] = amplitude * amplitude;
+	}
+	uint64_t spectrumTime = data->time;
+	fftPlugin->relenquishDSPData();
+
+	// Attempt to process the data, if not - skip this set of samples.
+	if(pthread_mutex_trylock(PCMDataMutex) != 0)
+		return;
+
+	int rate = block->sampleRate ? block->sampleRate : PCM_DEFAULT_SAMPLE_RATE;
+	if(bins != noBins || rate != sampleRate)
+		makeFilters(bins, rate);
+
+	for(int b = 0; b < noBands; b++)
+		bands[b] = dotProduct(&weights[rowStart[b]], &power[firstBin[b]],
+		                      rowStart[b + 1] - rowStart[b]);
+
+	if(noCoefficents > 0)
+	{
+		for(int b = 0; b < noBands; b++)
+			logBands[b] = log(bands[b] > MEL_MIN_POWER ? bands[b] : MEL_MIN_POWER);
+		fftw_execute_r2r(fftPlanCache::getR2R(noBands, FFTW_REDFT10),
+		                 logBands, cepstrum);
+
+		// Scale FFTW's DCT-II to be orthonormal.
+		coefficents[0] = (float)(cepstrum[0] * sqrt(1.0 / (4 * noBands)));
+		for(int c = 1; c < noCoefficents; c++)
+			coefficents[c] = (float)(cepstrum[c] * sqrt(1.0 / (2 * noBands)));
+	}
+
+	lastTime = spectrumTime;
+	hasData = true;
+	pthread_mutex_unlock(PCMDataMutex);
+}
+
+void* Mel::getDSPData()
+{
+	// Ensure we have some data
+	if(!hasData)
+		return NULL;
+
+	// grab the mutex
+	pthread_mutex_lock(PCMDataMutex);
+
+	// set the structure variables
+	MelDataStruct->bands = &bands[0];
+	MelDataStruct->noBands = noBands;
+	MelDataStruct->frequencies = &frequencies[0];
+	MelDataStruct->coefficents = noCoefficents > 0 ? &coefficents[0] : NULL;
+	MelDataStruct->noCoefficents = noCoefficents;
+
+	return (void*)MelDataStruct;
+}
+
+void Mel::relenquishDSPData()
+{
+	pthread_mutex_unlock(PCMDataMutex);
+}
@@ -0,0 +1,127 @@
+/****************************************
+ *
+ * mel.h
+ * Declare a mel filterbank plugin class.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MEL_H_
+#define _MEL_H_
+
+#include <fftw3.h>
+#include <pthread.h>
+#include <vector>
+#include "dsp.h"
+#include "fft.h"
+
+typedef struct
+{
+	// The power in each mel band. A sine wave of amplitude A at the
+	// centre of a band gives about A squared.
+	float* bands;
+	int noBands;
+
+	// The centre frequency of each band in Hz.
+	float* frequencies;
+
+	// The mel frequency cepstral coefficents, the DCT of the log of
+	// the band powers. NULL if they aren't being worked out.
+	float* coefficents;
+	int noCoefficents;
+}MelData;
+
+/**
+ * Group the spectrum from a FFT plugin into bands that are evenly
+ * spaced on the mel scale, which is roughly how far apart pitches
+ * sound, and optionally work out the MFCCs from them.
+ *
+ * The triangular filters are worked out when the size of the spectrum
+ * or the sample rate changes. As each filter only covers a run of
+ * neighbouring bins they are kept as compressed sparse rows where each
+ * row is a weight for each bin in its run, so applying a filter is a
+ * short dot product.
+ *
+ * @note this reads the FFT plugin's results for each block, so it must
+ * be registered with the DSPManager after the FFT plugin.
+ */
+class Mel : public DSP
+{
+	public:
+		/**
+		 * Construct the mel plugin.
+		 * @param fftPlugin the FFT plugin whose spectrum is used. This
+		 * isn't deleted by the mel plugin.
+		 * @param noBands the number of mel bands.
+		 * @param noCoefficents the number of MFCCs to work out, 0 to
+		 * not work them out.
+		 * @param minFreq the lowest frequency covered in Hz.
+		 * @param maxFreq the highest frequency covered in Hz, 0 for
+		 * half the sample rate.
+		 */
+		Mel(FFT* fftPlugin, int noBands = 40, int noCoefficents = 0,
+		    double minFreq = 0, double maxFreq = 0);
+		virtual ~Mel();
+		void processPCMBlock(PCMBlock* block);
+		void* getDSPData();
+		void relenquishDSPData();
+
+	private:
+		/**
+		 * Make the filters for a spectrum of noBins bins.
+		 */
+		void makeFilters(int noBins, int sampleRate);
+
+		pthread_mutex_t* PCMDataMutex;
+		FFT* fftPlugin;
+		int noBands;
+		int noCoefficents;
+		double minFreq;
+		double maxFreq;
+
+		// The spectrum the filters were made for.
+		int noBins;
+		int sampleRate;
+
+		// The filters, row b is the weights from rowStart[b] up to
+		// rowStart[b + 1] for the bins starting at firstBin[b].
+		std::vector<int> rowStart;
+		std::vector<int> firstBin;
+		std::vector<float> weights;
+
+		// The power of each bin of the latest spectrum, only used
+		// by the DSP thread.
+		std::vector<float> power;
+
+		// The time of the last spectrum used, so that the same one
+		// isn't worked through again if the FFT plugin skipped a block.
+		uint64_t lastTime;
+
+		std::vector<float> bands;
+		std::vector<float> frequencies;
+		std::vector<float> coefficents;
+
+		// The input and output of the DCT.
+		double* logBands;
+		double* cepstrum;
+
+		bool hasData;
+		MelData* MelDataStruct;
+};
+
+#endif
@@ -0,0 +1,468 @@
+/****************************************
+ *
+ * meter.cpp
+ * Define a level metering plugin class.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "meter.h"
+#include "../pcmFormat.h"
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+/**
+ * Convert a mean weighted power to a loudness in LUFS.
+ */
+static float loudness(double power)
+{
+	if(power <= 0)
+		return METER_MIN_LOUDNESS;
+	float l = (float)(-0.691 + (10 * log10(power)));
+	return l < METER_MIN_LOUDNESS ? METER_MIN_LOUDNESS : l;
+}
+
+/**
+ * Find the highest absolute sample of a plane and add up its squares.
+ */
+static void measurePlane(const float* plane, int noFrames, float& peak, double& squares)
+{
+	int i = 0;
+	float highest = 0;
+	float total = 0;
+#ifdef __SSE__
+	__m128 signMask = _mm_set1_ps(-0.0f);
+	__m128 vHighest = _mm_setzero_ps();
+	__m128 vTotal = _mm_setzero_ps();
+	for(; i + 4 <= noFrames; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(plane + i);
+		vHighest = _mm_max_ps(vHighest, _mm_andnot_ps(signMask, x));
+		vTotal = _mm_add_ps(vTotal, _mm_mul_ps(x, x));
+	}
+	float lanes[4];
+	_mm_storeu_ps(lanes, vHighest);
+	for(int l = 0; l < 4; l++)
+		highest = lanes[l] > highest ? lanes[l] : highest;
+	_mm_storeu_ps(lanes, vTotal);
+	total = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+	for(; i < noFrames; i++)
+	{
+		float x = fabsf(plane[i]);
+		highest = x > highest ? x : highest;
+		total += x * x;
+	}
+	peak = highest > peak ? highest : peak;
+	squares += total;
+}
+
+Meter::Meter()
+{
+	PCMDataMutex = new pthread_mutex_t;
+	pthread_mutex_init(PCMDataMutex, NULL);
+
+	sampleRate = 0;
+	channels = 0;
+
+	// Windowed sinc interpolation filter for the true peak. ITU-R
+	// BS.1770 gives a 48 tap filter that this is close to.
+	int noTaps = METER_OVERSAMPLE * METER_TAPS_PER_PHASE;
+	double centre = (noTaps - 1) / 2.0;
+	for(int p = 0; p < METER_OVERSAMPLE; p++)
+	{
+		double total = 0;
+		for(int k = 0; k < METER_TAPS_PER_PHASE; k++)
+		{
+			int j = (k * METER_OVERSAMPLE) + p;
+			double t = (j - centre) / METER_OVERSAMPLE;
+			double sinc = t == 0 ? 1 : sin(M_PI * t) / (M_PI * t);
+			double window = 0.42 - (0.5 * cos((2 * M_PI * j) / (noTaps - 1))) +
+			                (0.08 * cos((4 * M_PI * j) / (noTaps - 1)));
+			oversample[p][METER_TAPS_PER_PHASE - 1 - k] = (float)(sinc * window);
+			total += sinc * window;
+		}
+
+		// Each phase passes a steady signal unchanged.
+		for(int k = 0; k < METER_TAPS_PER_PHASE; k++)
+			oversample[p][k] = (float)(oversample[p][k] / total);
+	}
+
+	int noBins = (int)((METER_MAX_LOUDNESS - METER_MIN_LOUDNESS) / METER_HISTOGRAM_STEP);
+	histogramCount.assign(noBins, 0);
+	histogramPower.assign(noBins, 0);
+	subBlocks.assign(METER_SHORT_TERM_SUB_BLOCKS, 0);
+
+	hasData = false;
+	MeterDataStruct = new MeterData;
+}
+
+Meter::~Meter()
+{
+	delete MeterDataStruct;
+	pthread_mutex_destroy(PCMDataMutex);
+	delete PCMDataMutex;
+}
+
+void Meter::setFormat(int sampleRate, int channels)
+{
+	this->sampleRate = sampleRate;
+	this->channels = channels;
+
+	// The K-weighting filters from ITU-R BS.1770, worked out for any
+	// sample rate as libebur128 does. The first is a high shelf that
+	// boosts the treble by 4dB.
+	double K = tan((M_PI * 1681.974450955533) / sampleRate);
+	double Q = 0.7071752369554196;
+	double Vh = pow(10.0, 3.999843853973347 / 20);
+	double Vb = pow(Vh, 0.4996667741545416);
+	double a0 = 1 + (K / Q) + (K * K);
+	shelf[0] = (float)((Vh + ((Vb * K) / Q) + (K * K)) / a0);
+	shelf[1] = (float)((2 * ((K * K) - Vh)) / a0);
+	shelf[2] = (float)((Vh - ((Vb * K) / Q) + (K * K)) / a0);
+	shelf[3] = (float)((2 * ((K * K) - 1)) / a0);
+	shelf[4] = (float)((1 - (K / Q) + (K * K)) / a0);
+
+	// The second is a high pass filter that cuts out the rumble.
+	K = tan((M_PI * 38.13547087602444) / sampleRate);
+	Q = 0.5003270373238773;
+	a0 = 1 + (K / Q) + (K * K);
+	highPass[0] = 1;
+	highPass[1] = -2;
+	highPass[2] = 1;
+	highPass[3] = (float)((2 * ((K * K) - 1)) / a0);
+	highPass[4] = (float)((1 - (K / Q) + (K * K)) / a0);
+
+	// The surround channels of 5.1 audio count for more and the LFE
+	// channel isn't counted at all.
+	for(int c = 0; c < PCM_MAX_CHANNELS; c++)
+	{
+		weights[c] = c < channels ? 1.0f : 0.0f;
+		if(channels == 6 && c == 3)
+			weights[c] = 0;
+		else if(channels == 6 && c > 3)
+			weights[c] = 1.41f;
+	}
+
+	// Start again from silence.
+	for(int c = 0; c < PCM_MAX_CHANNELS; c++)
+	{
+		shelfZ1[c] = 0;
+		shelfZ2[c] = 0;
+		highPassZ1[c] = 0;
+		highPassZ2[c] = 0;
+		subBlockPower[c] = 0;
+		extended[c].assign(METER_TAPS_PER_PHASE - 1, 0);
+	}
+	subBlockLength = (sampleRate * METER_SUB_BLOCK_MS) / 1000;
+	subBlockFrames = 0;
+	subBlocks.assign(METER_SHORT_TERM_SUB_BLOCKS, 0);
+	subBlockHead = 0;
+	subBlockCount = 0;
+	histogramCount.assign(histogramCount.size(), 0);
+	histogramPower.assign(histogramPower.size(), 0);
+	momentary = METER_MIN_LOUDNESS;
+	shortTerm = METER_MIN_LOUDNESS;
+	level = 0;
+}
+
+void Meter::processPCMBlock(PCMBlock* block)
+{
+	int noFrames = block->dataLength / block->channels;
+	int rate = block->sampleRate ? block->sampleRate : PCM_DEFAULT_SAMPLE_RATE;
+	int noPlanes = block->channels < PCM_MAX_CHANNELS ? block->channels :
+	                                                    PCM_MAX_CHANNELS;
+
+	if(rate != sampleRate || noPlanes != channels)
+		setFormat(rate, noPlanes);
+
+	// Split the channels if the DSPManager hasn't.
+	float* planes[PCM_MAX_CHANNELS];
+	if(block->planes[0] != NULL)
+	{
+		for(int c = 0; c < PCM_MAX_CHANNELS; c++)
+			planes[c] = block->planes[c];
+	}
+	else
+	{
+		if((int)planeBuf.size() < noFrames * noPlanes)
+			planeBuf.resize(noFrames * noPlanes);
+		for(int c = 0; c < PCM_MAX_CHANNELS; c++)
+			planes[c] = c < noPlanes ? &planeBuf[c * noFrames] : NULL;
+		pcmDeinterleave(block->data, noFrames, block->channels, planes);
+	}
+
+	// The level of this block.
+	float peak = 0;
+	double squares = 0;
+	for(int c = 0; c < noPlanes; c++)
+		measurePlane(planes[c], noFrames, peak, squares);
+	float truePeak = findTruePeak(planes, noFrames);
+	if(truePeak < peak)
+		truePeak = peak;
+
+	// The loudness, a sub block at a time. The filters must see
+	// every frame so this is done whether or not the results can be
+	// passed on, the state is only used by this thread.
+	int start = 0;
+	while(start < noFrames)
+	{
+		int end = start + (subBlockLength - subBlockFrames);
+		if(end > noFrames)
+			end = noFrames;
+		kWeight(planes, start, end);
+		subBlockFrames += end - start;
+		if(subBlockFrames == subBlockLength)
+			endSubBlock();
+		start = end;
+	}
+
+	// Pass on the results if nobody is reading the last ones,
+	// otherwise they will be picked up after the next block.
+	if(pthread_mutex_trylock(PCMDataMutex) != 0)
+		return;
+
+	results.rms = noFrames > 0 ? (float)sqrt(squares / (noFrames * noPlanes)) : 0;
+	results.peak = peak;
+	results.truePeak = truePeak;
+	results.momentary = momentary;
+	results.shortTerm = shortTerm;
+	results.integrated = integratedLoudness();
+	results.level = level;
+	results.time = block->presentationTime + (((uint64_t)noFrames * 1000000) / rate);
+	hasData = true;
+
+	pthread_mutex_unlock(PCMDataMutex);
+}
+
+void Meter::kWeight(float* const* planes, int start, int end)
+{
+	for(int g = 0; g < channels; g += 4)
+	{
+		// Lanes past the last channel filter a copy of the first
+		// one in the group, which is ignored.
+		const float* lane[4];
+		for(int l = 0; l < 4; l++)
+			lane[l] = g + l < channels ? planes[g + l] : planes[g];
+
+#ifdef __SSE__
+		__m128 sb0 = _mm_set1_ps(shelf[0]);
+		__m128 sb1 = _mm_set1_ps(shelf[1]);
+		__m128 sb2 = _mm_set1_ps(shelf[2]);
+		__m128 sa1 = _mm_set1_ps(shelf[3]);
+		__m128 sa2 = _mm_set1_ps(shelf[4]);
+		__m128 ha1 = _mm_set1_ps(highPass[3]);
+		__m128 ha2 = _mm_set1_ps(highPass[4]);
+		__m128 two = _mm_set1_ps(2.0f);
+		__m128 sz1 = _mm_loadu_ps(shelfZ1 + g);
+		__m128 sz2 = _mm_loadu_ps(shelfZ2 + g);
+		__m128 hz1 = _mm_loadu_ps(highPassZ1 + g);
+		__m128 hz2 = _mm_loadu_ps(highPassZ2 + g);
+		__m128 total = _mm_setzero_ps();
+		for(int i = start; i < end; i++)
+		{
+			__m128 x = _mm_set_ps(lane[3][i], lane[2][i], lane[1][i], lane[0][i]);
+
+			// Both filters are in transposed direct form II, the high
+			// pass's numerator is 1, -2, 1.
+			__m128 y = _mm_add_ps(_mm_mul_ps(sb0, x), sz1);
+			sz1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(sb1, x), _mm_mul_ps(sa1, y)), sz2);
+			sz2 = _mm_sub_ps(_mm_mul_ps(sb2, x), _mm_mul_ps(sa2, y));
+
+			__m128 z = _mm_add_ps(y, hz1);
+			hz1 = _mm_sub_ps(_mm_sub_ps(hz2, _mm_mul_ps(two, y)), _mm_mul_ps(ha1, z));
+			hz2 = _mm_sub_ps(y, _mm_mul_ps(ha2, z));
+
+			total = _mm_add_ps(total, _mm_mul_ps(z, z));
+		}
+		_mm_storeu_ps(shelfZ1 + g, sz1);
+		_mm_storeu_ps(shelfZ2 + g, sz2);
+		_mm_storeu_ps(highPassZ1 + g, hz1);
+		_mm_storeu_ps(highPassZ2 + g, hz2);
+		float lanes[4];
+		_mm_storeu_ps(lanes, total);
+		for(int l = 0; l < 4 && g + l < channels; l++)
+			subBlockPower[g + l] += lanes[l];
+#else
+		for(int l = 0; l < 4 && g + l < channels; l++)
+		{
+			int c = g + l;
+			float total = 0;
+			for(int i = start; i < end; i++)
+			{
+				float x = lane[l][i];
+				float y = (shelf[0] * x) + shelfZ1[c];
+				shelfZ1[c] = (shelf[1] * x) - (shelf[3] * y) + shelfZ2[c];
+				shelfZ2[c] = (shelf[2] * x) - (shelf[4] * y);
+
+				float z = y + highPassZ1[c];
+				highPassZ1[c] = highPassZ2[c] - (2 * y) - (highPass[3] * z);
+				highPassZ2[c] = y - (highPass[4] * z);
+
+				total += z * z;
+			}
+			subBlockPower[c] += total;
+		}
+#endif
+	}
+}
+
+float Meter::findTruePeak(float* const* planes, int noFrames)
+{
+	float highest = 0;
+	for(int c = 0; c < channels; c++)
+	{
+		// Put the block after the end of the last one so the filter
+		// can reach back into it.
+		std::vector<float>& ext = extended[c];
+		ext.resize((METER_TAPS_PER_PHASE - 1) + noFrames);
+		memcpy(&ext[METER_TAPS_PER_PHASE - 1], planes[c], sizeof(float) * noFrames);
+
+		for(int i = 0; i < noFrames; i++)
+		{
+			const float* x = &ext[i];
+			for(int p = 0; p < METER_OVERSAMPLE; p++)
+			{
+				const float* h = oversample[p];
+#ifdef __SSE__
+				__m128 total = _mm_mul_ps(_mm_loadu_ps(h), _mm_loadu_ps(x));
+				for(int k = 4; k < METER_TAPS_PER_PHASE; k += 4)
+					total = _mm_add_ps(total, _mm_mul_ps(_mm_loadu_ps(h + k),
+					                                     _mm_loadu_ps(x + k)));
+				float lanes[4];
+				_mm_storeu_ps(lanes, total);
+				float y = fabsf((lanes[0] + lanes[1]) + (lanes[2] + lanes[3]));
+#else
+				float y = 0;
+				for(int k = 0; k < METER_TAPS_PER_PHASE; k++)
+					y += h[k] * x[k];
+				y = fabsf(y);
+#endif
+				highest = y > highest ? y : highest;
+			}
+		}
+
+		// Keep the end of the block for next time.
+		memmove(&ext[0], &ext[noFrames], sizeof(float) * (METER_TAPS_PER_PHASE - 1));
+	}
+	return highest;
+}
+
+void Meter::endSubBlock()
+{
+	double power = 0;
+	for(int c = 0; c < channels; c++)
+	{
+		power += weights[c] * subBlockPower[c];
+		subBlockPower[c] = 0;
+	}
+	power /= subBlockLength;
+	subBlockFrames = 0;
+
+	subBlockHead = (subBlockHead + 1) % METER_SHORT_TERM_SUB_BLOCKS;
+	subBlocks[subBlockHead] = power;
+	if(subBlockCount < METER_SHORT_TERM_SUB_BLOCKS)
+		subBlockCount++;
+	if(subBlockCount < METER_MOMENTARY_SUB_BLOCKS)
+		return;
+
+	// Average the newest sub blocks for each window.
+	double momentaryPower = 0;
+	double shortTermPower = 0;
+	for(int i = 0; i < subBlockCount; i++)
+	{
+		double p = subBlocks[(subBlockHead - i + METER_SHORT_TERM_SUB_BLOCKS) %
+		                     METER_SHORT_TERM_SUB_BLOCKS];
+		if(i < METER_MOMENTARY_SUB_BLOCKS)
+			momentaryPower += p;
+		shortTermPower += p;
+	}
+	momentaryPower /= METER_MOMENTARY_SUB_BLOCKS;
+	shortTermPower /= subBlockCount;
+	momentary = loudness(momentaryPower);
+	shortTerm = loudness(shortTermPower);
+
+	float totalWeight = 0;
+	for(int c = 0; c < channels; c++)
+		totalWeight += weights[c];
+	level = totalWeight > 0 ? (float)sqrt(shortTermPower / totalWeight) : 0;
+
+	// Count the 400ms block in the histogram, if it is above the
+	// absolute gate.
+	if(momentary > METER_MIN_LOUDNESS)
+	{
+		int bin = (int)((momentary - METER_MIN_LOUDNESS) / METER_HISTOGRAM_STEP);
+		if(bin >= (int)histogramCount.size())
+			bin = histogramCount.size() - 1;
+		histogramCount[bin]++;
+		histogramPower[bin] += momentaryPower;
+	}
+}
+
+float Meter::integratedLoudness()
+{
+	// The relative gate is 10LU below the mean of the blocks above
+	// the absolute gate.
+	int noBins = histogramCount.size();
+	double power = 0;
+	int count = 0;
+	for(int i = 0; i < noBins; i++)
+	{
+		power += histogramPower[i];
+		count += histogramCount[i];
+	}
+	if(count == 0)
+		return METER_MIN_LOUDNESS;
+
+	float gate = loudness(power / count) - 10;
+	int first = (int)((gate - METER_MIN_LOUDNESS) / METER_HISTOGRAM_STEP);
+	if(first < 0)
+		first = 0;
+	power = 0;
+	count = 0;
+	for(int i = first; i < noBins; i++)
+	{
+		power += histogramPower[i];
+		count += histogramCount[i];
+	}
+	return count > 0 ? loudness(power / count) : METER_MIN_LOUDNESS;
+}
+
+void* Meter::getDSPData()
+{
+	// Ensure we have some data
+	if(!hasData)
+		return NULL;
+
+	// grab the mutex
+	pthread_mutex_lock(PCMDataMutex);
+
+	// set the structure variables
+	*MeterDataStruct = results;
+
+	return (void*)MeterDataStruct;
+}
+
+void Meter::relenquishDSPData()
+{
+	pthread_mutex_unlock(PCMDataMutex);
+}
@@ -0,0 +1,186 @@
+/****************************************
+ *
+ * meter.h
+ * Declare a level metering plugin class.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _METER_H_
+#define _METER_H_
+
+#include <pthread.h>
+#include <vector>
+#include "dsp.h"
+
+// The loudness reported when there isn't enough audio, and below which
+// blocks are left out of the integrated loudness, in LUFS.
+#define METER_MIN_LOUDNESS -70.0f
+
+// The highest loudness kept track of for the integrated loudness.
+#define METER_MAX_LOUDNESS 5.0f
+
+// The width of each step of the loudness histogram in LU.
+#define METER_HISTOGRAM_STEP 0.1f
+
+// The length of the sub blocks the loudness windows are made of, the
+// momentary window is 4 and the short term one 30 of them.
+#define METER_SUB_BLOCK_MS 100
+#define METER_MOMENTARY_SUB_BLOCKS 4
+#define METER_SHORT_TERM_SUB_BLOCKS 30
+
+// The size of the oversampling filter used to find the true peak.
+#define METER_OVERSAMPLE 4
+#define METER_TAPS_PER_PHASE 12
+
+typedef struct
+{
+	// The root mean square and highest absolute sample of the latest
+	// block over all of the channels, where 1 is full scale.
+	float rms;
+	float peak;
+
+	// The highest absolute value of the latest block when it is
+	// oversampled, which catches peaks that fall between samples.
+	float truePeak;
+
+	// The loudness over the last 400ms, 3s and since the start of the
+	// track in LUFS, as in EBU R128.
+	float momentary;
+	float shortTerm;
+	float integrated;
+
+	// The short term loudness as an amplitude, about the RMS of each
+	// channel over the last 3s. Visualisers can divide by this to
+	// show quiet and loud tracks at the same size.
+	float level;
+
+	// The time that the last sample metered is heard.
+	uint64_t time;
+}MeterData;
+
+/**
+ * Measure how loud the audio is.
+ *
+ * Along with the RMS and peak of each block, the loudness is measured
+ * as in ITU-R BS.1770 and EBU R128. Each channel is passed through the
+ * K-weighting filters, which roughly follow how loud each frequency
+ * sounds, and the mean power is taken over sliding windows. The
+ * integrated loudness leaves out quiet passages with the absolute and
+ * relative gates. Rather than keeping every 400ms block since the
+ * start of the track they are counted in a histogram of their
+ * loudness.
+ *
+ * The channels are filtered four at a time with SSE, and the true peak
+ * filter's taps are summed four at a time.
+ */
+class Meter : public DSP
+{
+	public:
+		/**
+		 * Construct the metering plugin.
+		 */
+		Meter();
+		virtual ~Meter();
+		void processPCMBlock(PCMBlock* block);
+		void* getDSPData();
+		void relenquishDSPData();
+
+	private:
+		/**
+		 * Work out the filters for a format and start again.
+		 */
+		void setFormat(int sampleRate, int channels);
+
+		/**
+		 * K-weight frames start to end of the planes and add the
+		 * power of each channel to subBlockPower.
+		 */
+		void kWeight(float* const* planes, int start, int end);
+
+		/**
+		 * Find the true peak of the planes.
+		 */
+		float findTruePeak(float* const* planes, int noFrames);
+
+		/**
+		 * Finish a sub block and work out the loudness windows.
+		 */
+		void endSubBlock();
+
+		/**
+		 * Work out the gated loudness from the histogram.
+		 */
+		float integratedLoudness();
+
+		pthread_mutex_t* PCMDataMutex;
+		int sampleRate;
+		int channels;
+
+		// The weight of each channel's power in the loudness.
+		float weights[PCM_MAX_CHANNELS];
+
+		// The two K-weighting biquads, normalised so a0 is 1.
+		float shelf[5];
+		float highPass[5];
+
+		// The state of the biquads for each channel.
+		float shelfZ1[PCM_MAX_CHANNELS];
+		float shelfZ2[PCM_MAX_CHANNELS];
+		float highPassZ1[PCM_MAX_CHANNELS];
+		float highPassZ2[PCM_MAX_CHANNELS];
+
+		// The oversampling filter, each phase reversed so it lines
+		// up with the samples it multiplies.
+		float oversample[METER_OVERSAMPLE][METER_TAPS_PER_PHASE];
+
+		// The last samples of each channel for the next block's
+		// true peak, followed by the current block.
+		std::vector<float> extended[PCM_MAX_CHANNELS];
+
+		// Used to split the samples if the block doesn't have planes.
+		std::vector<float> planeBuf;
+
+		// The weighted power of each channel so far in this sub block.
+		double subBlockPower[PCM_MAX_CHANNELS];
+		int subBlockLength;
+		int subBlockFrames;
+
+		// The total power of the last METER_SHORT_TERM_SUB_BLOCKS
+		// sub blocks, subBlockHead is the newest.
+		std::vector<double> subBlocks;
+		int subBlockHead;
+		int subBlockCount;
+
+		// The number of 400ms blocks at each loudness and the sum
+		// of their powers.
+		std::vector<int> histogramCount;
+		std::vector<double> histogramPower;
+
+		// The loudness windows, only used by the DSP thread.
+		float momentary;
+		float shortTerm;
+		float level;
+
+		// The latest results, only changed with the lock held.
+		MeterData results;
+		bool hasData;
+		MeterData* MeterDataStruct;
+};
+
+#endif
@@ -24,17 +24,87 @@
 #include <string.h>
 #include <exception>
 #include <stdlib.h>
+#include <limits.h>
 #include "pcm.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * Find the lowest and highest of a number of samples.
+ */
+static void findRange(const int16_t* data, int len, int16_t* min, int16_t* max)
+{
+	int16_t lo = SHRT_MAX;
+	int16_t hi = SHRT_MIN;
+	int i = 0;
+
+#ifdef __SSE2__
+	// Look at eight samples at a time.
+	if(len >= 8)
+	{
+		__m128i vlo = _mm_set1_epi16(SHRT_MAX);
+		__m128i vhi = _mm_set1_epi16(SHRT_MIN);
+		for(; i + 8 <= len; i += 8)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+			vlo = _mm_min_epi16(vlo, v);
+			vhi = _mm_max_epi16(vhi, v);
+		}
+
+		int16_t lanes[8];
+		_mm_storeu_si128((__m128i*)lanes, vlo);
+		for(int j = 0; j < 8; j++)
+			if(lanes[j] < lo)
+				lo = lanes[j];
+		_mm_storeu_si128((__m128i*)lanes, vhi);
+		for(int j = 0; j < 8; j++)
+			if(lanes[j] > hi)
+				hi = lanes[j];
+	}
+#endif
+
+	for(; i < len; i++)
+	{
+		if(data[i] < lo)
+			lo = data[i];
+		if(data[i] > hi)
+			hi = data[i];
+	}
+
+	*min = lo;
+	*max = hi;
+}
 
 PCM::PCM()
 {
 	// Set member variables
 	data = NULL;
+	dataLength = 0;
+	envelopeColumns = 0;
+	envelopeMin = NULL;
+	envelopeMax = NULL;
+	sampleRate = 0;
+	partialFrames = 0;
+	partialMin = 0;
+	partialMax = 0;
 	
-	// Initialise the mutex.
+	// Initialise the mutexes.
 	PCMDataMutex = new pthread_mutex_t;
 	if(pthread_mutex_init(PCMDataMutex, NULL) != 0)
 		throw(std::exception());
+
+	historyMutex = new pthread_mutex_t;
+	if(pthread_mutex_init(historyMutex, NULL) != 0)
+		throw(std::exception());
+
+	for(int i = 0; i < PCM_HISTORY_LEVELS; i++)
+	{
+		history[i].min = (int16_t*)calloc(PCM_HISTORY_LENGTH, sizeof(int16_t));
+		history[i].max = (int16_t*)calloc(PCM_HISTORY_LENGTH, sizeof(int16_t));
+		history[i].count = 0;
+		history[i].pending = false;
+	}
 	
 	PCMDataStruct = new PCMData;
 }
@@ -44,30 +114,194 @@ PCM::~PCM()
 	// If a data buffer was allocated, destroy it
 	if(data != NULL)
 		free(data);
+
+	free(envelopeMin);
+	free(envelopeMax);
+	for(int i = 0; i < PCM_HISTORY_LEVELS; i++)
+	{
+		free(history[i].min);
+		free(history[i].max);
+	}
 	
 	delete PCMDataStruct;
 	
-	// Destroy the mutex
+	// Destroy the mutexes
 	pthread_mutex_destroy(PCMDataMutex);
+	delete PCMDataMutex;
+	pthread_mutex_destroy(historyMutex);
+	delete historyMutex;
 }
 
-void PCM::processPCMData(int16_t* data, int len, int SEQ)
+void PCM::copyBlock(int16_t* data, int len)
 {
-	if(this->data == NULL)
-	{
-		this->data = (int16_t*)malloc(sizeof(int16_t) * len);
-		this->dataLength = len;
-	}
 	// If the data isn't being used, then copy it
 	if(pthread_mutex_trylock(PCMDataMutex) == 0)
 	{
+		// Resize the buffer if the blocks have changed size.
+		if(len != dataLength)
+		{
+			this->data = (int16_t*)realloc(this->data, sizeof(int16_t) * len);
+			this->dataLength = len;
+		}
 		memcpy(this->data, data, len * sizeof(int16_t));
+
+		// Split the block into columns and find the range of each.
+		for(int i = 0; i < envelopeColumns; i++)
+		{
+			int start = (int)(((int64_t)i * len) / envelopeColumns);
+			int end = (int)(((int64_t)(i + 1) * len) / envelopeColumns);
+			if(end <= start)
+				end = start + 1;
+			if(end > len)
+			{
+				envelopeMin[i] = envelopeMax[i] = 0;
+				continue;
+			}
+			findRange(data + start, end - start, &envelopeMin[i], &envelopeMax[i]);
+		}
 		
 		// also release the mutex
 		pthread_mutex_unlock(PCMDataMutex);
 	}
 }
 
+void PCM::processPCMBlock(PCMBlock* block)
+{
+	copyBlock(block->data, block->dataLength);
+
+	// The history is always added to, so that there aren't any
+	// gaps in it.
+	pthread_mutex_lock(historyMutex);
+	sampleRate = block->sampleRate;
+	addHistory(block->data, block->dataLength / block->channels,
+	           block->channels);
+	pthread_mutex_unlock(historyMutex);
+}
+
+void PCM::setEnvelopeColumns(int columns)
+{
+	pthread_mutex_lock(PCMDataMutex);
+	envelopeColumns = columns;
+	envelopeMin = (int16_t*)realloc(envelopeMin, sizeof(int16_t) * columns);
+	envelopeMax = (int16_t*)realloc(envelopeMax, sizeof(int16_t) * columns);
+	memset(envelopeMin, 0, sizeof(int16_t) * columns);
+	memset(envelopeMax, 0, sizeof(int16_t) * columns);
+	pthread_mutex_unlock(PCMDataMutex);
+}
+
+void PCM::addHistory(int16_t* data, int frames, int channels)
+{
+	int done = 0;
+	while(done < frames)
+	{
+		// Take as many frames as are needed to finish the
+		// current entry.
+		int take = PCM_HISTORY_BASE - partialFrames;
+		if(take > frames - done)
+			take = frames - done;
+
+		int16_t min, max;
+		findRange(data + (done * channels), take * channels, &min, &max);
+		if(partialFrames == 0 || min < partialMin)
+			partialMin = min;
+		if(partialFrames == 0 || max > partialMax)
+			partialMax = max;
+
+		partialFrames += take;
+		done += take;
+
+		if(partialFrames == PCM_HISTORY_BASE)
+		{
+			addHistoryEntry(0, partialMin, partialMax);
+			partialFrames = 0;
+		}
+	}
+}
+
+void PCM::addHistoryEntry(int level, int16_t min, int16_t max)
+{
+	PCMHistoryLevel* l = &history[level];
+	int index = l->count % PCM_HISTORY_LENGTH;
+	l->min[index] = min;
+	l->max[index] = max;
+	l->count++;
+
+	if(level + 1 == PCM_HISTORY_LEVELS)
+		return;
+
+	// Every pair of entries makes one entry in the level above.
+	if(l->pending)
+	{
+		addHistoryEntry(level + 1,
+		                min < l->pendingMin ? min : l->pendingMin,
+		                max > l->pendingMax ? max : l->pendingMax);
+		l->pending = false;
+	}
+	else
+	{
+		l->pendingMin = min;
+		l->pendingMax = max;
+		l->pending = true;
+	}
+}
+
+int PCM::getHistory(double seconds, int columns, int16_t* min, int16_t* max)
+{
+	memset(min, 0, sizeof(int16_t) * columns);
+	memset(max, 0, sizeof(int16_t) * columns);
+
+	pthread_mutex_lock(historyMutex);
+	if(sampleRate == 0 || columns <= 0 || seconds <= 0)
+	{
+		pthread_mutex_unlock(historyMutex);
+		return 0;
+	}
+
+	// Use the coarsest level that still has at least one entry for
+	// each column, so each column only needs a couple of entries.
+	double framesPerColumn = (seconds * sampleRate) / columns;
+	int level = 0;
+	while(level + 1 < PCM_HISTORY_LEVELS &&
+	      (double)(PCM_HISTORY_BASE << (level + 1)) <= framesPerColumn)
+		level++;
+
+	PCMHistoryLevel* l = &history[level];
+	double entriesPerColumn = framesPerColumn / (PCM_HISTORY_BASE << level);
+	int64_t available = l->count < PCM_HISTORY_LENGTH ? l->count : PCM_HISTORY_LENGTH;
+
+	// Work backwards from the newest entry. Entries are counted
+	// back from the newest, which is entry 0.
+	int filled = 0;
+	for(int i = columns - 1; i >= 0; i--)
+	{
+		int64_t newest = (int64_t)((columns - 1 - i) * entriesPerColumn);
+		int64_t oldest = (int64_t)((columns - i) * entriesPerColumn);
+		if(oldest <= newest)
+			oldest = newest + 1;
+		if(newest >= available)
+			break;
+		if(oldest > available)
+			oldest = available;
+
+		int16_t lo = SHRT_MAX;
+		int16_t hi = SHRT_MIN;
+		for(int64_t j = newest; j < oldest; j++)
+		{
+			int index = (l->count - 1 - j) % PCM_HISTORY_LENGTH;
+			if(l->min[index] < lo)
+				lo = l->min[index];
+			if(l->max[index] > hi)
+				hi = l->max[index];
+		}
+		min[i] = lo;
+		max[i] = hi;
+		filled++;
+	}
+
+	pthread_mutex_unlock(historyMutex);
+	return filled;
+}
+
 void* PCM::getDSPData()
 {
 	// Ensure we have some data
@@ -80,6 +314,9 @@ void* PCM::getDSPData()
 	// set the structure variables
 	PCMDataStruct->data = this->data;
 	PCMDataStruct->dataLength = this->dataLength;
+	PCMDataStruct->envelopeMin = envelopeMin;
+	PCMDataStruct->envelopeMax = envelopeMax;
+	PCMDataStruct->envelopeLength = envelopeColumns;
 	
 	// return the result.
 	return (void*)PCMDataStruct;
@@ -27,30 +27,130 @@
 #include <pthread.h>
 #include "dsp.h"
 
+// The number of frames in each entry of the bottom level of the
+// history.
+#define PCM_HISTORY_BASE 64
+
+// The number of levels in the history, each one has entries for twice
+// as many frames as the one below it.
+#define PCM_HISTORY_LEVELS 12
+
+// The number of entries kept at each level of the history.
+#define PCM_HISTORY_LENGTH 4096
+
 typedef struct
 {
 	int16_t* data;
 	int dataLength;
+
+	// The lowest and highest sample in each column of data, when
+	// it is split into envelopeLength columns.
+	int16_t* envelopeMin;
+	int16_t* envelopeMax;
+	int envelopeLength;
 }PCMData;
 
+/**
+ * One level of the history, a circular buffer of the lowest and
+ * highest samples over a number of frames.
+ */
+typedef struct
+{
+	int16_t* min;
+	int16_t* max;
+
+	// The total number of entries that have been added.
+	uint64_t count;
+
+	// Whether there is an entry waiting for its partner before it
+	// can be added to the level above.
+	bool pending;
+	int16_t pendingMin;
+	int16_t pendingMax;
+}PCMHistoryLevel;
+
 /**
  * This class will expose the RAW PCM data
  * to the visualiser.
+ *
+ * Along with the samples of the latest block, the PCM plugin works out
+ * the envelope of the block, the lowest and highest sample in each of
+ * a number of columns, so that a waveform can be drawn with one line
+ * for each column of pixels rather than one for each sample.
+ *
+ * It also keeps a history of the envelope as a pyramid. Each level
+ * holds the lowest and highest sample over twice as many frames as the
+ * level below, so a waveform of the last few seconds or minutes can be
+ * drawn from whichever level has about one entry for each column.
  */
 class PCM : public DSP
 {
 	public:
 		PCM();
 		~PCM();
-		void processPCMData(int16_t* data, int len, int SEQ);
+		void processPCMBlock(PCMBlock* block);
 		void* getDSPData();
 		void relenquishDSPData();
-	
+
+		/**
+		 * Set the number of columns that the envelope of the latest
+		 * block is split into. Normally this is the width of the window.
+		 * @param columns the number of columns, 0 to not work out the
+		 * envelope.
+		 */
+		void setEnvelopeColumns(int columns);
+
+		/**
+		 * Get the envelope of the last few seconds of audio. This
+		 * takes its own lock, it doesn't need to be called between
+		 * getDSPData() and relenquishDSPData().
+		 * @param seconds how far back to go.
+		 * @param columns the number of columns to split the time into.
+		 * @param min filled with the lowest sample in each column,
+		 * oldest first.
+		 * @param max filled with the highest sample in each column.
+		 * @returns the number of columns at the end of min and max
+		 * that have any audio, the columns before them are filled with
+		 * silence.
+		 */
+		int getHistory(double seconds, int columns, int16_t* min, int16_t* max);
+
 	private:
+		/**
+		 * Copy the latest block and work out its envelope, unless the
+		 * visualiser is using the last one.
+		 */
+		void copyBlock(int16_t* data, int len);
+
+		/**
+		 * Add frames to the history.
+		 */
+		void addHistory(int16_t* data, int frames, int channels);
+
+		/**
+		 * Add an entry to a level of the history, and pass every other
+		 * one up to the level above.
+		 */
+		void addHistoryEntry(int level, int16_t min, int16_t max);
+
 		pthread_mutex_t* PCMDataMutex;
 		int16_t* data;
 		int dataLength;
 		PCMData* PCMDataStruct;
+
+		int envelopeColumns;
+		int16_t* envelopeMin;
+		int16_t* envelopeMax;
+
+		pthread_mutex_t* historyMutex;
+		PCMHistoryLevel history[PCM_HISTORY_LEVELS];
+		int sampleRate;
+
+		// The range of the frames that haven't made a whole entry
+		// of the bottom level yet.
+		int partialFrames;
+		int16_t partialMin;
+		int16_t partialMax;
 };
 
 #endif
@@ -0,0 +1,283 @@
+/****************************************
+ *
+ * pitch.cpp
+ * Define a pitch tracking plugin class.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "pitch.h"
+#include "fftPlanCache.h"
+
+Pitch::Pitch(double minFreq, double maxFreq, double threshold)
+{
+	PCMDataMutex = new pthread_mutex_t;
+	pthread_mutex_init(PCMDataMutex, NULL);
+
+	this->minFreq = minFreq;
+	this->maxFreq = maxFreq;
+	this->threshold = threshold;
+	sampleRate = 0;
+	minLag = 0;
+	maxLag = 0;
+	windowLength = 0;
+	fftLength = 0;
+	samples = NULL;
+	in = NULL;
+	windowSpectrum = NULL;
+	headSpectrum = NULL;
+	correlation = NULL;
+	frequency = 0;
+	confidence = 0;
+	time = 0;
+	hasData = false;
+	PitchDataStruct = new PitchData;
+}
+
+Pitch::~Pitch()
+{
+	freeBuffers();
+	delete PitchDataStruct;
+	pthread_mutex_destroy(PCMDataMutex);
+	delete PCMDataMutex;
+}
+
+void Pitch::freeBuffers()
+{
+	if(in)
+		fftw_free(in);
+	if(windowSpectrum)
+		fftw_free(windowSpectrum);
+	if(headSpectrum)
+		fftw_free(headSpectrum);
+	if(correlation)
+		fftw_free(correlation);
+	if(samples)
+		delete samples;
+	in = NULL;
+	windowSpectrum = NULL;
+	headSpectrum = NULL;
+	correlation = NULL;
+	samples = NULL;
+}
+
+void Pitch::makeBuffers(int sampleRate)
+{
+	this->sampleRate = sampleRate;
+
+	minLag = (int)floor(sampleRate / maxFreq);
+	if(minLag < 2)
+		minLag = 2;
+	maxLag = (int)ceil(sampleRate / minFreq) + 1;
+	if(maxLag < minLag + 2)
+		maxLag = minLag + 2;
+	windowLength = maxLag * 2;
+
+	// Correlating the window with its first maxLag frames gives
+	// windowLength + maxLag - 1 terms.
+	fftLength = 1;
+	while(fftLength < windowLength + maxLag)
+		fftLength <<= 1;
+
+	int noComplex = (fftLength / 2) + 1;
+	in = (double*)fftw_malloc(sizeof(double) * fftLength);
+	windowSpectrum = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * noComplex);
+	headSpectrum = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * noComplex);
+	correlation = (double*)fftw_malloc(sizeof(double) * fftLength);
+	samples = new circularBuffer::circularBuffer<float>(windowLength);
+	window.resize(windowLength);
+	energy.resize(windowLength + 1);
+	difference.resize(maxLag);
+	hasData = false;
+}
+
+void Pitch::processPCMBlock(PCMBlock* block)
+{
+	int noFrames = block->dataLength / block->channels;
+	int rate = block->sampleRate ? block->sampleRate : PCM_DEFAULT_SAMPLE_RATE;
+
+	// Attempt to process the data, if not - skip this set of samples.
+	if(pthread_mutex_trylock(PCMDataMutex) != 0)
+		return;
+
+	if(rate != sampleRate)
+	{
+		freeBuffers();
+		makeBuffers(rate);
+	}
+
+	// Average the channels.
+	if((int)mixed.size() < noFrames)
+		mixed.resize(noFrames);
+	pcmMixDown(block, &mixed[0]);
+
+	// Slide the window along.
+	float* newest = &mixed[0];
+	if(noFrames > windowLength)
+	{
+		newest += noFrames - windowLength;
+		noFrames = windowLength;
+	}
+	int excess = (int)samples->size() + noFrames - windowLength;
+	if(excess > 0)
+		samples->commitRead(excess);
+	samples->write(newest, noFrames);
+
+	// Wait until the window is full, silence would look periodic.
+	if((int)samples->size() < windowLength)
+	{
+		pthread_mutex_unlock(PCMDataMutex);
+		return;
+	}
+
+	circularBuffer::segment<float> first, second;
+	samples->getReadSegments(first, second);
+	memcpy(&window[0], first.data, sizeof(float) * first.length);
+	memcpy(&window[first.length], second.data, sizeof(float) * second.length);
+
+	findPitch();
+
+	// The middle of the window is heard half a window before the
+	// end of this block.
+	time = block->presentationTime;
+	if(block->sampleRate)
+	{
+		time += ((uint64_t)(block->dataLength / block->channels) * 1000000) / rate;
+		time -= ((uint64_t)windowLength * 500000) / rate;
+	}
+	hasData = true;
+
+	pthread_mutex_unlock(PCMDataMutex);
+}
+
+void Pitch::findPitch()
+{
+	int noComplex = (fftLength / 2) + 1;
+
+	// Transform the whole window and its first maxLag frames.
+	for(int i = 0; i < windowLength; i++)
+		in[i] = window[i];
+	for(int i = windowLength; i < fftLength; i++)
+		in[i] = 0;
+	fftw_execute_dft_r2c(fftPlanCache::getR2C(fftLength), in, windowSpectrum);
+	for(int i = maxLag; i < windowLength; i++)
+		in[i] = 0;
+	fftw_execute_dft_r2c(fftPlanCache::getR2C(fftLength), in, headSpectrum);
+
+	// Multiplying one by the conjugate of the other correlates them,
+	// correlation[lag] is the sum of window[j] * window[j + lag] for
+	// the first maxLag values of j.
+	double scale = 1.0 / fftLength;
+	for(int k = 0; k < noComplex; k++)
+	{
+		double aReal = windowSpectrum[k][0];
+		double aImag = windowSpectrum[k][1];
+		double bReal = headSpectrum[k][0];
+		double bImag = headSpectrum[k][1];
+		windowSpectrum[k][0] = ((aReal * bReal) + (aImag * bImag)) * scale;
+		windowSpectrum[k][1] = ((aImag * bReal) - (aReal * bImag)) * scale;
+	}
+	fftw_execute_dft_c2r(fftPlanCache::getC2R(fftLength), windowSpectrum, correlation);
+
+	// The running total of the squared samples gives the energy of
+	// any run of them.
+	energy[0] = 0;
+	for(int i = 0; i < windowLength; i++)
+		energy[i + 1] = energy[i] + ((double)window[i] * window[i]);
+
+	// The difference between the first maxLag frames and the maxLag
+	// frames starting lag later is the sum of their energies less
+	// twice their correlation. Dividing by the mean difference of the
+	// shorter lags stops it favouring a lag of zero.
+	difference[0] = 1;
+	double total = 0;
+	for(int lag = 1; lag < maxLag; lag++)
+	{
+		double d = energy[maxLag] + (energy[lag + maxLag] - energy[lag]) -
+		           (2 * correlation[lag]);
+		if(d < 0)
+			d = 0;
+		total += d;
+		difference[lag] = total > 0 ? (float)((d * lag) / total) : 1;
+	}
+
+	// Take the first dip under the threshold, or failing that the
+	// lowest one.
+	int best = -1;
+	for(int lag = minLag; lag < maxLag; lag++)
+	{
+		if(difference[lag] < threshold)
+		{
+			while(lag + 1 < maxLag && difference[lag + 1] < difference[lag])
+				lag++;
+			best = lag;
+			break;
+		}
+	}
+	bool found = best != -1;
+	if(!found)
+	{
+		best = minLag;
+		for(int lag = minLag + 1; lag < maxLag; lag++)
+			if(difference[lag] < difference[best])
+				best = lag;
+	}
+
+	// Fit a parabola through the dip and its neighbours to find the
+	// period between frames.
+	double period = best;
+	if(best > 0 && best < maxLag - 1)
+	{
+		double before = difference[best - 1];
+		double at = difference[best];
+		double after = difference[best + 1];
+		double curve = before - (2 * at) + after;
+		if(curve > 0)
+			period += (before - after) / (2 * curve);
+	}
+
+	confidence = 1 - difference[best];
+	if(confidence < 0)
+		confidence = 0;
+	frequency = found ? (float)(sampleRate / period) : 0;
+}
+
+void* Pitch::getDSPData()
+{
+	// Ensure we have some data
+	if(!hasData)
+		return NULL;
+
+	// grab the mutex
+	pthread_mutex_lock(PCMDataMutex);
+
+	// set the structure variables
+	PitchDataStruct->frequency = frequency;
+	PitchDataStruct->confidence = confidence;
+	PitchDataStruct->time = time;
+
+	return (void*)PitchDataStruct;
+}
+
+void Pitch::relenquishDSPData()
+{
+	pthread_mutex_unlock(PCMDataMutex);
+}
@@ -0,0 +1,130 @@
+/****************************************
+ *
+ * pitch.h
+ * Declare a pitch tracking plugin class.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PITCH_H_
+#define _PITCH_H_
+
+#include <fftw3.h>
+#include <pthread.h>
+#include <vector>
+#include "dsp.h"
+#include "../circularBuffer.h"
+
+typedef struct
+{
+	// The fundamental frequency in Hz, 0 if no pitch was found.
+	float frequency;
+
+	// How periodic the audio is, from 0 for noise to 1 for a
+	// perfectly steady tone.
+	float confidence;
+
+	// When the middle of the window the pitch was found in is heard.
+	uint64_t time;
+}PitchData;
+
+/**
+ * Estimate the pitch of the audio with the YIN algorithm, see de
+ * Cheveigné and Kawahara, "YIN, a fundamental frequency estimator for
+ * speech and music".
+ *
+ * YIN compares the audio with itself delayed by each period it could
+ * have and picks the shortest one where the two match well. Working
+ * out the differences directly costs a multiply for every pair of
+ * delay and sample, so instead the cross terms are found all at once
+ * as a correlation with a FFT and the rest from running sums of the
+ * squared samples.
+ */
+class Pitch : public DSP
+{
+	public:
+		/**
+		 * Construct the pitch plugin. The buffers are made when the
+		 * sample rate is known.
+		 * @param minFreq the lowest pitch looked for in Hz. Lower
+		 * pitches need a longer window, so respond slower.
+		 * @param maxFreq the highest pitch looked for in Hz.
+		 * @param threshold how far the audio may differ from itself
+		 * one period later for the period to be accepted.
+		 */
+		Pitch(double minFreq = 60, double maxFreq = 1500,
+		      double threshold = 0.15);
+		virtual ~Pitch();
+		void processPCMBlock(PCMBlock* block);
+		void* getDSPData();
+		void relenquishDSPData();
+
+	private:
+		/**
+		 * Make the buffers for a sample rate.
+		 */
+		void makeBuffers(int sampleRate);
+
+		/**
+		 * Free the buffers.
+		 */
+		void freeBuffers();
+
+		/**
+		 * Work out the pitch of the samples in window.
+		 */
+		void findPitch();
+
+		pthread_mutex_t* PCMDataMutex;
+		double minFreq;
+		double maxFreq;
+		double threshold;
+		int sampleRate;
+
+		// The range of periods looked at in frames. The window is
+		// twice the longest period so that every period is compared
+		// over the same number of frames.
+		int minLag;
+		int maxLag;
+		int windowLength;
+
+		// The length of the FFT, long enough that the correlation
+		// doesn't wrap around.
+		int fftLength;
+
+		// The last windowLength frames of the averaged channels.
+		circularBuffer::circularBuffer<float>* samples;
+		std::vector<float> mixed;
+		std::vector<float> window;
+
+		// Scratch buffers for the correlation.
+		double* in;
+		fftw_complex* windowSpectrum;
+		fftw_complex* headSpectrum;
+		double* correlation;
+		std::vector<double> energy;
+		std::vector<float> difference;
+
+		float frequency;
+		float confidence;
+		uint64_t time;
+		bool hasData;
+		PitchData* PitchDataStruct;
+};
+
+#endif
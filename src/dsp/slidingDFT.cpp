@@ -0,0 +1,235 @@
+/****************************************
+ *
+ * slidingDFT.cpp
+ * Define a sliding DFT plugin class.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <exception>
+#include "slidingDFT.h"
+#include "../util/alignedAlloc.h"
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+SlidingDFT::SlidingDFT(const std::vector<float>& frequencies, int windowLength)
+{
+	PCMDataMutex = new pthread_mutex_t;
+	pthread_mutex_init(PCMDataMutex, NULL);
+
+	this->frequencies = frequencies;
+	this->windowLength = windowLength;
+	noBins = frequencies.size();
+	stride = (noBins + 3) & ~3;
+	sampleRate = 0;
+	scale = 0;
+
+	real = allocAlignedFloats(stride);
+	imag = allocAlignedFloats(stride);
+	rotateReal = allocAlignedFloats(stride);
+	rotateImag = allocAlignedFloats(stride);
+	leavingReal = allocAlignedFloats(stride);
+	leavingImag = allocAlignedFloats(stride);
+	if(real == NULL || imag == NULL || rotateReal == NULL ||
+	   rotateImag == NULL || leavingReal == NULL || leavingImag == NULL)
+		throw(std::exception());
+
+	delay.assign(windowLength, 0);
+	delayPosition = 0;
+	sinceSnapshot = 0;
+
+	history.assign(noBins * SDFT_HISTORY_LENGTH, 0);
+	historyTime.assign(SDFT_HISTORY_LENGTH, 0);
+	historyHead = 0;
+	historyCount = 0;
+
+	hasData = false;
+	SDFTDataStruct = new SDFTData;
+}
+
+SlidingDFT::~SlidingDFT()
+{
+	free(real);
+	free(imag);
+	free(rotateReal);
+	free(rotateImag);
+	free(leavingReal);
+	free(leavingImag);
+	delete SDFTDataStruct;
+	pthread_mutex_destroy(PCMDataMutex);
+	delete PCMDataMutex;
+}
+
+void SlidingDFT::setSampleRate(int sampleRate)
+{
+	this->sampleRate = sampleRate;
+
+	// Each bin is the sum of the last N frames x(n - m) * z^m where
+	// z = r * e^(-iw). Each frame the sum is multiplied by z, the new
+	// frame is added and the one leaving is taken away times z^N.
+	double dampingN = pow(SDFT_DAMPING, windowLength);
+	for(int b = 0; b < noBins; b++)
+	{
+		double w = (2 * M_PI * frequencies[b]) / sampleRate;
+		rotateReal[b] = (float)(SDFT_DAMPING * cos(w));
+		rotateImag[b] = (float)(-SDFT_DAMPING * sin(w));
+		leavingReal[b] = (float)(dampingN * cos(w * windowLength));
+		leavingImag[b] = (float)(-dampingN * sin(w * windowLength));
+	}
+
+	// A sine wave of amplitude A sums to A / 2 times the sum of the
+	// damping over the window.
+	scale = (float)((2 * (1 - SDFT_DAMPING)) / (1 - dampingN));
+
+	// Start again from silence.
+	memset(real, 0, sizeof(float) * stride);
+	memset(imag, 0, sizeof(float) * stride);
+	delay.assign(windowLength, 0);
+	delayPosition = 0;
+	sinceSnapshot = 0;
+	historyCount = 0;
+}
+
+void SlidingDFT::processPCMBlock(PCMBlock* block)
+{
+	int noFrames = block->dataLength / block->channels;
+	int rate = block->sampleRate ? block->sampleRate : PCM_DEFAULT_SAMPLE_RATE;
+
+	// Average the channels.
+	if((int)mixed.size() < noFrames)
+		mixed.resize(noFrames);
+	pcmMixDown(block, &mixed[0]);
+
+	// Unlike the block based plugins, every frame has to be seen to
+	// keep the sums right, so wait for the lock rather than skipping.
+	pthread_mutex_lock(PCMDataMutex);
+
+	if(rate != sampleRate)
+		setSampleRate(rate);
+
+	for(int i = 0; i < noFrames; i++)
+	{
+		float x = mixed[i];
+		float leaving = delay[delayPosition];
+		delay[delayPosition] = x;
+		if(++delayPosition == windowLength)
+			delayPosition = 0;
+
+#ifdef __SSE__
+		__m128 vx = _mm_set1_ps(x);
+		__m128 vLeaving = _mm_set1_ps(leaving);
+		for(int b = 0; b < stride; b += 4)
+		{
+			__m128 re = _mm_load_ps(real + b);
+			__m128 im = _mm_load_ps(imag + b);
+			__m128 zr = _mm_load_ps(rotateReal + b);
+			__m128 zi = _mm_load_ps(rotateImag + b);
+			__m128 newRe = _mm_sub_ps(_mm_mul_ps(zr, re), _mm_mul_ps(zi, im));
+			__m128 newIm = _mm_add_ps(_mm_mul_ps(zr, im), _mm_mul_ps(zi, re));
+			newRe = _mm_add_ps(newRe, vx);
+			newRe = _mm_sub_ps(newRe, _mm_mul_ps(_mm_load_ps(leavingReal + b), vLeaving));
+			newIm = _mm_sub_ps(newIm, _mm_mul_ps(_mm_load_ps(leavingImag + b), vLeaving));
+			_mm_store_ps(real + b, newRe);
+			_mm_store_ps(imag + b, newIm);
+		}
+#else
+		for(int b = 0; b < stride; b++)
+		{
+			float re = real[b];
+			float im = imag[b];
+			real[b] = (rotateReal[b] * re) - (rotateImag[b] * im) + x -
+			          (leavingReal[b] * leaving);
+			imag[b] = (rotateReal[b] * im) + (rotateImag[b] * re) -
+			          (leavingImag[b] * leaving);
+		}
+#endif
+
+		if(++sinceSnapshot == SDFT_SNAPSHOT_FRAMES)
+		{
+			takeSnapshot(block->presentationTime +
+			             (((uint64_t)(i + 1) * 1000000) / rate));
+			sinceSnapshot = 0;
+		}
+	}
+
+	pthread_mutex_unlock(PCMDataMutex);
+}
+
+void SlidingDFT::takeSnapshot(uint64_t time)
+{
+	historyHead = (historyHead + 1) % SDFT_HISTORY_LENGTH;
+	if(historyCount < SDFT_HISTORY_LENGTH)
+		historyCount++;
+
+	float* snapshot = &history[historyHead * noBins];
+	for(int b = 0; b < noBins; b++)
+		snapshot[b] = scale * sqrtf((real[b] * real[b]) + (imag[b] * imag[b]));
+	historyTime[historyHead] = time;
+	hasData = true;
+}
+
+void* SlidingDFT::getDSPData()
+{
+	// Ensure we have some data
+	if(!hasData)
+		return NULL;
+
+	// grab the mutex
+	pthread_mutex_lock(PCMDataMutex);
+
+	// set the structure variables
+	SDFTDataStruct->magnitude = &history[historyHead * noBins];
+	SDFTDataStruct->noBins = noBins;
+	SDFTDataStruct->frequencies = &frequencies[0];
+	SDFTDataStruct->time = historyTime[historyHead];
+
+	return (void*)SDFTDataStruct;
+}
+
+void* SlidingDFT::getDSPDataAt(uint64_t time)
+{
+	// Ensure we have some data
+	if(!hasData)
+		return NULL;
+
+	// grab the mutex
+	pthread_mutex_lock(PCMDataMutex);
+
+	// Walk back from the newest result to the first one that has
+	// been heard by the time. If they are all later use the oldest.
+	int index = historyHead;
+	for(int i = 1; i < historyCount && historyTime[index] > time; i++)
+		index = (historyHead - i + SDFT_HISTORY_LENGTH) % SDFT_HISTORY_LENGTH;
+
+	// set the structure variables
+	SDFTDataStruct->magnitude = &history[index * noBins];
+	SDFTDataStruct->noBins = noBins;
+	SDFTDataStruct->frequencies = &frequencies[0];
+	SDFTDataStruct->time = historyTime[index];
+
+	return (void*)SDFTDataStruct;
+}
+
+void SlidingDFT::relenquishDSPData()
+{
+	pthread_mutex_unlock(PCMDataMutex);
+}
@@ -0,0 +1,138 @@
+/****************************************
+ *
+ * slidingDFT.h
+ * Declare a sliding DFT plugin class.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SLIDINGDFT_H_
+#define _SLIDINGDFT_H_
+
+#include <pthread.h>
+#include <vector>
+#include "dsp.h"
+
+// How much each bin's sum decays by every frame. Slightly less than 1
+// so that rounding errors die away rather than building up.
+#define SDFT_DAMPING 0.9999
+
+// The number of frames between each result that is kept.
+#define SDFT_SNAPSHOT_FRAMES 32
+
+// The number of results kept, about three seconds at 44.1kHz.
+#define SDFT_HISTORY_LENGTH 4096
+
+typedef struct
+{
+	// The amplitude at each frequency. A sine wave of amplitude A at
+	// one of the frequencies gives about A.
+	float* magnitude;
+	int noBins;
+
+	// The frequency of each bin in Hz.
+	const float* frequencies;
+
+	// The time that the newest sample analysed is heard.
+	uint64_t time;
+}SDFTData;
+
+/**
+ * Track a few frequencies with a sliding DFT, which is updated for
+ * every sample rather than once a block.
+ *
+ * Each bin is the DFT of the last windowLength frames at one frequency.
+ * When a frame arrives the bin is rotated by the frequency, the new
+ * frame is added and the one leaving the window is taken away, so
+ * keeping a bin up to date costs a complex multiply per frame however
+ * long the window is. The bins are kept in arrays so that four are
+ * updated at once with SSE.
+ *
+ * A result is kept every SDFT_SNAPSHOT_FRAMES frames, under a
+ * millisecond apart, and getDSPDataAt() returns the one that is heard
+ * at a certain time.
+ */
+class SlidingDFT : public DSP
+{
+	public:
+		/**
+		 * Construct the sliding DFT plugin.
+		 * @param frequencies the frequencies to track in Hz.
+		 * @param windowLength the number of frames in each DFT. Longer
+		 * windows can tell closer frequencies apart but respond slower.
+		 */
+		SlidingDFT(const std::vector<float>& frequencies, int windowLength = 1024);
+		virtual ~SlidingDFT();
+		void processPCMBlock(PCMBlock* block);
+		void* getDSPData();
+		void* getDSPDataAt(uint64_t time);
+		void relenquishDSPData();
+
+	private:
+		/**
+		 * Work out the rotation of each bin for a sample rate.
+		 */
+		void setSampleRate(int sampleRate);
+
+		/**
+		 * Store the magnitude of each bin in the history.
+		 */
+		void takeSnapshot(uint64_t time);
+
+		pthread_mutex_t* PCMDataMutex;
+		int windowLength;
+		int sampleRate;
+		int noBins;
+
+		// The number of bins rounded up to a multiple of four.
+		int stride;
+
+		std::vector<float> frequencies;
+
+		// The sum for each bin, and what it is multiplied by each
+		// frame. leaving is what the frame leaving the window is
+		// multiplied by before it is taken away.
+		float* real;
+		float* imag;
+		float* rotateReal;
+		float* rotateImag;
+		float* leavingReal;
+		float* leavingImag;
+
+		// The last windowLength frames.
+		std::vector<float> delay;
+		int delayPosition;
+
+		// Scales the sums to amplitudes.
+		float scale;
+
+		// Frames since the last snapshot.
+		int sinceSnapshot;
+
+		// A ring of results, historyHead is the newest.
+		std::vector<float> history;
+		std::vector<uint64_t> historyTime;
+		int historyHead;
+		int historyCount;
+
+		std::vector<float> mixed;
+		bool hasData;
+		SDFTData* SDFTDataStruct;
+};
+
+#endif
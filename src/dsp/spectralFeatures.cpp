@@ -0,0 +1,303 @@
+/****************************************
+ *
+ * spectralFeatures.cpp
+ * Define a spectral features plugin class.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "spectralFeatures.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// A polynomial for log2 of the mantissa, from 1 to 2.
+#define LOG2_C0 -2.51277097f
+#define LOG2_C1 4.06988857f
+#define LOG2_C2 -2.12050021f
+#define LOG2_C3 0.64507882f
+#define LOG2_C4 -0.08160777f
+
+/**
+ * Approximate log2 of a positive float, by taking the exponent
+ * directly and a polynomial of the mantissa.
+ */
+static float approxLog2(float x)
+{
+	uint32_t bits;
+	memcpy(&bits, &x, sizeof(bits));
+	float exponent = (float)((int)(bits >> 23) - 127);
+	bits = (bits & 0x007FFFFF) | 0x3F800000;
+	float m;
+	memcpy(&m, &bits, sizeof(m));
+	return exponent + LOG2_C0 +
+	       (m * (LOG2_C1 + (m * (LOG2_C2 + (m * (LOG2_C3 + (m * LOG2_C4)))))));
+}
+
+#ifdef __SSE2__
+static __m128 approxLog2(__m128 x)
+{
+	__m128i bits = _mm_castps_si128(x);
+	__m128 exponent = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23),
+	                                                _mm_set1_epi32(127)));
+	__m128 m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007FFFFF)),
+	                                         _mm_set1_epi32(0x3F800000)));
+	__m128 p = _mm_add_ps(_mm_set1_ps(LOG2_C3), _mm_mul_ps(m, _mm_set1_ps(LOG2_C4)));
+	p = _mm_add_ps(_mm_set1_ps(LOG2_C2), _mm_mul_ps(m, p));
+	p = _mm_add_ps(_mm_set1_ps(LOG2_C1), _mm_mul_ps(m, p));
+	p = _mm_add_ps(_mm_set1_ps(LOG2_C0), _mm_mul_ps(m, p));
+	return _mm_add_ps(exponent, p);
+}
+
+/**
+ * Add the four lanes of a register together.
+ */
+static float sumLanes(__m128 x)
+{
+	float lanes[4];
+	_mm_storeu_ps(lanes, x);
+	return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+#endif
+
+SpectralFeatures::SpectralFeatures(FFT* fftPlugin)
+{
+	PCMDataMutex = new pthread_mutex_t;
+	pthread_mutex_init(PCMDataMutex, NULL);
+
+	this->fftPlugin = fftPlugin;
+	lastTime = 0;
+	memset(&features, 0, sizeof(features));
+	hasData = false;
+	SpectralFeaturesDataStruct = new SpectralFeaturesData;
+}
+
+SpectralFeatures::~SpectralFeatures()
+{
+	delete SpectralFeaturesDataStruct;
+	pthread_mutex_destroy(PCMDataMutex);
+	delete PCMDataMutex;
+}
+
+void SpectralFeatures::processPCMBlock(PCMBlock* block)
+{
+	// Skip this block rather than wait if the spectrum is in use.
+	FFTData* data = (FFTData*)fftPlugin->tryGetDSPData();
+	if(data == NULL)
+		return;
+
+	// Attempt to process the data, if not - skip this set of samples.
+	// Neither lock is waited for, so holding both can't deadlock.
+	if(pthread_mutex_trylock(PCMDataMutex) != 0)
+	{
+		fftPlugin->relenquishDSPData();
+		return;
+	}
+
+	bool newSpectrum = !hasData || data->time != lastTime;
+	uint64_t spectrumTime = data->time;
+	int bins = data->dataLength;
+	if(newSpectrum)
+	{
+		// Undo the FFT's scaling so that a sine wave of amplitude A
+		// has a magnitude of A.
+		magnitude.swap(previous);
+		if((int)magnitude.size() != bins)
+			magnitude.resize(bins);
+		if((int)previous.size() != bins)
+			previous.assign(bins, 0);
+		float scale = data->amplitudeScale;
+		for(int j = 0; j < bins; j++)
+			magnitude[j] = data->magnitude[j] * scale;
+	}
+	fftPlugin->relenquishDSPData();
+
+	if(newSpectrum)
+	{
+		measureSpectrum(block->sampleRate ? block->sampleRate :
+		                                    PCM_DEFAULT_SAMPLE_RATE);
+		features.time = spectrumTime;
+		lastTime = spectrumTime;
+	}
+	features.zeroCrossingRate = zeroCrossings(block);
+	hasData = true;
+
+	pthread_mutex_unlock(PCMDataMutex);
+}
+
+void SpectralFeatures::measureSpectrum(int sampleRate)
+{
+	int bins = magnitude.size();
+	float binWidth = (sampleRate / 2.0f) / bins;
+	if((int)cumulative.size() != bins)
+		cumulative.resize(bins);
+
+	// Gather every sum in one pass. The frequency is in bins until
+	// the end.
+	float total = 0;
+	float weighted = 0;
+	float weightedSquares = 0;
+	float logPower = 0;
+	float flux = 0;
+	float power = 0;
+	int j = 0;
+#ifdef __SSE2__
+	__m128 vTotal = _mm_setzero_ps();
+	__m128 vWeighted = _mm_setzero_ps();
+	__m128 vWeightedSquares = _mm_setzero_ps();
+	__m128 vLogPower = _mm_setzero_ps();
+	__m128 vFlux = _mm_setzero_ps();
+	__m128 freq = _mm_set_ps(3, 2, 1, 0);
+	__m128 four = _mm_set1_ps(4);
+	__m128 minPower = _mm_set1_ps(SPECTRAL_MIN_POWER);
+	for(; j + 4 <= bins; j += 4)
+	{
+		__m128 m = _mm_loadu_ps(&magnitude[j]);
+		__m128 fm = _mm_mul_ps(freq, m);
+		vTotal = _mm_add_ps(vTotal, m);
+		vWeighted = _mm_add_ps(vWeighted, fm);
+		vWeightedSquares = _mm_add_ps(vWeightedSquares, _mm_mul_ps(freq, fm));
+
+		__m128 p = _mm_mul_ps(m, m);
+		vLogPower = _mm_add_ps(vLogPower, approxLog2(_mm_max_ps(p, minPower)));
+
+		__m128 rise = _mm_max_ps(_mm_sub_ps(m, _mm_loadu_ps(&previous[j])),
+		                         _mm_setzero_ps());
+		vFlux = _mm_add_ps(vFlux, _mm_mul_ps(rise, rise));
+
+		// Running total of the power, a prefix sum of the four lanes
+		// carried on from the last four.
+		float lanes[4];
+		_mm_storeu_ps(lanes, p);
+		for(int l = 0; l < 4; l++)
+		{
+			power += lanes[l];
+			cumulative[j + l] = power;
+		}
+		freq = _mm_add_ps(freq, four);
+	}
+	total = sumLanes(vTotal);
+	weighted = sumLanes(vWeighted);
+	weightedSquares = sumLanes(vWeightedSquares);
+	logPower = sumLanes(vLogPower);
+	flux = sumLanes(vFlux);
+#endif
+	for(; j < bins; j++)
+	{
+		float m = magnitude[j];
+		total += m;
+		weighted += j * m;
+		weightedSquares += (float)j * j * m;
+
+		float p = m * m;
+		logPower += approxLog2(p > SPECTRAL_MIN_POWER ? p : SPECTRAL_MIN_POWER);
+
+		float rise = m - previous[j];
+		if(rise > 0)
+			flux += rise * rise;
+
+		power += p;
+		cumulative[j] = power;
+	}
+
+	if(total > 0)
+	{
+		float centroid = weighted / total;
+		float variance = (weightedSquares / total) - (centroid * centroid);
+		features.centroid = centroid * binWidth;
+		features.spread = variance > 0 ? sqrtf(variance) * binWidth : 0;
+	}
+	else
+	{
+		features.centroid = 0;
+		features.spread = 0;
+	}
+
+	// The first bin whose running total reaches the rolloff.
+	float target = power * SPECTRAL_ROLLOFF;
+	int lowest = 0;
+	int highest = bins - 1;
+	while(lowest < highest)
+	{
+		int middle = (lowest + highest) / 2;
+		if(cumulative[middle] < target)
+			lowest = middle + 1;
+		else
+			highest = middle;
+	}
+	features.rolloff = power > 0 ? lowest * binWidth : 0;
+
+	float meanPower = power / bins;
+	features.flatness = meanPower > SPECTRAL_MIN_POWER ?
+	                    exp2f(logPower / bins) / meanPower : 1;
+	features.flux = flux;
+}
+
+float SpectralFeatures::zeroCrossings(PCMBlock* block)
+{
+	int noFrames = block->dataLength / block->channels;
+	if(noFrames < 2)
+		return 0;
+
+	// Average the channels.
+	if((int)mixed.size() < noFrames)
+		mixed.resize(noFrames);
+	pcmMixDown(block, &mixed[0]);
+
+	// A crossing is where the sign bits of neighbouring samples
+	// differ.
+	int crossings = 0;
+	int i = 0;
+#ifdef __SSE2__
+	for(; i + 5 <= noFrames; i += 4)
+	{
+		__m128 a = _mm_loadu_ps(&mixed[i]);
+		__m128 b = _mm_loadu_ps(&mixed[i + 1]);
+		int mask = _mm_movemask_ps(_mm_xor_ps(a, b));
+		crossings += (mask & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1) +
+		             ((mask >> 3) & 1);
+	}
+#endif
+	for(; i + 1 < noFrames; i++)
+		crossings += signbit(mixed[i]) != signbit(mixed[i + 1]);
+
+	return (float)crossings / (noFrames - 1);
+}
+
+void* SpectralFeatures::getDSPData()
+{
+	// Ensure we have some data
+	if(!hasData)
+		return NULL;
+
+	// grab the mutex
+	pthread_mutex_lock(PCMDataMutex);
+
+	// set the structure variables
+	*SpectralFeaturesDataStruct = features;
+
+	return (void*)SpectralFeaturesDataStruct;
+}
+
+void SpectralFeatures::relenquishDSPData()
+{
+	pthread_mutex_unlock(PCMDataMutex);
+}
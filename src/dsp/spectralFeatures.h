@@ -0,0 +1,126 @@
+/****************************************
+ *
+ * spectralFeatures.h
+ * Declare a spectral features plugin class.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SPECTRALFEATURES_H_
+#define _SPECTRALFEATURES_H_
+
+#include <pthread.h>
+#include <vector>
+#include "dsp.h"
+#include "fft.h"
+
+// The fraction of the power below the rolloff frequency.
+#define SPECTRAL_ROLLOFF 0.85f
+
+// Bin powers are floored at this before the log is taken.
+#define SPECTRAL_MIN_POWER 1e-12f
+
+typedef struct
+{
+	// The mean frequency weighted by magnitude, and the standard
+	// deviation around it, in Hz.
+	float centroid;
+	float spread;
+
+	// The frequency below which SPECTRAL_ROLLOFF of the power is, in
+	// Hz.
+	float rolloff;
+
+	// The geometric mean of the power over its arithmetic mean, near
+	// 1 for noise and near 0 for a few clear tones.
+	float flatness;
+
+	// The sum of the squared rises in magnitude since the previous
+	// spectrum, where a sine wave of amplitude 1 has a magnitude of 1.
+	float flux;
+
+	// The fraction of neighbouring samples in the latest block that
+	// change sign.
+	float zeroCrossingRate;
+
+	// The time of the spectrum that the features describe.
+	uint64_t time;
+}SpectralFeaturesData;
+
+/**
+ * Work out a set of common descriptors of the spectrum from a FFT
+ * plugin, so that visualisers don't each have their own.
+ *
+ * All of the sums the spectral features need are gathered in one pass
+ * over the spectrum, four bins at a time with SSE. The running total
+ * of the power is stored on the way so the rolloff can be found with a
+ * binary search rather than another pass. The log for the flatness is
+ * a fast approximation, good to about 1e-4.
+ *
+ * The zero crossing rate is worked out from the average of the
+ * channels of each block.
+ *
+ * @note this reads the FFT plugin's results for each block, so it must
+ * be registered with the DSPManager after the FFT plugin.
+ */
+class SpectralFeatures : public DSP
+{
+	public:
+		/**
+		 * Construct the spectral features plugin.
+		 * @param fftPlugin the FFT plugin whose spectrum is used. This
+		 * isn't deleted by the spectral features plugin.
+		 */
+		SpectralFeatures(FFT* fftPlugin);
+		virtual ~SpectralFeatures();
+		void processPCMBlock(PCMBlock* block);
+		void* getDSPData();
+		void relenquishDSPData();
+
+	private:
+		/**
+		 * Work out the spectral features from magnitude.
+		 */
+		void measureSpectrum(int sampleRate);
+
+		/**
+		 * Work out the zero crossing rate of a block.
+		 */
+		float zeroCrossings(PCMBlock* block);
+
+		pthread_mutex_t* PCMDataMutex;
+		FFT* fftPlugin;
+
+		// The magnitude of each bin of the latest and previous
+		// spectra, and the running total of the power of the latest,
+		// only used by the DSP thread.
+		std::vector<float> magnitude;
+		std::vector<float> previous;
+		std::vector<float> cumulative;
+		std::vector<float> mixed;
+
+		// The time of the last spectrum used, so that one isn't
+		// compared with itself if the FFT plugin skipped a block.
+		uint64_t lastTime;
+
+		SpectralFeaturesData features;
+		bool hasData;
+		SpectralFeaturesData* SpectralFeaturesDataStruct;
+};
+
+#endif
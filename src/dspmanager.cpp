@@ -23,15 +23,26 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <algorithm>
 #include "dspmanager.h"
+#include "util/clock.h"
 
 DSPManager::DSPManager()
 {
 	tempBuf = NULL;
+	tempBufCapacity = 0;
+	planeBuf = NULL;
+	planeBufCapacity = 0;
 	cbuf = NULL;
+	latency = new latencyManager();
 	DSPWorkerThreadTerminate = false;
 	PCMSEQ = 0;
 	bufSize = 0;
+	tempBufTime = 0;
+	sampleRate = 0;
+	channels = 1;
+	samplePosition = 0;
+	trackHash = 0;
 	
 	// create the mutexes and the condition variable
 	DSPPluginSetMutex = new pthread_mutex_t;
@@ -81,8 +92,14 @@ DSPManager::~DSPManager()
 	delete PCMSEQMutex;
 	delete PCMDataReadyCond;
 	
+	if(cbuf)
+		delete cbuf;
+	free(tempBuf);
+	free(planeBuf);
+	delete latency;
+
 	// Delete all plugins.
-	for(std::set<DSP*>::iterator i = plugins.begin();
+	for(std::vector<DSP*>::iterator i = plugins.begin();
 	    i != plugins.end(); i++)
 	{
 		delete *i;
@@ -92,39 +109,110 @@ DSPManager::~DSPManager()
 void DSPManager::registerDSPPlugin(DSP* d)
 {
 	pthread_mutex_lock(DSPPluginSetMutex);
-	plugins.insert(d);
+	if(std::find(plugins.begin(), plugins.end(), d) != plugins.end())
+	{
+		pthread_mutex_unlock(DSPPluginSetMutex);
+		return;
+	}
+	plugins.push_back(d);
+	if(trackHash)
+		d->setTrack(trackHash, cacheDir);
 	pthread_mutex_unlock(DSPPluginSetMutex);
 }
 
-void DSPManager::processAudioPCM(void* udata, uint8_t* stream, int len)
+void DSPManager::setTrack(uint64_t trackHash, const std::string& cacheDir)
 {
-	if(tempBuf == NULL)
+	pthread_mutex_lock(DSPPluginSetMutex);
+	this->trackHash = trackHash;
+	this->cacheDir = cacheDir;
+	for(std::vector<DSP*>::iterator i = plugins.begin();
+	    i != plugins.end(); i++)
 	{
-		// we assume that the len won't change for subsequent calls.
-		tempBuf = (uint8_t*)malloc(sizeof(uint8_t) * len);
+		(*i)->setTrack(trackHash, cacheDir);
 	}
-	
+	pthread_mutex_unlock(DSPPluginSetMutex);
+}
+
+latencyManager* DSPManager::getLatencyManager() const
+{
+	return latency;
+}
+
+void DSPManager::setAudioFormat(int sampleRate, int channels)
+{
+	pthread_mutex_lock(tempBufMutex);
+	this->sampleRate = sampleRate;
+	this->channels = channels;
+	samplePosition = 0;
+	pthread_mutex_unlock(tempBufMutex);
+}
+
+void DSPManager::processAudioPCM(void* udata, uint8_t* stream, int len)
+{
 	// increment the SEQ numnber.
 	pthread_mutex_lock(PCMSEQMutex);
 	PCMSEQ++;
+	int seq = PCMSEQ;
 	pthread_mutex_unlock(PCMSEQMutex);
+
+	// Work out when these samples will be heard. Keep track of the
+	// position even if the block is dropped below.
+	uint64_t now = monotonicTimeUs();
+	uint64_t position = samplePosition;
+	samplePosition += (len / sizeof(int16_t)) / channels;
 	
 	// attempt to copy some data.
 	// If the mutex can't be locked then we assume that there is still
 	// some DSP processing happening. Just skip this set of samples.
 	if(pthread_mutex_trylock(tempBufMutex) == 0)
 	{
+		// Grow the buffer if this is the biggest chunk so far.
+		if(len > tempBufCapacity)
+		{
+			tempBuf = (uint8_t*)realloc(tempBuf, sizeof(uint8_t) * len);
+			tempBufCapacity = len;
+		}
 		memcpy(tempBuf, stream, sizeof(uint8_t) * len);
-		pthread_mutex_unlock(tempBufMutex);
-		
+		tempBufTime = now;
+		tempBufBlock.SEQ = seq;
+		tempBufBlock.sampleRate = sampleRate;
+		tempBufBlock.channels = channels;
+		tempBufBlock.samplePosition = position;
+		tempBufBlock.presentationTime = now + latency->getOutputDelayUs();
+
 		// set the size for this chunk of data
 		bufSize = len;
+		pthread_mutex_unlock(tempBufMutex);
 		
 		// also wake up the worker thread
 		pthread_cond_signal(PCMDataReadyCond);
 	}
 }
 
+void DSPManager::runPlugins(PCMBlock* block)
+{
+	// Split the channels out once for all of the plugins.
+	block->noFrames = block->dataLength / block->channels;
+	block->layout = pcmLayoutFor(block->channels);
+	int noPlanes = block->channels < PCM_MAX_CHANNELS ? block->channels :
+	                                                    PCM_MAX_CHANNELS;
+	if(block->noFrames * noPlanes > planeBufCapacity)
+	{
+		planeBufCapacity = block->noFrames * noPlanes;
+		planeBuf = (float*)realloc(planeBuf, sizeof(float) * planeBufCapacity);
+	}
+	for(int c = 0; c < PCM_MAX_CHANNELS; c++)
+		block->planes[c] = c < noPlanes ? planeBuf + (c * block->noFrames) : NULL;
+	pcmDeinterleave(block->data, block->noFrames, block->channels, block->planes);
+
+	for(std::vector<DSP*>::iterator i = plugins.begin();
+	    i != plugins.end(); i++)
+	{
+		DSP* plugin = (DSP*)*i;
+		plugin->processPCMBlock(block);
+	}
+}
+
 // The DSP worker thread entry point
 static void* DSPWorkerThread(void* DSPMan)
 {
@@ -147,22 +235,18 @@ static void* DSPWorkerThread(void* DSPMan)
 		// otherwise, do some processing.
 		pthread_mutex_lock(manager->tempBufMutex);
 		pthread_mutex_lock(manager->DSPPluginSetMutex);
-		pthread_mutex_lock(manager->PCMSEQMutex);
-		
-		// take a local copy of the SEQ number.
-		int seq = manager->PCMSEQ;
-		pthread_mutex_unlock(manager->PCMSEQMutex);
-		
-		for(std::set<DSP*>::iterator i = manager->plugins.begin();
-		    i != manager->plugins.end(); i++)
-		{
-			// Note, we halving the buffer length here as we are sending
-			// a 16 bit int. It is stored as an 8 bit int in the class, therefore,
-			// we should half the length before using it.
-			DSP* plugin = (DSP*)*i;
-			plugin->processPCMData((int16_t*)manager->tempBuf, manager->bufSize / 2, seq);
-		}
+
+		// Note, we halving the buffer length here as we are sending
+		// a 16 bit int. It is stored as an 8 bit int in the class, therefore,
+		// we should half the length before using it.
+		PCMBlock block = manager->tempBufBlock;
+		block.data = (int16_t*)manager->tempBuf;
+		block.dataLength = manager->bufSize / 2;
+		manager->runPlugins(&block);
 		pthread_mutex_unlock(manager->DSPPluginSetMutex);
+
+		// Let the latency manager know how long this block took.
+		manager->latency->reportDSPTime(monotonicTimeUs() - manager->tempBufTime);
 		pthread_mutex_unlock(manager->tempBufMutex);
 	}
 }
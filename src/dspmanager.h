@@ -26,16 +26,15 @@
 
 #include <pthread.h>
 #include <stdint.h>
-#include <set>
+#include <vector>
+#include <string>
 #include "dsp/dsp.h"
 #include "circularBuffer.h"
+#include "latencyManager.h"
 
 // forward declare the DSP worker thread entry point.
 static void* DSPWorkerThread(void* DSPMan);
 
-// also the audio thread entry point.
-void static audioThreadEntryPoint(void* udata, uint8_t* stream, int len);
-
 /**
  * A DSP manager class will receive the RAW PCM
  * data sent to the sound card and distribute it to
@@ -58,7 +57,9 @@ class DSPManager
 		
 		/**
 		 * Register a DSP plugin to use and start sending
-		 * PCM to the plugin for processing.
+		 * PCM to the plugin for processing. Plugins are run in
+		 * the order that they are registered, so a plugin that uses
+		 * the results of another should be registered after it.
 		 * @note once a plugin has been registered it is the
 		 * responsibility of the DSPManager class to delete it.
 		 * @param d the created and initialised plugin to use
@@ -72,11 +73,34 @@ class DSPManager
 		 * @param len the length of the stream parameter.
 		 */
 		void processAudioPCM(void* udata, uint8_t* stream, int len);
+
+		/**
+		 * Set the format of the PCM data that will be passed to
+		 * processAudioPCM. This is used to work out when each block
+		 * of data will be heard.
+		 * @param sampleRate the number of frames per second.
+		 * @param channels the number of interleaved channels.
+		 */
+		void setAudioFormat(int sampleRate, int channels);
+
+		/**
+		 * Tell the plugins that a new track is starting so that they
+		 * can cache their results for it.
+		 * @param trackHash a hash of the track's file.
+		 * @param cacheDir the directory to keep the cached results in.
+		 */
+		void setTrack(uint64_t trackHash, const std::string& cacheDir);
+
+		/**
+		 * return a pointer to the latency manager that decides
+		 * how long the audio is delayed.
+		 * @returns a pointer to this DSP manager's latency manager.
+		 */
+		latencyManager* getLatencyManager() const;
 		
 		// the DSPManager's friends
 		friend class visualiserWin;
 		friend void* DSPWorkerThread(void* DSPMan);
-		friend void audioThreadEntryPoint(void* udata, uint8_t* stream, int len);
 	
 	private:
 		/**
@@ -84,15 +108,45 @@ class DSPManager
 		 * @param arg user defined args from pthread.
 		 */
 		void* DSPThreadEntryPoint(void* arg);
+
+		/**
+		 * Split the block into planes and pass it to each plugin.
+		 * @note the plugin set mutex must be held.
+		 */
+		void runPlugins(PCMBlock* block);
 		
 		// A temporary buffer to hold audio data,
 		// this is done as to release the audio thread ASAP
 		// to reduce buffer under runs with ALSA.
 		uint8_t* tempBuf;
 		int bufSize;
+		int tempBufCapacity;
+
+		// When the data in tempBuf was received, used to
+		// measure the DSP latency.
+		uint64_t tempBufTime;
+
+		// The timing information for the data in tempBuf.
+		PCMBlock tempBufBlock;
+
+		// Where the channels of each block are split out to
+		// for the plugins, guarded by the plugin set mutex.
+		float* planeBuf;
+		int planeBufCapacity;
+
+		// The format of the incoming data and the number of
+		// frames received so far.
+		int sampleRate;
+		int channels;
+		uint64_t samplePosition;
+
+		// The current track, passed on to plugins registered
+		// after it started.
+		uint64_t trackHash;
+		std::string cacheDir;
 		
-		// the set of DSP plugins to process
-		std::set<DSP *> plugins;
+		// the DSP plugins to process, in the order they're run
+		std::vector<DSP *> plugins;
 		
 		// the worker thread
 		pthread_t* DSPWorkerThreadHandle;
@@ -117,9 +171,13 @@ class DSPManager
 		// weather the dsp worker thread should exit
 		bool DSPWorkerThreadTerminate;
 		
-		// A circular buffer object used to delay
+		// A circular buffer of samples used to delay
 		// the playing of the file with the visualiser.
-		circularBuffer::circularBuffer* cbuf;
+		circularBuffer::circularBuffer<int16_t>* cbuf;
+
+		// Measures the DSP and render latency to work out
+		// how long the delay line should be.
+		latencyManager* latency;
 };
 
 #endif
@@ -33,6 +33,8 @@
 class eventHandler
 {
 	public:
+		virtual ~eventHandler() {};
+
 		/**
 		 * This function should return the event type that this
 		 * class should handle.
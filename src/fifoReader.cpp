@@ -0,0 +1,153 @@
+/****************************************
+ *
+ * fifoReader.cpp
+ * Define a reader for raw PCM from a FIFO.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include "fifoReader.h"
+#include "util/clock.h"
+
+fifoReader::fifoReader(const std::string& path, const pcmFormat& format)
+{
+	this->path = path;
+	this->format = format;
+	frameBytes = pcmBytesPerFrame(format);
+	fd = -1;
+	stopped = false;
+	raw.resize(FIFO_READ_SIZE);
+	rawStart = 0;
+	rawEnd = 0;
+}
+
+fifoReader::~fifoReader()
+{
+	close();
+}
+
+bool fifoReader::open()
+{
+	// Open without blocking so that we don't wait here for
+	// a writer, poll() does that instead.
+	fd = ::open(path.c_str(), O_RDONLY | O_NONBLOCK);
+	return fd != -1;
+}
+
+void fifoReader::close()
+{
+	if(fd != -1)
+		::close(fd);
+	fd = -1;
+}
+
+const pcmFormat& fifoReader::getFormat() const
+{
+	return format;
+}
+
+audioSourceMode fifoReader::getMode() const
+{
+	return AUDIO_SOURCE_PUSH;
+}
+
+void fifoReader::stop()
+{
+	__atomic_store_n(&stopped, true, __ATOMIC_RELEASE);
+}
+
+bool fifoReader::isStopped() const
+{
+	return __atomic_load_n(&stopped, __ATOMIC_ACQUIRE);
+}
+
+int fifoReader::read(int16_t* buffer, int noFrames)
+{
+	size_t wanted = (size_t)noFrames * frameBytes;
+	if(raw.size() < wanted + frameBytes)
+		raw.resize(wanted + frameBytes);
+
+	while(rawEnd - rawStart < wanted)
+	{
+		// Make room at the end of the buffer for the next read.
+		if(rawStart > 0 && raw.size() - rawEnd < (size_t)FIFO_READ_SIZE)
+		{
+			memmove(&raw[0], &raw[rawStart], rawEnd - rawStart);
+			rawEnd -= rawStart;
+			rawStart = 0;
+		}
+
+		if(!fill())
+			return 0;
+	}
+
+	pcmToS16(format.sampleFormat, &raw[rawStart], buffer,
+	         (size_t)noFrames * format.channels);
+	rawStart += wanted;
+	if(rawStart == rawEnd)
+		rawStart = rawEnd = 0;
+
+	return noFrames;
+}
+
+bool fifoReader::fill()
+{
+	if(isStopped())
+		return false;
+
+	if(fd == -1)
+	{
+		reopen();
+		return true;
+	}
+
+	struct pollfd pfd;
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	int ret = poll(&pfd, 1, FIFO_POLL_TIMEOUT);
+	if(ret == 0 || (ret < 0 && errno == EINTR))
+		return true;
+
+	ssize_t noRead = ::read(fd, &raw[rawEnd], raw.size() - rawEnd);
+	if(noRead > 0)
+		rawEnd += noRead;
+	else if(noRead == 0 || (errno != EAGAIN && errno != EINTR))
+		// The writer has closed the FIFO.
+		reopen();
+
+	return true;
+}
+
+void fifoReader::reopen()
+{
+	close();
+
+	// The writer may have stopped part way through a frame.
+	rawEnd = rawStart + (((rawEnd - rawStart) / frameBytes) * frameBytes);
+
+	sleepUs(FIFO_REOPEN_DELAY);
+	open();
+}
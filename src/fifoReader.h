@@ -0,0 +1,128 @@
+/****************************************
+ *
+ * fifoReader.h
+ * Declare a reader for raw PCM from a FIFO.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FIFOREADER_H_
+#define _FIFOREADER_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "pcmFormat.h"
+#include "audioSource.h"
+
+// The most that is read from the FIFO at once, the size of a
+// Linux pipe buffer.
+#define FIFO_READ_SIZE 65536
+
+// How long to wait for data before checking if the reader
+// has been stopped, in milliseconds.
+#define FIFO_POLL_TIMEOUT 100
+
+// How long to wait before reopening the FIFO once the writer has
+// closed it, in microseconds.
+#define FIFO_REOPEN_DELAY 250000
+
+/**
+ * Read raw PCM from a FIFO, such as MPD's FIFO output.
+ *
+ * The FIFO is read in large chunks and the data is handed out in
+ * whole frames, converted to signed 16 bit samples. If the writer
+ * goes away, eg MPD is restarted, the FIFO is reopened and reading
+ * carries on when it comes back.
+ */
+class fifoReader : public audioSource
+{
+	public:
+		/**
+		 * Create a reader.
+		 * @param path the path of the FIFO.
+		 * @param format the format of the data written to it.
+		 */
+		fifoReader(const std::string& path, const pcmFormat& format);
+		virtual ~fifoReader();
+
+		/**
+		 * Open the FIFO. This doesn't wait for a writer.
+		 * @returns false if it couldn't be opened.
+		 */
+		bool open();
+
+		/**
+		 * Close the FIFO.
+		 */
+		void close();
+
+		/**
+		 * @returns the format of the data in the FIFO.
+		 */
+		const pcmFormat& getFormat() const;
+
+		/**
+		 * @returns AUDIO_SOURCE_PUSH, MPD plays the audio itself.
+		 */
+		audioSourceMode getMode() const;
+
+		/**
+		 * Read some frames, waiting until they have all arrived.
+		 * @param buffer where to put the samples, it must have space
+		 * for noFrames * channels samples.
+		 * @param noFrames the number of frames wanted.
+		 * @returns noFrames, or 0 if the reader has been stopped.
+		 */
+		int read(int16_t* buffer, int noFrames);
+
+		/**
+		 * Stop the reader, making read() return. This can be called
+		 * from any thread.
+		 */
+		void stop();
+
+	private:
+		/**
+		 * Wait for data and read as much as there is.
+		 * @returns false if the reader has been stopped.
+		 */
+		bool fill();
+
+		/**
+		 * Close and reopen the FIFO once the writer has gone,
+		 * dropping any part of a frame that was left.
+		 */
+		void reopen();
+
+		bool isStopped() const;
+
+		std::string path;
+		pcmFormat format;
+		int frameBytes;
+		int fd;
+		bool stopped;
+
+		// Data read from the FIFO but not handed out yet is
+		// between rawStart and rawEnd.
+		std::vector<uint8_t> raw;
+		size_t rawStart;
+		size_t rawEnd;
+};
+
+#endif
@@ -0,0 +1,189 @@
+/****************************************
+ *
+ * frameScheduler.cpp
+ * Define the frame scheduler.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "frameScheduler.h"
+#include "util/clock.h"
+
+// The gains of the running averages, as shifts.
+#define PERIOD_GAIN 3
+#define JITTER_GAIN 4
+#define DRAW_TIME_GAIN 3
+
+/**
+ * Move a running average towards a sample. The first sample is
+ * taken as it is, and sets measured.
+ */
+static uint64_t average(uint64_t mean, uint64_t sample, int gain,
+                        bool& measured)
+{
+	if(!measured)
+	{
+		measured = true;
+		return sample;
+	}
+
+	int64_t diff = (int64_t)sample - (int64_t)mean;
+	return mean + (diff / (1 << gain));
+}
+
+frameScheduler::frameScheduler(frameScheduleMode mode, int frameRate)
+{
+	measuredPeriod = 0;
+	refreshPeriod = 0;
+	jitter = 0;
+	drawTime = 0;
+	periodMeasured = false;
+	jitterMeasured = false;
+	drawTimeMeasured = false;
+	frameStart = 0;
+	lastSwap = 0;
+	nextFrameStart = 0;
+	droppedFrames = 0;
+	setMode(mode, frameRate);
+}
+
+void frameScheduler::setMode(frameScheduleMode mode, int frameRate)
+{
+	if(mode == FRAME_SCHEDULE_FIXED && frameRate <= 0)
+		mode = FRAME_SCHEDULE_UNCAPPED;
+
+	this->mode = mode;
+	period = mode == FRAME_SCHEDULE_FIXED ? 1000000 / frameRate : 0;
+	refreshPeriod = 0;
+	nextFrameStart = 0;
+}
+
+frameScheduleMode frameScheduler::getMode() const
+{
+	return mode;
+}
+
+uint64_t frameScheduler::beginFrame()
+{
+	frameStart = monotonicTimeUs();
+	if(nextFrameStart == 0)
+		nextFrameStart = frameStart;
+	return frameStart;
+}
+
+void frameScheduler::endDraw()
+{
+	drawTime = average(drawTime, monotonicTimeUs() - frameStart, DRAW_TIME_GAIN,
+	                   drawTimeMeasured);
+}
+
+uint64_t frameScheduler::endFrame()
+{
+	uint64_t now = monotonicTimeUs();
+
+	if(lastSwap != 0)
+	{
+		uint64_t interval = now - lastSwap;
+		measuredPeriod = average(measuredPeriod, interval, PERIOD_GAIN,
+		                         periodMeasured);
+		if(refreshPeriod == 0 || measuredPeriod < refreshPeriod)
+			refreshPeriod = measuredPeriod;
+
+		uint64_t target = mode == FRAME_SCHEDULE_FIXED ? period : measuredPeriod;
+		uint64_t deviation = interval > target ? interval - target : target - interval;
+		jitter = average(jitter, deviation, JITTER_GAIN, jitterMeasured);
+	}
+	lastSwap = now;
+
+	if(mode == FRAME_SCHEDULE_FIXED)
+	{
+		nextFrameStart += period;
+
+		// Drop any frames whose whole slot has already gone. If we are
+		// only a little late the next frame is started straight away.
+		if(now > nextFrameStart + period)
+		{
+			uint64_t missed = (now - nextFrameStart) / period;
+			droppedFrames += missed;
+			nextFrameStart += missed * period;
+		}
+	}
+	else
+		nextFrameStart = now;
+
+	return now;
+}
+
+uint64_t frameScheduler::getNextFrameStart() const
+{
+	return nextFrameStart;
+}
+
+uint64_t frameScheduler::getIdleBudget() const
+{
+	uint64_t now = monotonicTimeUs();
+	uint64_t deadline;
+
+	switch(mode)
+	{
+		case FRAME_SCHEDULE_FIXED:
+			deadline = nextFrameStart;
+			break;
+		case FRAME_SCHEDULE_VSYNC:
+			// Leave enough time to draw before the next sync.
+			deadline = lastSwap + measuredPeriod - drawTime;
+			break;
+		default:
+			return 0;
+	}
+
+	return deadline > now ? deadline - now : 0;
+}
+
+uint64_t frameScheduler::getFramePeriod() const
+{
+	return mode == FRAME_SCHEDULE_FIXED ? period : measuredPeriod;
+}
+
+uint64_t frameScheduler::getTargetPeriod() const
+{
+	switch(mode)
+	{
+		case FRAME_SCHEDULE_FIXED:
+			return period;
+		case FRAME_SCHEDULE_VSYNC:
+			return refreshPeriod;
+		default:
+			return 0;
+	}
+}
+
+uint64_t frameScheduler::getJitter() const
+{
+	return jitter;
+}
+
+uint64_t frameScheduler::getDrawTime() const
+{
+	return drawTime;
+}
+
+uint64_t frameScheduler::getDroppedFrames() const
+{
+	return droppedFrames;
+}
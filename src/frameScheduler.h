@@ -0,0 +1,162 @@
+/****************************************
+ *
+ * frameScheduler.h
+ * Declare the frame scheduler.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FRAMESCHEDULER_H_
+#define _FRAMESCHEDULER_H_
+
+#include <stdint.h>
+
+/**
+ * How frames are paced.
+ */
+typedef enum
+{
+	// Start frames at a fixed rate.
+	FRAME_SCHEDULE_FIXED,
+
+	// Swapping the buffers waits for the vertical sync.
+	FRAME_SCHEDULE_VSYNC,
+
+	// Draw frames as fast as possible.
+	FRAME_SCHEDULE_UNCAPPED
+}frameScheduleMode;
+
+/**
+ * Work out when each frame should be drawn and measure how well
+ * that is kept to.
+ *
+ * Each frame has a deadline, the time that the next one should start.
+ * If a frame is so late that one or more deadlines have been missed
+ * then those frames are dropped, rather than drawing several frames
+ * back to back to catch up.
+ *
+ * All times are in microseconds from monotonicTimeUs().
+ */
+class frameScheduler
+{
+	public:
+		/**
+		 * Create a scheduler.
+		 * @param mode how frames are paced.
+		 * @param frameRate the number of frames per second in
+		 * FRAME_SCHEDULE_FIXED mode.
+		 */
+		frameScheduler(frameScheduleMode mode = FRAME_SCHEDULE_VSYNC,
+		               int frameRate = 0);
+
+		/**
+		 * Change how frames are paced. A fixed rate of 0 frames
+		 * per second is treated as uncapped.
+		 */
+		void setMode(frameScheduleMode mode, int frameRate = 0);
+
+		frameScheduleMode getMode() const;
+
+		/**
+		 * Call when starting to draw a frame.
+		 * @returns the time now.
+		 */
+		uint64_t beginFrame();
+
+		/**
+		 * Call when the frame has been drawn, before the buffers
+		 * are swapped.
+		 */
+		void endDraw();
+
+		/**
+		 * Call once the buffers have been swapped.
+		 * @returns the time now.
+		 */
+		uint64_t endFrame();
+
+		/**
+		 * @returns when the next frame should be started.
+		 */
+		uint64_t getNextFrameStart() const;
+
+		/**
+		 * @returns how much spare time there is before the next frame
+		 * has to be started, in microseconds.
+		 */
+		uint64_t getIdleBudget() const;
+
+		/**
+		 * @returns the time between frames, either the fixed period or
+		 * the measured one.
+		 */
+		uint64_t getFramePeriod() const;
+
+		/**
+		 * @returns the time that each frame has to be drawn in, in
+		 * microseconds. With the vsync this is the shortest period
+		 * measured so far, which is the refresh period, rather than
+		 * the current one which grows when frames miss the vsync.
+		 * 0 if frames aren't paced.
+		 */
+		uint64_t getTargetPeriod() const;
+
+		/**
+		 * @returns the average difference between the time between
+		 * frames and the frame period, in microseconds.
+		 */
+		uint64_t getJitter() const;
+
+		/**
+		 * @returns the average time taken to draw a frame, not
+		 * including swapping the buffers, in microseconds.
+		 */
+		uint64_t getDrawTime() const;
+
+		/**
+		 * @returns the number of frames that have been dropped.
+		 */
+		uint64_t getDroppedFrames() const;
+
+	private:
+		frameScheduleMode mode;
+
+		// The fixed frame period.
+		uint64_t period;
+
+		// Running averages of the time between swaps, how far that is
+		// from the period and how long drawing takes.
+		uint64_t measuredPeriod;
+
+		// The shortest average period measured.
+		uint64_t refreshPeriod;
+		uint64_t jitter;
+		uint64_t drawTime;
+
+		// Whether each average has had a sample yet.
+		bool periodMeasured;
+		bool jitterMeasured;
+		bool drawTimeMeasured;
+
+		uint64_t frameStart;
+		uint64_t lastSwap;
+		uint64_t nextFrameStart;
+		uint64_t droppedFrames;
+};
+
+#endif
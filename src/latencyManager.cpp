@@ -0,0 +1,200 @@
+/****************************************
+ *
+ * latencyManager.cpp
+ * Define an audio/visual latency manager class.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <exception>
+#include "latencyManager.h"
+
+// The weight given to each new measurement.
+#define ESTIMATE_GAIN 0.05
+
+// The default allowed drift before the delay is changed.
+#define DEFAULT_TOLERANCE_MS 10
+
+latencyManager::latencyManager()
+{
+	delayMutex = new pthread_mutex_t;
+	if(pthread_mutex_init(delayMutex, NULL) != 0)
+		throw(std::exception());
+
+	sampleRate = 0;
+	channels = 0;
+	bufferFrames = 0;
+	maxDelaySamples = 0;
+	manualDelayMs = -1;
+	toleranceMs = DEFAULT_TOLERANCE_MS;
+	dspMean = 0;
+	dspDeviation = 0;
+	dspMeasured = false;
+	renderMean = 0;
+	renderDeviation = 0;
+	renderMeasured = false;
+	framePeriodMean = 0;
+	framePeriodDeviation = 0;
+	framePeriodMeasured = false;
+	delaySamples = 0;
+}
+
+latencyManager::~latencyManager()
+{
+	pthread_mutex_destroy(delayMutex);
+	delete delayMutex;
+}
+
+void latencyManager::setAudioFormat(int sampleRate, int channels,
+                                    int bufferFrames, int maxDelaySamples)
+{
+	pthread_mutex_lock(delayMutex);
+	this->sampleRate = sampleRate;
+	this->channels = channels;
+	this->bufferFrames = bufferFrames;
+	this->maxDelaySamples = maxDelaySamples;
+	recalculateDelay();
+	pthread_mutex_unlock(delayMutex);
+}
+
+void latencyManager::setManualDelay(int ms)
+{
+	pthread_mutex_lock(delayMutex);
+	manualDelayMs = ms;
+	recalculateDelay();
+	pthread_mutex_unlock(delayMutex);
+}
+
+void latencyManager::setTolerance(int ms)
+{
+	pthread_mutex_lock(delayMutex);
+	toleranceMs = ms;
+	pthread_mutex_unlock(delayMutex);
+}
+
+void latencyManager::updateEstimate(double& mean, double& deviation,
+                                    bool& measured, double sample)
+{
+	// Start from the first measurement rather than slowly
+	// climbing up from zero.
+	if(!measured)
+	{
+		mean = sample;
+		deviation = sample / 2;
+		measured = true;
+		return;
+	}
+
+	double error = sample - mean;
+	mean += ESTIMATE_GAIN * error;
+	deviation += ESTIMATE_GAIN * (fabs(error) - deviation);
+}
+
+void latencyManager::reportDSPTime(uint64_t us)
+{
+	pthread_mutex_lock(delayMutex);
+	updateEstimate(dspMean, dspDeviation, dspMeasured, (double)us);
+	recalculateDelay();
+	pthread_mutex_unlock(delayMutex);
+}
+
+void latencyManager::reportRenderTime(uint64_t us, uint64_t framePeriod)
+{
+	pthread_mutex_lock(delayMutex);
+	updateEstimate(renderMean, renderDeviation, renderMeasured, (double)us);
+	updateEstimate(framePeriodMean, framePeriodDeviation, framePeriodMeasured,
+	               (double)framePeriod);
+	recalculateDelay();
+	pthread_mutex_unlock(delayMutex);
+}
+
+void latencyManager::recalculateDelay()
+{
+	if(sampleRate == 0)
+		return;
+
+	double wantedUs;
+	if(manualDelayMs >= 0)
+		wantedUs = manualDelayMs * 1000.0;
+	else
+	{
+		// A block of audio has to get through the DSP plugins, then
+		// wait on average half a frame for the window to pick it up
+		// before being drawn and shown. Allow for the jitter in each
+		// stage so the audio is rarely early.
+		wantedUs = dspMean + (2 * dspDeviation) +
+		           renderMean + (2 * renderDeviation) +
+		           (framePeriodMean / 2);
+
+		// The sound card buffer delays the audio already.
+		wantedUs -= (bufferFrames * 1000000.0) / sampleRate;
+
+		// Only move the delay if we have drifted too far.
+		double currentUs = (delaySamples / channels) * 1000000.0 / sampleRate;
+		if(fabs(wantedUs - currentUs) < toleranceMs * 1000.0)
+			return;
+	}
+
+	if(wantedUs < 0)
+		wantedUs = 0;
+
+	int frames = (int)((wantedUs * sampleRate) / 1000000.0);
+	int maxFrames = maxDelaySamples / channels;
+	if(frames > maxFrames)
+		frames = maxFrames;
+
+	// The audio thread reads this without taking the mutex.
+	__atomic_store_n(&delaySamples, frames * channels, __ATOMIC_RELEASE);
+}
+
+int latencyManager::getDelaySamples()
+{
+	return __atomic_load_n(&delaySamples, __ATOMIC_ACQUIRE);
+}
+
+uint64_t latencyManager::getDelayUs()
+{
+	pthread_mutex_lock(delayMutex);
+	uint64_t delay = 0;
+	if(sampleRate != 0)
+		delay = ((uint64_t)(delaySamples / channels) * 1000000) / sampleRate;
+	pthread_mutex_unlock(delayMutex);
+	return delay;
+}
+
+uint64_t latencyManager::getOutputDelayUs()
+{
+	pthread_mutex_lock(delayMutex);
+	uint64_t delay = 0;
+	if(sampleRate != 0)
+	{
+		int frames = (delaySamples / channels) + bufferFrames;
+		delay = ((uint64_t)frames * 1000000) / sampleRate;
+	}
+	pthread_mutex_unlock(delayMutex);
+	return delay;
+}
+
+uint64_t latencyManager::getRenderLatencyUs()
+{
+	pthread_mutex_lock(delayMutex);
+	uint64_t latency = (uint64_t)renderMean;
+	pthread_mutex_unlock(delayMutex);
+	return latency;
+}
@@ -0,0 +1,168 @@
+/****************************************
+ *
+ * latencyManager.h
+ * Declare an audio/visual latency manager class.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LATENCYMANAGER_H_
+#define _LATENCYMANAGER_H_
+
+#include <pthread.h>
+#include <stdint.h>
+
+/**
+ * The latency manager works out how long the audio should be
+ * held back so that it is heard at the same time as the visuals
+ * that were drawn from it are shown.
+ *
+ * The DSP worker thread reports how long each block took to get
+ * through the DSP plugins and the window reports how long each
+ * frame took from starting to draw until it was swapped onto the
+ * screen. From these a delay, in samples, is calculated that the
+ * audio thread applies to its delay line.
+ */
+class latencyManager
+{
+	public:
+		/**
+		 * Create a latency manager with automatic delay
+		 * calculation.
+		 */
+		latencyManager();
+
+		/**
+		 * Destroy the latency manager.
+		 */
+		virtual ~latencyManager();
+
+		/**
+		 * Set the format of the audio that is being delayed.
+		 * @param sampleRate the number of frames per second.
+		 * @param channels the number of interleaved channels.
+		 * @param bufferFrames the number of frames in the sound card
+		 * buffer, the audio is already delayed by this much.
+		 * @param maxDelaySamples the largest delay that the delay line
+		 * can hold.
+		 */
+		void setAudioFormat(int sampleRate, int channels,
+		                    int bufferFrames, int maxDelaySamples);
+
+		/**
+		 * Fix the audio delay rather than measuring it.
+		 * @param ms the delay in milliseconds. A negative value
+		 * goes back to automatic calculation.
+		 */
+		void setManualDelay(int ms);
+
+		/**
+		 * Set how far the delay is allowed to drift from the measured
+		 * latency before the delay line is adjusted. Adjusting the
+		 * delay line is audible so this stops it happening on every
+		 * small change.
+		 * @param ms the tolerance in milliseconds.
+		 */
+		void setTolerance(int ms);
+
+		/**
+		 * Report the time taken for a block of PCM data to pass
+		 * through the DSP plugins.
+		 * @param us the time in microseconds.
+		 */
+		void reportDSPTime(uint64_t us);
+
+		/**
+		 * Report the time taken from starting to draw a frame
+		 * until the frame was swapped onto the screen.
+		 * @param us the time in microseconds.
+		 * @param framePeriod the time since the previous frame was
+		 * swapped, in microseconds.
+		 */
+		void reportRenderTime(uint64_t us, uint64_t framePeriod);
+
+		/**
+		 * Get the delay that the audio should currently have.
+		 * This doesn't block so it is safe to call from the
+		 * audio thread.
+		 * @returns the delay in samples. This is always a whole
+		 * number of frames.
+		 */
+		int getDelaySamples();
+
+		/**
+		 * Get the delay that the audio should currently have.
+		 * @returns the delay in microseconds.
+		 */
+		uint64_t getDelayUs();
+
+		/**
+		 * Get the time that samples given to the sound card now will
+		 * take to be heard, that is the delay line plus the sound card
+		 * buffer.
+		 * @returns the time in microseconds.
+		 */
+		uint64_t getOutputDelayUs();
+
+		/**
+		 * Get the estimated time from starting to draw a frame
+		 * to it being shown on the screen.
+		 * @returns the time in microseconds.
+		 */
+		uint64_t getRenderLatencyUs();
+
+	private:
+		/**
+		 * Update a running mean and mean deviation with a new
+		 * measurement, in the same manner as TCP's RTT estimator.
+		 * @param measured whether there has been a measurement yet,
+		 * set once there has.
+		 */
+		static void updateEstimate(double& mean, double& deviation,
+		                           bool& measured, double sample);
+
+		/**
+		 * Recalculate the delay from the current estimates.
+		 * @note delayMutex must be held.
+		 */
+		void recalculateDelay();
+
+		pthread_mutex_t* delayMutex;
+
+		int sampleRate;
+		int channels;
+		int bufferFrames;
+		int maxDelaySamples;
+		int manualDelayMs;
+		int toleranceMs;
+
+		double dspMean;
+		double dspDeviation;
+		bool dspMeasured;
+		double renderMean;
+		double renderDeviation;
+		bool renderMeasured;
+		double framePeriodMean;
+		double framePeriodDeviation;
+		bool framePeriodMeasured;
+
+		// The delay that is currently applied.
+		int delaySamples;
+};
+
+#endif
@@ -0,0 +1,169 @@
+/****************************************
+ *
+ * pcmFormat.cpp
+ * Define raw PCM sample formats and their conversion.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "pcmFormat.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Scales a signed 16 bit sample to a float from -1 to 1.
+#define S16_SCALE (1.0f / 32768.0f)
+
+bool parsePCMFormat(const std::string& spec, pcmFormat* format)
+{
+	size_t first = spec.find(':');
+	size_t second = spec.find(':', first + 1);
+	if(first == std::string::npos || second == std::string::npos)
+		return false;
+
+	std::string rate = spec.substr(0, first);
+	std::string bits = spec.substr(first + 1, second - first - 1);
+	std::string channels = spec.substr(second + 1);
+
+	char* end;
+	format->sampleRate = strtol(rate.c_str(), &end, 10);
+	if(rate.empty() || *end != '\0' || format->sampleRate <= 0)
+		return false;
+
+	if(bits == "16")
+		format->sampleFormat = PCM_S16;
+	else if(bits == "24")
+		format->sampleFormat = PCM_S24_P32;
+	else if(bits == "32")
+		format->sampleFormat = PCM_S32;
+	else if(bits == "f")
+		format->sampleFormat = PCM_FLOAT;
+	else
+		return false;
+
+	format->channels = strtol(channels.c_str(), &end, 10);
+	if(channels.empty() || *end != '\0' ||
+	   format->channels < 1 || format->channels > 2)
+		return false;
+
+	return true;
+}
+
+int pcmBytesPerSample(pcmSampleFormat sampleFormat)
+{
+	return sampleFormat == PCM_S16 ? 2 : 4;
+}
+
+int pcmBytesPerFrame(const pcmFormat& format)
+{
+	return pcmBytesPerSample(format.sampleFormat) * format.channels;
+}
+
+void pcmToS16(pcmSampleFormat sampleFormat, const void* in,
+              int16_t* out, size_t noSamples)
+{
+	switch(sampleFormat)
+	{
+		case PCM_S16:
+			memcpy(out, in, noSamples * sizeof(int16_t));
+			break;
+		case PCM_S24_P32:
+		{
+			const int32_t* s = (const int32_t*)in;
+			for(size_t i = 0; i < noSamples; i++)
+				out[i] = (int16_t)(s[i] >> 8);
+			break;
+		}
+		case PCM_S32:
+		{
+			const int32_t* s = (const int32_t*)in;
+			for(size_t i = 0; i < noSamples; i++)
+				out[i] = (int16_t)(s[i] >> 16);
+			break;
+		}
+		case PCM_FLOAT:
+		{
+			const float* s = (const float*)in;
+			for(size_t i = 0; i < noSamples; i++)
+			{
+				float v = s[i] * 32767.0f;
+				if(v > 32767.0f)
+					v = 32767.0f;
+				else if(v < -32768.0f)
+					v = -32768.0f;
+				out[i] = (int16_t)v;
+			}
+			break;
+		}
+	}
+}
+
+pcmChannelLayout pcmLayoutFor(int channels)
+{
+	switch(channels)
+	{
+		case 1:
+			return PCM_LAYOUT_MONO;
+		case 2:
+			return PCM_LAYOUT_STEREO;
+		default:
+			return PCM_LAYOUT_UNKNOWN;
+	}
+}
+
+void pcmDeinterleave(const int16_t* in, int noFrames, int channels,
+                     float* const* planes)
+{
+	int i = 0;
+
+#ifdef __SSE2__
+	__m128 scale = _mm_set1_ps(S16_SCALE);
+	if(channels == 1)
+	{
+		// Sign extend eight samples to two vectors of 32 bit ints.
+		for(; i + 8 <= noFrames; i += 8)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*)(in + i));
+			__m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+			__m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+			_mm_storeu_ps(planes[0] + i, _mm_mul_ps(_mm_cvtepi32_ps(low), scale));
+			_mm_storeu_ps(planes[0] + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), scale));
+		}
+	}
+	else if(channels == 2)
+	{
+		// Each 32 bit lane holds a left sample in the bottom half
+		// and a right sample in the top half.
+		for(; i + 4 <= noFrames; i += 4)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*)(in + (i * 2)));
+			__m128i left = _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+			__m128i right = _mm_srai_epi32(v, 16);
+			_mm_storeu_ps(planes[0] + i, _mm_mul_ps(_mm_cvtepi32_ps(left), scale));
+			_mm_storeu_ps(planes[1] + i, _mm_mul_ps(_mm_cvtepi32_ps(right), scale));
+		}
+	}
+#endif
+
+	int noPlanes = channels < PCM_MAX_CHANNELS ? channels : PCM_MAX_CHANNELS;
+	for(; i < noFrames; i++)
+		for(int c = 0; c < noPlanes; c++)
+			planes[c][i] = in[(i * channels) + c] * S16_SCALE;
+}
@@ -0,0 +1,124 @@
+/****************************************
+ *
+ * pcmFormat.h
+ * Declare raw PCM sample formats and their conversion.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PCMFORMAT_H_
+#define _PCMFORMAT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+/**
+ * The sample formats that raw PCM can be read in. These are the ones
+ * that MPD's FIFO output can write.
+ */
+typedef enum
+{
+	// Signed 16 bit.
+	PCM_S16,
+
+	// Signed 24 bit in the low bytes of a 32 bit word.
+	PCM_S24_P32,
+
+	// Signed 32 bit.
+	PCM_S32,
+
+	// 32 bit float between -1 and 1.
+	PCM_FLOAT
+}pcmSampleFormat;
+
+// The most channels that are split out for the DSP plugins.
+#define PCM_MAX_CHANNELS 8
+
+/**
+ * What the channels of the PCM are.
+ */
+typedef enum
+{
+	// A single channel.
+	PCM_LAYOUT_MONO,
+
+	// Left then right.
+	PCM_LAYOUT_STEREO,
+
+	// Any other number of channels, in an unknown order.
+	PCM_LAYOUT_UNKNOWN
+}pcmChannelLayout;
+
+/**
+ * The format of raw interleaved PCM in native byte order.
+ */
+typedef struct
+{
+	int sampleRate;
+	pcmSampleFormat sampleFormat;
+	int channels;
+}pcmFormat;
+
+/**
+ * Parse a format in MPD's notation, RATE:BITS:CHANNELS, where BITS is
+ * 16, 24, 32 or f for float, eg 44100:16:2.
+ * @param spec the format string.
+ * @param format where to put the format.
+ * @returns false if the format isn't valid.
+ */
+bool parsePCMFormat(const std::string& spec, pcmFormat* format);
+
+/**
+ * @returns the number of bytes that each sample takes up.
+ */
+int pcmBytesPerSample(pcmSampleFormat sampleFormat);
+
+/**
+ * @returns the number of bytes that each frame takes up.
+ */
+int pcmBytesPerFrame(const pcmFormat& format);
+
+/**
+ * Convert samples to the signed 16 bit samples that the DSP plugins use.
+ * @param sampleFormat the format of the source samples.
+ * @param in the source samples.
+ * @param out where to put the converted samples.
+ * @param noSamples the number of samples, not frames, to convert.
+ */
+void pcmToS16(pcmSampleFormat sampleFormat, const void* in,
+              int16_t* out, size_t noSamples);
+
+/**
+ * @returns the layout that a number of channels is taken to have.
+ */
+pcmChannelLayout pcmLayoutFor(int channels);
+
+/**
+ * Split interleaved signed 16 bit samples into a plane of floats
+ * from -1 to 1 for each channel.
+ * @param in the interleaved samples.
+ * @param noFrames the number of frames in in.
+ * @param channels the number of channels in in.
+ * @param planes where to put each channel, at least noFrames floats
+ * each. Only the first PCM_MAX_CHANNELS channels are split out.
+ */
+void pcmDeinterleave(const int16_t* in, int noFrames, int channels,
+                     float* const* planes);
+
+#endif
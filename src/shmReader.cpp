@@ -0,0 +1,185 @@
+/****************************************
+ *
+ * shmReader.cpp
+ * Define a reader for PCM published in shared memory.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include "shmReader.h"
+#include "util/clock.h"
+
+shmReader::shmReader(const std::string& name)
+{
+	this->name = name;
+	map = NULL;
+	mapLength = 0;
+	header = NULL;
+	ring = NULL;
+	frameBytes = 0;
+	readIndex = 0;
+	stopped = false;
+}
+
+shmReader::~shmReader()
+{
+	close();
+}
+
+bool shmReader::open()
+{
+	close();
+
+	int fd = shm_open(name.c_str(), O_RDONLY, 0);
+	if(fd == -1)
+		return false;
+
+	struct stat st;
+	if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(shmPCMHeader))
+	{
+		::close(fd);
+		return false;
+	}
+
+	// The mapping stays valid once the descriptor is closed.
+	mapLength = st.st_size;
+	map = mmap(NULL, mapLength, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if(map == MAP_FAILED)
+	{
+		map = NULL;
+		return false;
+	}
+
+	header = (shmPCMHeader*)map;
+	if(memcmp(header->magic, SHM_PCM_MAGIC, sizeof(header->magic)) != 0 ||
+	   header->version != SHM_PCM_VERSION ||
+	   header->headerSize < sizeof(shmPCMHeader) ||
+	   header->sampleFormat > PCM_FLOAT ||
+	   header->channels < 1 || header->channels > 2 ||
+	   header->sampleRate == 0 || header->capacityFrames == 0)
+	{
+		close();
+		return false;
+	}
+
+	format.sampleRate = header->sampleRate;
+	format.sampleFormat = (pcmSampleFormat)header->sampleFormat;
+	format.channels = header->channels;
+	frameBytes = pcmBytesPerFrame(format);
+
+	if(mapLength < header->headerSize +
+	               ((size_t)header->capacityFrames * frameBytes))
+	{
+		close();
+		return false;
+	}
+
+	ring = (uint8_t*)map + header->headerSize;
+	readIndex = __atomic_load_n(&header->writeIndex, __ATOMIC_ACQUIRE);
+	return true;
+}
+
+void shmReader::close()
+{
+	if(map)
+		munmap(map, mapLength);
+	map = NULL;
+	header = NULL;
+	ring = NULL;
+}
+
+const pcmFormat& shmReader::getFormat() const
+{
+	return format;
+}
+
+audioSourceMode shmReader::getMode() const
+{
+	return AUDIO_SOURCE_PUSH;
+}
+
+void shmReader::stop()
+{
+	__atomic_store_n(&stopped, true, __ATOMIC_RELEASE);
+}
+
+bool shmReader::isStopped() const
+{
+	return __atomic_load_n(&stopped, __ATOMIC_ACQUIRE);
+}
+
+int shmReader::read(int16_t* buffer, int noFrames)
+{
+	if(!header || (uint32_t)noFrames > header->capacityFrames)
+		return 0;
+
+	while(true)
+	{
+		if(isStopped())
+			return 0;
+
+		uint64_t writeIndex = __atomic_load_n(&header->writeIndex, __ATOMIC_ACQUIRE);
+
+		// The engine has started again from the beginning, or we've
+		// fallen so far behind that the frames are being overwritten.
+		if(writeIndex < readIndex ||
+		   writeIndex - readIndex > header->capacityFrames - noFrames)
+			readIndex = writeIndex >= (uint64_t)noFrames ? writeIndex - noFrames : 0;
+
+		uint64_t available = writeIndex - readIndex;
+		if(available >= (uint64_t)noFrames)
+		{
+			copyFrames(buffer, readIndex, noFrames);
+
+			// Make sure the engine didn't wrap around onto the
+			// frames while they were being copied, allowing for a
+			// block that it is part way through writing.
+			uint64_t after = __atomic_load_n(&header->writeIndex, __ATOMIC_ACQUIRE);
+			if(after - readIndex > header->capacityFrames - noFrames)
+				continue;
+
+			readIndex += noFrames;
+			return noFrames;
+		}
+
+		// Wait for about as long as the missing frames take to play.
+		sleepUs(((noFrames - available) * 1000000) / format.sampleRate);
+	}
+}
+
+void shmReader::copyFrames(int16_t* buffer, uint64_t index, int noFrames)
+{
+	uint32_t capacity = header->capacityFrames;
+	uint32_t start = index % capacity;
+	uint32_t first = capacity - start;
+	if(first > (uint32_t)noFrames)
+		first = noFrames;
+
+	pcmToS16(format.sampleFormat, ring + ((size_t)start * frameBytes), buffer,
+	         (size_t)first * format.channels);
+	if(first < (uint32_t)noFrames)
+		pcmToS16(format.sampleFormat, ring, buffer + (first * format.channels),
+		         (size_t)(noFrames - first) * format.channels);
+}
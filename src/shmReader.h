@@ -0,0 +1,144 @@
+/****************************************
+ *
+ * shmReader.h
+ * Declare a reader for PCM published in shared memory.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SHMREADER_H_
+#define _SHMREADER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include "pcmFormat.h"
+#include "audioSource.h"
+
+#define SHM_PCM_MAGIC "MTLZSHM1"
+#define SHM_PCM_VERSION 1
+
+/**
+ * The header at the start of a shared memory PCM ring.
+ *
+ * An audio engine publishes PCM by creating a POSIX shared memory
+ * object with shm_open(), writing this header at the start and
+ * following it with a ring of capacityFrames frames that starts
+ * headerSize bytes in. The frames are interleaved and in the native
+ * byte order.
+ *
+ * writeIndex is the total number of frames ever written. Frame n is
+ * kept at ring offset (n % capacityFrames) * bytes per frame. To
+ * publish frames the engine writes them into the ring and then stores
+ * the new writeIndex with release semantics, eg
+ * __atomic_store_n(&header->writeIndex, index, __ATOMIC_RELEASE).
+ * Readers never write to the object, so any number can attach.
+ *
+ * The engine should make the ring at least a second long. A reader
+ * that falls more than capacityFrames behind skips ahead to the newest
+ * frames.
+ */
+typedef struct
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t headerSize;
+	uint32_t sampleRate;
+
+	// A pcmSampleFormat.
+	uint32_t sampleFormat;
+	uint32_t channels;
+	uint32_t capacityFrames;
+	uint64_t writeIndex;
+	uint8_t reserved[24];
+}shmPCMHeader;
+
+/**
+ * Read PCM from a shared memory ring that an audio engine on the same
+ * machine writes to. The samples are read straight out of the shared
+ * memory so, unless the reader has to wait, no system calls are made.
+ */
+class shmReader : public audioSource
+{
+	public:
+		/**
+		 * Create a reader.
+		 * @param name the name of the shared memory object, as
+		 * passed to shm_open(), eg /mattuliser.
+		 */
+		shmReader(const std::string& name);
+		virtual ~shmReader();
+
+		/**
+		 * Attach to the shared memory and check its header.
+		 * Reading starts from the newest frames.
+		 * @returns false if it couldn't be attached to.
+		 */
+		bool open();
+
+		/**
+		 * Detach from the shared memory.
+		 */
+		void close();
+
+		/**
+		 * @returns the format given in the header.
+		 */
+		const pcmFormat& getFormat() const;
+
+		/**
+		 * @returns AUDIO_SOURCE_PUSH, the engine plays the audio itself.
+		 */
+		audioSourceMode getMode() const;
+
+		/**
+		 * Read some frames, waiting until they have all been written.
+		 * @param buffer where to put the samples, it must have space
+		 * for noFrames * channels samples.
+		 * @param noFrames the number of frames wanted, this must not
+		 * be more than the capacity of the ring.
+		 * @returns noFrames, or 0 if the reader has been stopped.
+		 */
+		int read(int16_t* buffer, int noFrames);
+
+		/**
+		 * Stop the reader, making read() return. This can be called
+		 * from any thread.
+		 */
+		void stop();
+
+	private:
+		/**
+		 * Convert frames from the ring into the buffer.
+		 */
+		void copyFrames(int16_t* buffer, uint64_t index, int noFrames);
+
+		bool isStopped() const;
+
+		std::string name;
+		void* map;
+		size_t mapLength;
+		shmPCMHeader* header;
+		uint8_t* ring;
+		pcmFormat format;
+		int frameBytes;
+		uint64_t readIndex;
+		bool stopped;
+};
+
+#endif
@@ -0,0 +1,92 @@
+/****************************************
+ *
+ * sourceFeeder.cpp
+ * Define a thread that feeds a source to the DSP plugins.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "sourceFeeder.h"
+#include "audioSource.h"
+#include "dspmanager.h"
+
+sourceFeeder::sourceFeeder(audioSource* source, DSPManager* dspman,
+                           int blockFrames)
+{
+	this->source = source;
+	this->dspman = dspman;
+	this->blockFrames = blockFrames;
+	framesFed = 0;
+	thread = NULL;
+}
+
+sourceFeeder::~sourceFeeder()
+{
+	stop();
+}
+
+void sourceFeeder::start()
+{
+	if(thread)
+		return;
+
+	dspman->setAudioFormat(source->getFormat().sampleRate,
+	                       source->getFormat().channels);
+	thread = new pthread_t;
+	pthread_create(thread, NULL, threadEntry, this);
+}
+
+void sourceFeeder::wait()
+{
+	if(!thread)
+		return;
+
+	pthread_join(*thread, NULL);
+	delete thread;
+	thread = NULL;
+}
+
+void sourceFeeder::stop()
+{
+	source->stop();
+	wait();
+}
+
+uint64_t sourceFeeder::getFramesFed() const
+{
+	return __atomic_load_n(&framesFed, __ATOMIC_ACQUIRE);
+}
+
+void* sourceFeeder::threadEntry(void* arg)
+{
+	sourceFeeder* feeder = static_cast<sourceFeeder*>(arg);
+	int channels = feeder->source->getFormat().channels;
+	std::vector<int16_t> block(feeder->blockFrames * channels);
+	int len = block.size() * sizeof(int16_t);
+
+	// Only whole blocks are passed on so the plugins always get
+	// the same amount of data.
+	while(feeder->source->read(&block[0], feeder->blockFrames) == feeder->blockFrames)
+	{
+		feeder->dspman->processAudioPCM(NULL, (uint8_t*)&block[0], len);
+
+		__atomic_add_fetch(&feeder->framesFed, feeder->blockFrames, __ATOMIC_RELEASE);
+	}
+
+	return NULL;
+}
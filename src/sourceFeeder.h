@@ -0,0 +1,90 @@
+/****************************************
+ *
+ * sourceFeeder.h
+ * Declare a thread that feeds a source to the DSP plugins.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SOURCEFEEDER_H_
+#define _SOURCEFEEDER_H_
+
+#include <pthread.h>
+#include <stdint.h>
+#include <vector>
+
+class audioSource;
+class DSPManager;
+
+/**
+ * Read blocks from an audio source on a thread of its own and pass
+ * them to a DSP manager.
+ *
+ * This is how sources that aren't played through the sound card are
+ * visualised.
+ */
+class sourceFeeder
+{
+	public:
+		/**
+		 * Create a feeder, the thread isn't started until start() is
+		 * called.
+		 * @param source an opened source.
+		 * @param dspman the DSP manager to pass the data to. Its audio
+		 * format is set to the source's.
+		 * @param blockFrames the number of frames in each block.
+		 */
+		sourceFeeder(audioSource* source, DSPManager* dspman,
+		             int blockFrames);
+
+		/**
+		 * Stop the source and wait for the thread to finish.
+		 */
+		virtual ~sourceFeeder();
+
+		/**
+		 * Start reading the source.
+		 */
+		void start();
+
+		/**
+		 * Wait until the whole source has been read.
+		 */
+		void wait();
+
+		/**
+		 * Stop reading and wait for the thread to finish.
+		 */
+		void stop();
+
+		/**
+		 * @returns the number of frames passed on so far.
+		 */
+		uint64_t getFramesFed() const;
+
+	private:
+		static void* threadEntry(void* arg);
+
+		audioSource* source;
+		DSPManager* dspman;
+		int blockFrames;
+		uint64_t framesFed;
+		pthread_t* thread;
+};
+
+#endif
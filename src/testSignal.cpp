@@ -0,0 +1,119 @@
+/****************************************
+ *
+ * testSignal.cpp
+ * Define a generator of test audio.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include "testSignal.h"
+
+testSignal::testSignal(int sampleRate, int channels, uint64_t length)
+{
+	format.sampleRate = sampleRate;
+	format.sampleFormat = PCM_S16;
+	format.channels = channels;
+	this->length = length;
+	position = 0;
+	phase = 0;
+	frequency = TEST_SIGNAL_MIN_FREQ;
+	stopped = false;
+}
+
+testSignal::~testSignal()
+{
+}
+
+bool testSignal::open()
+{
+	position = 0;
+	phase = 0;
+	frequency = TEST_SIGNAL_MIN_FREQ;
+	return format.sampleRate > 0 && format.channels > 0;
+}
+
+void testSignal::close()
+{
+}
+
+audioSourceMode testSignal::getMode() const
+{
+	return AUDIO_SOURCE_PULL;
+}
+
+const pcmFormat& testSignal::getFormat() const
+{
+	return format;
+}
+
+bool testSignal::setOutputFormat(int sampleRate, int channels)
+{
+	if(sampleRate <= 0 || channels < 1)
+		return false;
+
+	format.sampleRate = sampleRate;
+	format.channels = channels;
+	return true;
+}
+
+void testSignal::stop()
+{
+	__atomic_store_n(&stopped, true, __ATOMIC_RELEASE);
+}
+
+int testSignal::read(int16_t* buffer, int noFrames)
+{
+	if(__atomic_load_n(&stopped, __ATOMIC_ACQUIRE))
+		return 0;
+
+	if(length && position + noFrames > length)
+		noFrames = length - position;
+
+	double rate = format.sampleRate;
+	uint64_t sweepFrames = (uint64_t)format.sampleRate * TEST_SIGNAL_SWEEP_LENGTH;
+	double beatFrames = (rate * 60) / TEST_SIGNAL_BPM;
+
+	// The frequency rises exponentially through the sweep, so it is
+	// multiplied by the same amount each frame.
+	double step = pow((double)TEST_SIGNAL_MAX_FREQ / TEST_SIGNAL_MIN_FREQ,
+	                  1.0 / sweepFrames);
+
+	for(int i = 0; i < noFrames; i++, position++)
+	{
+		if(position % sweepFrames == 0)
+			frequency = TEST_SIGNAL_MIN_FREQ;
+		else
+			frequency *= step;
+		phase += (2 * M_PI * frequency) / rate;
+		if(phase > 2 * M_PI)
+			phase -= 2 * M_PI;
+		double value = 0.25 * sin(phase);
+
+		// A short decaying burst at the start of each beat.
+		double beat = fmod((double)position, beatFrames);
+		if(beat < rate / 50)
+			value += 0.5 * exp(-beat / (rate / 200)) * sin(2 * M_PI * 60 * beat / rate);
+
+		int16_t sample = (int16_t)(value * 32767);
+		for(int c = 0; c < format.channels; c++)
+			buffer[(i * format.channels) + c] = sample;
+	}
+
+	return noFrames;
+}
@@ -0,0 +1,86 @@
+/****************************************
+ *
+ * testSignal.h
+ * Declare a generator of test audio.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _TESTSIGNAL_H_
+#define _TESTSIGNAL_H_
+
+#include "audioSource.h"
+
+// The length of each sweep in seconds.
+#define TEST_SIGNAL_SWEEP_LENGTH 10
+
+// The lowest and highest frequency of the sweep in Hz.
+#define TEST_SIGNAL_MIN_FREQ 20
+#define TEST_SIGNAL_MAX_FREQ 20000
+
+// The tempo of the clicks in beats per minute.
+#define TEST_SIGNAL_BPM 120
+
+/**
+ * Generate a test signal: a repeating logarithmic sine sweep with a
+ * click on every beat. It needs no files or devices and can be read
+ * as fast as it is wanted, so it is useful for benchmarking.
+ */
+class testSignal : public audioSource
+{
+	public:
+		/**
+		 * Create a test signal.
+		 * @param sampleRate the number of frames per second.
+		 * @param channels the number of channels, each one is the same.
+		 * @param length the number of frames to generate, 0 to go on
+		 * forever.
+		 */
+		testSignal(int sampleRate = 44100, int channels = 2,
+		           uint64_t length = 0);
+		virtual ~testSignal();
+
+		bool open();
+		void close();
+
+		/**
+		 * @returns AUDIO_SOURCE_PULL, the signal is played through
+		 * the sound card.
+		 */
+		audioSourceMode getMode() const;
+
+		const pcmFormat& getFormat() const;
+
+		/**
+		 * Generate the signal at a different rate or number of channels.
+		 */
+		bool setOutputFormat(int sampleRate, int channels);
+
+		int read(int16_t* buffer, int noFrames);
+		void stop();
+
+	private:
+		pcmFormat format;
+		uint64_t length;
+		uint64_t position;
+		double phase;
+		double frequency;
+		bool stopped;
+};
+
+#endif
@@ -1,11 +1,11 @@
 /****************************************
  *
- * packetqueue.h
- * Declares a multithreaded AVPacket queue.
+ * alignedAlloc.cpp
+ * Allocate aligned arrays.
  *
  * This file is part of mattulizer.
  *
- * Copyright 2011 (c) Matthew Leach.
+ * Copyright 2014 (c) Matthew Leach.
  *
  * Mattulizer is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -21,25 +21,16 @@
  * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <pthread.h>
-extern "C"{
-#include <libavcodec/avcodec.h>
-#include <libavformat/avformat.h>
-}
+#include "alignedAlloc.h"
+#include <stdlib.h>
+#include <string.h>
 
-class packetQueue
+float* allocAlignedFloats(int length)
 {
-public:
-	packetQueue();
-	virtual ~packetQueue();
-	void put(AVPacket* packet);
-	int get(AVPacket* packetToReturn);
-
-private:
-	AVPacketList* first_packet;
-	AVPacketList* last_packet;
-	int num_packets;
-	int size;
-	pthread_mutex_t* mut;
-};
-
+	void* mem = NULL;
+	if(posix_memalign(&mem, sizeof(float) * ALIGNED_FLOAT_WIDTH,
+	                  sizeof(float) * length) != 0)
+		return NULL;
+	memset(mem, 0, sizeof(float) * length);
+	return (float*)mem;
+}
@@ -0,0 +1,39 @@
+/****************************************
+ *
+ * alignedAlloc.h
+ * Declare a helper for allocating aligned arrays.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _ALIGNEDALLOC_H_
+#define _ALIGNEDALLOC_H_
+
+// The alignment, in floats, of arrays from allocAlignedFloats(),
+// enough for SSE loads.
+#define ALIGNED_FLOAT_WIDTH 4
+
+/**
+ * Allocate a zeroed array of floats aligned for SSE loads.
+ * @param length the number of floats in the array.
+ * @returns the array, which should be freed with free(), or NULL if
+ * it couldn't be allocated.
+ */
+float* allocAlignedFloats(int length);
+
+#endif
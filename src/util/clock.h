@@ -0,0 +1,45 @@
+/****************************************
+ *
+ * clock.h
+ * Declare monotonic clock helpers.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CLOCK_H_
+#define _CLOCK_H_
+
+#include <stdint.h>
+
+/**
+ * Get the current time from a monotonic clock. Unlike
+ * SDL_GetTicks() this has microsecond resolution and is
+ * never adjusted by NTP or the user changing the time.
+ *
+ * @returns the time in microseconds since an arbitrary
+ * point in the past.
+ */
+uint64_t monotonicTimeUs();
+
+/**
+ * Sleep the calling thread for at least the given time.
+ * @param us the time to sleep in microseconds.
+ */
+void sleepUs(uint64_t us);
+
+#endif
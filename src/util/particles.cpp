@@ -0,0 +1,251 @@
+/****************************************
+ *
+ * particles.cpp
+ * A structure of arrays for moving lots of vertices.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// See particles.h for docs.
+#include "particles.h"
+#include "alignedAlloc.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <exception>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// The bits of a float from 1 up to, but not including, 2. A random
+// mantissa ORed with this gives a random float in that range.
+#define FLOAT_ONE_BITS 0x3f800000
+
+particles::particles(int count, uint32_t seed)
+{
+	this->count = count;
+	stride = (count + PARTICLES_VECTOR_WIDTH - 1) & ~(PARTICLES_VECTOR_WIDTH - 1);
+	x = allocAlignedFloats(stride);
+	y = allocAlignedFloats(stride);
+	dirX = allocAlignedFloats(stride);
+	dirY = allocAlignedFloats(stride);
+	red = allocAlignedFloats(stride);
+	green = allocAlignedFloats(stride);
+	blue = allocAlignedFloats(stride);
+	if(x == NULL || y == NULL || dirX == NULL || dirY == NULL ||
+	   red == NULL || green == NULL || blue == NULL)
+		throw(std::exception());
+
+	// Seed each generator differently, a xorshift generator can't
+	// have a state of 0.
+	void* mem = NULL;
+	if(posix_memalign(&mem, sizeof(uint32_t) * PARTICLES_VECTOR_WIDTH,
+	                  sizeof(uint32_t) * PARTICLES_VECTOR_WIDTH) != 0)
+		throw(std::exception());
+	seeds = (uint32_t*)mem;
+	for(int i = 0; i < PARTICLES_VECTOR_WIDTH; i++)
+	{
+		seed = (seed * 1664525) + 1013904223;
+		seeds[i] = seed ? seed : 1;
+	}
+
+	randomisePositions();
+	randomiseDirections();
+	randomiseColours();
+}
+
+particles::~particles()
+{
+	free(x);
+	free(y);
+	free(dirX);
+	free(dirY);
+	free(red);
+	free(green);
+	free(blue);
+	free(seeds);
+}
+
+int particles::getCount() const
+{
+	return count;
+}
+
+int particles::getStride() const
+{
+	return stride;
+}
+
+float* particles::getX()
+{
+	return x;
+}
+
+float* particles::getY()
+{
+	return y;
+}
+
+float* particles::getDirX()
+{
+	return dirX;
+}
+
+float* particles::getDirY()
+{
+	return dirY;
+}
+
+float* particles::getRed()
+{
+	return red;
+}
+
+float* particles::getGreen()
+{
+	return green;
+}
+
+float* particles::getBlue()
+{
+	return blue;
+}
+
+void particles::randomisePositions()
+{
+	fillRandom(x, 2, -1);
+	fillRandom(y, 2, -1);
+}
+
+void particles::randomiseDirections()
+{
+	fillRandom(dirX, 2, -1);
+	fillRandom(dirY, 2, -1);
+}
+
+void particles::randomiseColours()
+{
+	fillRandom(red, 1, 0);
+	fillRandom(green, 1, 0);
+	fillRandom(blue, 1, 0);
+}
+
+void particles::fillRandom(float* array, float scale, float offset)
+{
+#ifdef __SSE2__
+	__m128i state = _mm_load_si128((__m128i*)seeds);
+	__m128i oneBits = _mm_set1_epi32(FLOAT_ONE_BITS);
+	__m128 one = _mm_set1_ps(1.0f);
+	__m128 scales = _mm_set1_ps(scale);
+	__m128 offsets = _mm_set1_ps(offset);
+	for(int i = 0; i < stride; i += PARTICLES_VECTOR_WIDTH)
+	{
+		state = _mm_xor_si128(state, _mm_slli_epi32(state, 13));
+		state = _mm_xor_si128(state, _mm_srli_epi32(state, 17));
+		state = _mm_xor_si128(state, _mm_slli_epi32(state, 5));
+
+		// Use the top 23 bits as the mantissa of a float from 1 to 2.
+		__m128 r = _mm_castsi128_ps(_mm_or_si128(_mm_srli_epi32(state, 9), oneBits));
+		r = _mm_sub_ps(r, one);
+		_mm_store_ps(array + i, _mm_add_ps(_mm_mul_ps(r, scales), offsets));
+	}
+	_mm_store_si128((__m128i*)seeds, state);
+#else
+	for(int i = 0; i < stride; i += PARTICLES_VECTOR_WIDTH)
+	{
+		for(int j = 0; j < PARTICLES_VECTOR_WIDTH; j++)
+		{
+			uint32_t s = seeds[j];
+			s ^= s << 13;
+			s ^= s >> 17;
+			s ^= s << 5;
+			seeds[j] = s;
+
+			uint32_t bits = (s >> 9) | FLOAT_ONE_BITS;
+			float r;
+			memcpy(&r, &bits, sizeof(r));
+			array[i + j] = ((r - 1.0f) * scale) + offset;
+		}
+	}
+#endif
+
+	// Keep the padding clear.
+	for(int i = count; i < stride; i++)
+		array[i] = 0;
+}
+
+/**
+ * Move one co-ordinate of the particles, bouncing them off the edges.
+ */
+static void stepAxis(float* pos, float* dir, int stride, float amount)
+{
+#ifdef __SSE2__
+	__m128 amounts = _mm_set1_ps(amount);
+	__m128 one = _mm_set1_ps(1.0f);
+	__m128 minusOne = _mm_set1_ps(-1.0f);
+	__m128 signBit = _mm_set1_ps(-0.0f);
+	for(int i = 0; i < stride; i += PARTICLES_VECTOR_WIDTH)
+	{
+		__m128 p = _mm_load_ps(pos + i);
+		__m128 d = _mm_load_ps(dir + i);
+		p = _mm_add_ps(p, _mm_mul_ps(amounts, d));
+		_mm_store_ps(pos + i, p);
+
+		// Point the particles that are on or past an edge back
+		// towards the middle, the direction gets the opposite sign
+		// to the position.
+		__m128 out = _mm_or_ps(_mm_cmple_ps(p, minusOne), _mm_cmpge_ps(p, one));
+		__m128 bounced = _mm_or_ps(_mm_andnot_ps(signBit, d),
+		                           _mm_andnot_ps(p, signBit));
+		d = _mm_or_ps(_mm_and_ps(out, bounced), _mm_andnot_ps(out, d));
+		_mm_store_ps(dir + i, d);
+	}
+#else
+	for(int i = 0; i < stride; i++)
+	{
+		pos[i] += amount * dir[i];
+		if(pos[i] <= -1 || pos[i] >= 1)
+			dir[i] = copysignf(dir[i], -pos[i]);
+	}
+#endif
+}
+
+void particles::step(float amount)
+{
+	stepAxis(x, dirX, stride, amount);
+	stepAxis(y, dirY, stride, amount);
+}
+
+void particles::packPositions(float* out) const
+{
+	for(int i = 0; i < count; i++)
+	{
+		out[(i * 2)] = x[i];
+		out[(i * 2) + 1] = y[i];
+	}
+}
+
+void particles::packColours(float* out) const
+{
+	for(int i = 0; i < count; i++)
+	{
+		out[(i * 3)] = red[i];
+		out[(i * 3) + 1] = green[i];
+		out[(i * 3) + 2] = blue[i];
+	}
+}
@@ -0,0 +1,134 @@
+/****************************************
+ *
+ * particles.h
+ * A structure of arrays for moving lots of vertices.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PARTICLES_H_
+#define _PARTICLES_H_
+
+#include <stdint.h>
+
+// The number of floats processed together. The arrays are aligned and
+// padded to a multiple of this.
+#define PARTICLES_VECTOR_WIDTH 4
+
+/**
+ * A set of particles, such as the vertices of a shape, that move in
+ * straight lines and bounce off the edges of the screen.
+ *
+ * Each property of the particles is kept in its own array so that they
+ * can be updated a whole SSE register at a time. The arrays are padded
+ * to getStride() elements, the padding is kept at zero so that the
+ * arrays can be used directly in dot products.
+ *
+ * Random numbers come from four xorshift generators that are run side
+ * by side, which is much quicker than calling rand() for each value.
+ */
+class particles
+{
+public:
+	/**
+	 * Create a set of particles with random positions, directions
+	 * and colours.
+	 * @param count the number of particles.
+	 * @param seed the seed for the random number generator.
+	 */
+	particles(int count, uint32_t seed);
+
+	virtual ~particles();
+
+	int getCount() const;
+
+	/**
+	 * @returns the padded length of each array.
+	 */
+	int getStride() const;
+
+	/**
+	 * Get the arrays of the particle properties. Positions are in
+	 * clip co-ordinates and colours are from 0 to 1.
+	 */
+	float* getX();
+	float* getY();
+	float* getDirX();
+	float* getDirY();
+	float* getRed();
+	float* getGreen();
+	float* getBlue();
+
+	/**
+	 * Move the particles to random positions on the screen.
+	 */
+	void randomisePositions();
+
+	/**
+	 * Send the particles off in random directions.
+	 */
+	void randomiseDirections();
+
+	/**
+	 * Give the particles random colours.
+	 */
+	void randomiseColours();
+
+	/**
+	 * Move each particle along its direction. Particles that reach an
+	 * edge of the screen are turned around to head back onto it.
+	 * @param amount how far to move along the direction.
+	 */
+	void step(float amount);
+
+	/**
+	 * Copy the positions into an array of x, y pairs that can be
+	 * used with glVertexPointer().
+	 * @param out an array of at least getCount() * 2 floats.
+	 */
+	void packPositions(float* out) const;
+
+	/**
+	 * Copy the colours into an array of red, green, blue triples
+	 * that can be used with glColorPointer().
+	 * @param out an array of at least getCount() * 3 floats.
+	 */
+	void packColours(float* out) const;
+
+private:
+	/**
+	 * Fill an array with random numbers from offset to
+	 * offset + scale, leaving the padding at zero.
+	 */
+	void fillRandom(float* array, float scale, float offset);
+
+	int count;
+	int stride;
+	float* x;
+	float* y;
+	float* dirX;
+	float* dirY;
+	float* red;
+	float* green;
+	float* blue;
+
+	// The state of each of the random number generators.
+	uint32_t* seeds;
+};
+
+#endif
@@ -0,0 +1,168 @@
+/****************************************
+ *
+ * slidingMedian.cpp
+ * Define a sliding median.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "slidingMedian.h"
+
+slidingMedian::slidingMedian(int windowLength)
+{
+	this->windowLength = windowLength > 0 ? windowLength : 1;
+	values.resize(this->windowLength);
+	inLow.resize(this->windowLength);
+	position.resize(this->windowLength);
+	low.reserve(this->windowLength);
+	high.reserve(this->windowLength);
+	clear();
+}
+
+slidingMedian::~slidingMedian()
+{
+}
+
+void slidingMedian::clear()
+{
+	count = 0;
+	next = 0;
+	low.clear();
+	high.clear();
+}
+
+int slidingMedian::size() const
+{
+	return count;
+}
+
+float slidingMedian::median() const
+{
+	if(count == 0)
+		return 0;
+	if(low.size() > high.size())
+		return values[low[0]];
+	return (values[low[0]] + values[high[0]]) / 2;
+}
+
+float slidingMedian::insert(float value)
+{
+	int slot = next;
+	next = (next + 1) % windowLength;
+	values[slot] = value;
+
+	if(count < windowLength)
+	{
+		// Add it to the half it belongs in and even them up.
+		count++;
+		push(low.empty() || value <= values[low[0]], slot);
+		if(low.size() > high.size() + 1)
+			moveTop(true);
+		else if(high.size() > low.size())
+			moveTop(false);
+		return median();
+	}
+
+	// The window is full, the new value has replaced the oldest one in
+	// its heap. Put it in order within that heap, and if it now
+	// belongs in the other half swap the two tops over.
+	bool heap = inLow[slot];
+	siftUp(heap, position[slot]);
+	siftDown(heap, position[slot]);
+	if(!high.empty() && values[low[0]] > values[high[0]])
+	{
+		int top = low[0];
+		low[0] = high[0];
+		high[0] = top;
+		inLow[low[0]] = true;
+		inLow[high[0]] = false;
+		position[low[0]] = 0;
+		position[high[0]] = 0;
+		siftDown(true, 0);
+		siftDown(false, 0);
+	}
+	return median();
+}
+
+void slidingMedian::moveTop(bool fromLow)
+{
+	std::vector<int>& heap = fromLow ? low : high;
+	int slot = heap[0];
+	swap(fromLow, 0, heap.size() - 1);
+	heap.pop_back();
+	if(!heap.empty())
+		siftDown(fromLow, 0);
+	push(!fromLow, slot);
+}
+
+void slidingMedian::push(bool toLow, int slot)
+{
+	std::vector<int>& heap = toLow ? low : high;
+	heap.push_back(slot);
+	inLow[slot] = toLow;
+	position[slot] = heap.size() - 1;
+	siftUp(toLow, heap.size() - 1);
+}
+
+bool slidingMedian::above(bool inLow, int a, int b) const
+{
+	return inLow ? values[a] > values[b] : values[a] < values[b];
+}
+
+void slidingMedian::swap(bool inLow, int posA, int posB)
+{
+	std::vector<int>& heap = inLow ? low : high;
+	int slot = heap[posA];
+	heap[posA] = heap[posB];
+	heap[posB] = slot;
+	position[heap[posA]] = posA;
+	position[heap[posB]] = posB;
+}
+
+void slidingMedian::siftUp(bool inLow, int pos)
+{
+	std::vector<int>& heap = inLow ? low : high;
+	while(pos > 0)
+	{
+		int parent = (pos - 1) / 2;
+		if(!above(inLow, heap[pos], heap[parent]))
+			break;
+		swap(inLow, pos, parent);
+		pos = parent;
+	}
+}
+
+void slidingMedian::siftDown(bool inLow, int pos)
+{
+	std::vector<int>& heap = inLow ? low : high;
+	int length = heap.size();
+	while(true)
+	{
+		int best = pos;
+		int left = (pos * 2) + 1;
+		int right = left + 1;
+		if(left < length && above(inLow, heap[left], heap[best]))
+			best = left;
+		if(right < length && above(inLow, heap[right], heap[best]))
+			best = right;
+		if(best == pos)
+			break;
+		swap(inLow, pos, best);
+		pos = best;
+	}
+}
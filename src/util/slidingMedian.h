@@ -0,0 +1,117 @@
+/****************************************
+ *
+ * slidingMedian.h
+ * Declare a sliding median.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SLIDINGMEDIAN_H_
+#define _SLIDINGMEDIAN_H_
+
+#include <vector>
+
+/**
+ * The median of the last few values of a stream.
+ *
+ * The values in the window are split between two heaps, a max heap of
+ * the lower half and a min heap of the upper half, so the median is
+ * always at the top of one or both of them. Each value remembers where
+ * it is in its heap, so when the window is full the oldest value can
+ * be overwritten by the new one in place and sifted to where it
+ * belongs. Adding a value costs O(log n) rather than the O(n log n) of
+ * sorting the window each time.
+ */
+class slidingMedian
+{
+public:
+	/**
+	 * Create an empty sliding median.
+	 * @param windowLength the number of values the median is taken
+	 * over.
+	 */
+	slidingMedian(int windowLength);
+
+	virtual ~slidingMedian();
+
+	/**
+	 * Add a value, dropping the oldest one if the window is full.
+	 * @returns the new median.
+	 */
+	float insert(float value);
+
+	/**
+	 * @returns the median of the values in the window, the mean of
+	 * the middle two if there is an even number of them. 0 if the
+	 * window is empty.
+	 */
+	float median() const;
+
+	/**
+	 * Empty the window.
+	 */
+	void clear();
+
+	int size() const;
+
+private:
+	/**
+	 * Move the top of one heap to the other.
+	 */
+	void moveTop(bool fromLow);
+
+	/**
+	 * Put a slot into a heap.
+	 */
+	void push(bool toLow, int slot);
+
+	/**
+	 * Restore a heap after the value at pos has changed.
+	 */
+	void siftUp(bool inLow, int pos);
+	void siftDown(bool inLow, int pos);
+
+	/**
+	 * Whether the value in slot a belongs above the one in b in a
+	 * heap.
+	 */
+	bool above(bool inLow, int a, int b) const;
+
+	void swap(bool inLow, int posA, int posB);
+
+	int windowLength;
+	int count;
+
+	// The slot the next value goes in, the oldest once it is full.
+	int next;
+
+	// The values in the order they arrived.
+	std::vector<float> values;
+
+	// Which heap each slot is in and where.
+	std::vector<bool> inLow;
+	std::vector<int> position;
+
+	// The heaps of slots, the largest of the lower half is at the
+	// top of low and the smallest of the upper half at the top of
+	// high. low has the same number or one more than high.
+	std::vector<int> low;
+	std::vector<int> high;
+};
+
+#endif
@@ -24,8 +24,89 @@
 // see visualiser.h for docs.
 #include "visualiser.h"
 
+// The fraction of the frame period, in percent, that drawing can take
+// before a frame is counted as slow or as having time to spare.
+#define QUALITY_SLOW_PERCENT 90
+#define QUALITY_FAST_PERCENT 60
+
+// How many frames in a row need to be slow or fast before the
+// quality level is changed.
+#define QUALITY_SLOW_FRAMES 10
+#define QUALITY_FAST_FRAMES 120
+
 visualiser::visualiser(visualiserWin *win)
 {
 	this->win = win;
+	quality = VISUALISER_MAX_QUALITY;
+	autoQuality = true;
+	slowFrames = 0;
+	fastFrames = 0;
+}
+
+int visualiser::getQuality() const
+{
+	return quality;
+}
+
+float visualiser::getQualityScale() const
+{
+	return (float)quality / VISUALISER_MAX_QUALITY;
+}
+
+void visualiser::setQuality(int quality)
+{
+	if(quality < 1)
+		quality = 1;
+	if(quality > VISUALISER_MAX_QUALITY)
+		quality = VISUALISER_MAX_QUALITY;
+
+	slowFrames = 0;
+	fastFrames = 0;
+	if(quality == this->quality)
+		return;
+
+	this->quality = quality;
+	qualityChanged(quality);
+}
+
+void visualiser::setAutoQuality(bool enable)
+{
+	autoQuality = enable;
+	slowFrames = 0;
+	fastFrames = 0;
+}
+
+bool visualiser::getAutoQuality() const
+{
+	return autoQuality;
+}
+
+void visualiser::adaptQuality(uint64_t drawTime, uint64_t framePeriod)
+{
+	if(!autoQuality || framePeriod == 0)
+		return;
+
+	if(drawTime * 100 > framePeriod * QUALITY_SLOW_PERCENT)
+	{
+		fastFrames = 0;
+		if(slowFrames < QUALITY_SLOW_FRAMES)
+			slowFrames++;
+		if(slowFrames == QUALITY_SLOW_FRAMES && quality > 1)
+			setQuality(quality - 1);
+	}
+	else if(drawTime * 100 < framePeriod * QUALITY_FAST_PERCENT)
+	{
+		slowFrames = 0;
+		if(fastFrames < QUALITY_FAST_FRAMES)
+			fastFrames++;
+		if(fastFrames == QUALITY_FAST_FRAMES &&
+		   quality < VISUALISER_MAX_QUALITY)
+			setQuality(quality + 1);
+	}
+	else
+	{
+		slowFrames = 0;
+		fastFrames = 0;
+	}
 }
 
@@ -27,6 +27,9 @@
 // Predeclare the window class.
 #include "visualiserWin.h"
 
+// The highest quality level, and the one visualisers start at.
+#define VISUALISER_MAX_QUALITY 8
+
 /**
  * A visualiser interface. To create a visualiser,
  * simply create a subclass and implement the
@@ -58,8 +61,77 @@ class visualiser
 		 * the windows event loop.
 		 */
 		virtual void draw() = 0;
+
+		/**
+		 * This function is called between frames with the time that is
+		 * left before the next frame has to be drawn. Work that doesn't
+		 * need doing every frame can be done here rather than in draw()
+		 * so that it doesn't make frames late.
+		 * @param budget the spare time in microseconds.
+		 */
+		virtual void idle(uint64_t budget) {};
+
+		/**
+		 * @returns the quality level that the visualiser should draw
+		 * at, from 1 up to VISUALISER_MAX_QUALITY.
+		 */
+		int getQuality() const;
+
+		/**
+		 * @returns the quality level as a fraction of the highest
+		 * quality. Visualisers can scale how much they draw by this,
+		 * such as the number of bins drawn, the amount of history kept
+		 * or the number of points on a curve.
+		 */
+		float getQualityScale() const;
+
+		/**
+		 * Set the quality level. The level is clamped to the range
+		 * 1 to VISUALISER_MAX_QUALITY.
+		 */
+		void setQuality(int quality);
+
+		/**
+		 * Choose whether adaptQuality() should change the quality
+		 * level. This is on by default.
+		 */
+		void setAutoQuality(bool enable);
+
+		bool getAutoQuality() const;
+
+		/**
+		 * Adjust the quality level from how long frames are taking to
+		 * draw. The window calls this after every frame.
+		 *
+		 * The quality is lowered once frames have been taking too much
+		 * of the frame period for a few frames in a row, and is only
+		 * raised again after a much longer run of frames with plenty
+		 * of time to spare so that it doesn't flip between two levels.
+		 * @param drawTime the average time taken to draw a frame, in
+		 * microseconds.
+		 * @param framePeriod the time that each frame has, in
+		 * microseconds. If this is 0 then frames aren't paced and the
+		 * quality is left alone.
+		 */
+		void adaptQuality(uint64_t drawTime, uint64_t framePeriod);
+
+		/**
+		 * This function is called when the quality level changes. It
+		 * can be implemented to resize anything that depends on the
+		 * quality level.
+		 * @param quality the new quality level.
+		 */
+		virtual void qualityChanged(int quality) {};
 	protected:
 		visualiserWin* win;
+	private:
+		int quality;
+		bool autoQuality;
+
+		// The number of frames in a row that have been too slow or
+		// had time to spare.
+		int slowFrames;
+		int fastFrames;
 };
 
 #endif
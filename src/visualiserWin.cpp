@@ -29,20 +29,43 @@
 #include "eventHandlers/quitEvent.h"
 #include "eventHandlers/keyQuit.h"
 #include "argexception.h"
+#include "util/clock.h"
+#include "dsp/analysisCache.h"
+#include "fifoReader.h"
+#include "shmReader.h"
+#include "audioDecoder.h"
+#include "testSignal.h"
+#include "sourceFeeder.h"
+#include "frameScheduler.h"
 #include <unistd.h>
 #include <SDL_timer.h>
 #include <SDL_audio.h>
 #include <iostream>
-#include <stdexcept>
+#include <vector>
+#include <algorithm>
+#include <string.h>
 
-extern "C"{
-#include <libavcodec/avcodec.h>
-#include <libavutil/opt.h>
-#include <libavformat/avformat.h>
-#include <libswresample/swresample.h>
-}
+// The longest the audio can be delayed by, in seconds.
+#define MAX_AUDIO_DELAY 1
+
+// The number of frames passed to the DSP manager at a time when reading
+// from MPD or shared memory, the same as the audio buffer when playing
+// a file.
+#define INPUT_BLOCK_FRAMES 1024
+
+// The format that MPD's FIFO output is expected to be set to.
+#define MPD_DEFAULT_FORMAT "44100:16:1"
+
+// The longest that the event loop sleeps for without checking for
+// events while waiting for the next frame, in microseconds.
+#define FRAME_WAIT_SLICE 2000
 
-#define CIRCBUFSIZE 5
+// The number of frames decoded ahead of the sound card.
+#define PLAYBACK_BUFFER_FRAMES 8192
+
+// How long the decode thread waits for room in the playback
+// buffer, in microseconds.
+#define PLAYBACK_WAIT 5000
 
 visualiserWin::visualiserWin(int desiredFrameRate,
                              bool vsync,
@@ -57,6 +80,8 @@ visualiserWin::visualiserWin(int desiredFrameRate,
 	this->shouldCloseWindow = false;
 	this->width = width;
 	this->height = height;
+	this->frameTime = 0;
+	this->fixedQuality = 0;
 
 	// Set the OpenGL attributes
 	SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
@@ -72,9 +97,21 @@ visualiserWin::visualiserWin(int desiredFrameRate,
 	if(drawContext == NULL)
 		throw(SDLException());
 
+	// Pace the frames with the vsync or at the frame rate.
+	scheduler = new frameScheduler(vsync ? FRAME_SCHEDULE_VSYNC : FRAME_SCHEDULE_FIXED,
+	                               desiredFrameRate);
+
 	// Disable MPD mode by default.
 	MPDMode = false;
 	mpdError = false;
+	parsePCMFormat(MPD_DEFAULT_FORMAT, &MPDFormat);
+	source = NULL;
+	feeder = NULL;
+	playbackBuffer = NULL;
+	decodeThread = NULL;
+	playbackStopped = false;
+	playbackChannels = 0;
+	useTestSignal = false;
 	
 	// also initialise the standard event handlers.
 	initialiseStockEventHandlers();
@@ -89,15 +126,26 @@ visualiserWin::visualiserWin(int argc, char* argv[])
 	this->shouldCloseWindow = false;
 	this->width = 800;
 	this->height = 600;
+	this->frameTime = 0;
+	this->fixedQuality = 0;
 	bool fullscreen = false;
+	int manualDelay = -1;
 	MPDMode = false;
 	mpdError = false;
+	parsePCMFormat(MPD_DEFAULT_FORMAT, &MPDFormat);
+	source = NULL;
+	feeder = NULL;
+	playbackBuffer = NULL;
+	decodeThread = NULL;
+	playbackStopped = false;
+	playbackChannels = 0;
+	useTestSignal = false;
 	char opt;
 	// Parse the options. Note, we don't check the default
 	// case as there may be other options that are specified
 	// for other parts of the program (such as visualisers).
 	opterr = 0;
-	while((opt = getopt(argc, argv, "s:fm:")) != -1)
+	while((opt = getopt(argc, argv, "s:fR:Q:m:F:P:Tl:C:")) != -1)
 	{
 		switch(opt)
 		{
@@ -119,10 +167,49 @@ visualiserWin::visualiserWin(int argc, char* argv[])
 			case 'f': // Fullscreen.
 				fullscreen = true;
 				break;
+			case 'R': // Frame rate.
+			{
+				char* end;
+				desiredFrameRate = strtol(optarg, &end, 10);
+				if(*end != '\0' || desiredFrameRate < 0)
+					throw(argException("Frame rate should be a number of frames per second, 0 or more."));
+				shouldVsync = false;
+				break;
+			}
+			case 'Q': // Fixed quality level.
+			{
+				char* end;
+				fixedQuality = strtol(optarg, &end, 10);
+				if(*end != '\0' || fixedQuality < 1 ||
+				   fixedQuality > VISUALISER_MAX_QUALITY)
+					throw(argException("Quality should be a number from 1 to 8."));
+				break;
+			}
 			case 'm':
 				MPDFile = optarg;
 				MPDMode = true;
 				break;
+			case 'F': // MPD FIFO format.
+				if(!parsePCMFormat(optarg, &MPDFormat))
+					throw(argException("MPD format should be RATE:BITS:CHANNELS, eg 44100:16:2."));
+				break;
+			case 'P': // Shared memory PCM ring.
+				shmName = optarg;
+				break;
+			case 'T': // Test signal.
+				useTestSignal = true;
+				break;
+			case 'l': // Fixed audio delay.
+			{
+				char* end;
+				manualDelay = strtol(optarg, &end, 10);
+				if(*end != '\0' || manualDelay < 0)
+					throw(argException("Audio delay should be a number of milliseconds, 0 or more."));
+				break;
+			}
+			case 'C': // Analysis cache directory.
+				cacheDir = optarg;
+				break;
 		}
 	}
 
@@ -134,6 +221,11 @@ visualiserWin::visualiserWin(int argc, char* argv[])
 		height = videoInfo->current_h;
 	}
 
+	// Pace the frames with the vsync unless a frame rate was given,
+	// a frame rate of 0 draws frames as fast as possible.
+	scheduler = new frameScheduler(shouldVsync ? FRAME_SCHEDULE_VSYNC : FRAME_SCHEDULE_FIXED,
+	                               desiredFrameRate);
+
 	// Set the OpenGL attributes
 	SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
 	SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
@@ -142,6 +234,8 @@ visualiserWin::visualiserWin(int argc, char* argv[])
 
 	// Create the DSP manmager
 	dspman = new DSPManager();
+	if(manualDelay >= 0)
+		dspman->getLatencyManager()->setManualDelay(manualDelay);
 
 	// Create the window
 	if(fullscreen)
@@ -158,13 +252,34 @@ visualiserWin::visualiserWin(int argc, char* argv[])
 
 visualiserWin::~visualiserWin()
 {
+	// Stop the audio before the DSP manager goes.
+	if(source)
+	{
+		__atomic_store_n(&playbackStopped, true, __ATOMIC_RELEASE);
+		source->stop();
+		if(feeder)
+			delete feeder;
+		if(decodeThread)
+		{
+			pthread_join(*decodeThread, NULL);
+			delete decodeThread;
+		}
+		if(playbackBuffer)
+		{
+			SDL_CloseAudio();
+			delete playbackBuffer;
+		}
+		delete source;
+	}
+
 	delete dspman;
+	delete scheduler;
 	
 	// delete all registered event handlers.
-	for(std::set<eventHandler*>::iterator i = eventHandlers.begin();
-	    i != eventHandlers.end(); i ++)
+	for(int type = 0; type < SDL_NUMEVENTS; type++)
 	{
-		delete *i;
+		for(size_t i = 0; i < eventHandlers[type].size(); i++)
+			delete eventHandlers[type][i];
 	}
 	
 	// Close the sound device
@@ -181,9 +296,25 @@ std::string visualiserWin::usage()
 	theUsage += "        your current screen resolution and fill the screen.\n";
 	theUsage += "-s      Set the size of the window. This option should be in\n";
 	theUsage += "        the format [WIDTH]x[HEIGHT], eg 1024x768.\n";
+	theUsage += "-R      Draw this many frames per second rather than waiting\n";
+	theUsage += "        for the vertical sync, 0 draws as fast as possible.\n";
+	theUsage += "-Q      Draw at a fixed quality level from 1 to 8 rather than\n";
+	theUsage += "        lowering the quality when frames take too long.\n";
 	theUsage += "-m      Enable mpd mode. The argument to this option should\n";
-	theUsage += "        be a path to the MPD FIFO output that is set to the\n";
-	theUsage += "        format 44100:16:1.";
+	theUsage += "        be a path to the MPD FIFO output.\n";
+	theUsage += "-F      The format of the MPD FIFO output, in MPD's notation\n";
+	theUsage += "        RATE:BITS:CHANNELS where BITS is 16, 24, 32 or f. The\n";
+	theUsage += "        default is " MPD_DEFAULT_FORMAT ".\n";
+	theUsage += "-P      Read PCM from a shared memory ring that another program\n";
+	theUsage += "        on this machine writes to. The argument is the name of\n";
+	theUsage += "        the shared memory object, eg /mattuliser.\n";
+	theUsage += "-T      Play a test signal, a sine sweep with a click on each\n";
+	theUsage += "        beat, rather than the file.\n";
+	theUsage += "-l      Delay the audio by a fixed number of milliseconds rather\n";
+	theUsage += "        than measuring how long the visualiser takes to draw.\n";
+	theUsage += "-C      Keep the analysis of each track that is played in this\n";
+	theUsage += "        directory so that it doesn't need to be done again the\n";
+	theUsage += "        next time the track is played.";
 
 	return theUsage;
 }
@@ -191,7 +322,7 @@ std::string visualiserWin::usage()
 std::string visualiserWin::usageSmall()
 {
 	std::string theSmallUsage;
-	theSmallUsage = "-f -s [WIDTH]x[HEIGHT] -m MPD_FIFO";
+	theSmallUsage = "-f -s [WIDTH]x[HEIGHT] -R FPS -Q QUALITY -m MPD_FIFO -F FORMAT -P SHM_NAME -T -l DELAY_MS -C CACHE_DIR";
 	return theSmallUsage;
 }
 
@@ -206,6 +337,11 @@ void visualiserWin::initialiseStockEventHandlers()
 void visualiserWin::setVisualiser(visualiser* vis)
 {
 	currentVis = vis;
+	if(vis != NULL && fixedQuality > 0)
+	{
+		vis->setQuality(fixedQuality);
+		vis->setAutoQuality(false);
+	}
 }
 
 void visualiserWin::closeWindow()
@@ -215,7 +351,26 @@ void visualiserWin::closeWindow()
 
 void visualiserWin::registerEventHandler(eventHandler* eH)
 {
-	eventHandlers.insert(eH);
+	uint8_t type = eH->eventType();
+	if(type >= SDL_NUMEVENTS)
+		return;
+
+	std::vector<eventHandler*>& handlers = eventHandlers[type];
+	if(std::find(handlers.begin(), handlers.end(), eH) == handlers.end())
+		handlers.push_back(eH);
+}
+
+void visualiserWin::unregisterEventHandler(eventHandler* eH)
+{
+	uint8_t type = eH->eventType();
+	if(type >= SDL_NUMEVENTS)
+		return;
+
+	std::vector<eventHandler*>& handlers = eventHandlers[type];
+	std::vector<eventHandler*>::iterator i = std::find(handlers.begin(),
+	                                                   handlers.end(), eH);
+	if(i != handlers.end())
+		handlers.erase(i);
 }
 
 void visualiserWin::signalError()
@@ -227,6 +382,7 @@ void visualiserWin::signalError()
 void visualiserWin::eventLoop()
 {
 	SDL_Event e;
+	uint64_t lastSwap = 0;
 	while(!shouldCloseWindow)
 	{
 		if(currentVis == NULL)
@@ -241,83 +397,78 @@ void visualiserWin::eventLoop()
 			// Check for error.
 			if(mpdError)
 				return;
-			// handle events...
-			if(SDL_PollEvent(&e) == 0)
+			// handle all of the events that have arrived since
+			// the last frame.
+			while(SDL_PollEvent(&e))
 				handleEvent(&e);
 			
 			// do some drawing
-			Uint32 before = SDL_GetTicks();
+			uint64_t drawStart = scheduler->beginFrame();
+			frameTime = drawStart + dspman->getLatencyManager()->getRenderLatencyUs();
 			currentVis->draw();
-			Uint32 after = SDL_GetTicks();
+			scheduler->endDraw();
 			
 			SDL_GL_SwapBuffers();
-			
-			if(!shouldVsync)
-			{
-				// Calculate the time taken to do the drawing
-				Uint32 timeTaken = after - before;
-				
-				int delayTime = ((Uint32)1000/desiredFrameRate) - timeTaken;
-				
-				if(delayTime > 0)
-				{
-					// Delay to maintain the framerate
-					SDL_Delay((Uint32)delayTime);
-				}
-			}
+
+			// Let the latency manager know how long it took for the
+			// frame to get onto the screen.
+			uint64_t swapped = scheduler->endFrame();
+			if(lastSwap != 0)
+				dspman->getLatencyManager()->reportRenderTime(swapped - drawStart,
+				                                              swapped - lastSwap);
+			lastSwap = swapped;
+
+			// Trade detail for speed if frames are taking too long.
+			currentVis->adaptQuality(scheduler->getDrawTime(),
+			                         scheduler->getTargetPeriod());
+
+			waitForNextFrame();
 		}
 	}
 }
 
-static void* MPDWorkerEntry(void* args)
+void visualiserWin::waitForNextFrame()
 {
-	mpdargst* mpdargs = (mpdargst*)args;
-	FILE* f = fopen(mpdargs->file.c_str(), "r");
-	if(f == NULL)
-	{
-		// we couldn't open the file.
-		mpdargs->win->signalError();
-		std::cout << "Could not open MPD FIFO: " << mpdargs->file << std::endl;
-		return NULL;
-	}
-	setbuf(f, NULL);
-	uint8_t data[2048];
-	while(true)
+	// Let the visualiser use any spare time before the next frame.
+	uint64_t budget = scheduler->getIdleBudget();
+	if(budget > 0)
+		currentVis->idle(budget);
+
+	// Keep handling events while waiting so that they aren't held
+	// up until the next frame.
+	uint64_t next = scheduler->getNextFrameStart();
+	uint64_t now;
+	while(!shouldCloseWindow && (now = monotonicTimeUs()) < next)
 	{
-		size_t noRead = fread(&data, sizeof(uint8_t), 2048, f);
-		if(noRead == 0)
-			break;
-		mpdargs->dspman->processAudioPCM(NULL, data, (int)noRead);
+		SDL_Event e;
+		while(SDL_PollEvent(&e))
+			handleEvent(&e);
+
+		uint64_t left = next - now;
+		sleepUs(left < FRAME_WAIT_SLICE ? left : FRAME_WAIT_SLICE);
 	}
-	return 0;
 }
 
-static void* ffmpegWorkerEntry(void* args)
+frameScheduler* visualiserWin::getFrameScheduler() const
 {
-	ffmpegargst* arg = (ffmpegargst*)args;
-	AVFormatContext* fmtCtx = (AVFormatContext*)arg->avformatcontext;
-	int audioStream = arg->audiostream;
-	packetQueue* queue = arg->queue;
-
-	AVPacket packet;
-	while(av_read_frame(fmtCtx, &packet) >= 0)
-	{
-		if(packet.stream_index == audioStream)
-			queue->put(&packet);
-		else
-			av_free_packet(&packet);
-	}
+	return scheduler;
 }
 
 void visualiserWin::handleEvent(SDL_Event* e)
 {
-	for(std::set<eventHandler*>::iterator i = eventHandlers.begin();
-	    i != eventHandlers.end(); i++)
+	if(e->type >= SDL_NUMEVENTS)
+		return;
+
+	// Only the handlers for this type of event are called. A copy is
+	// walked as the handlers may change the registered ones, and any
+	// that are unregistered part way through aren't called.
+	std::vector<eventHandler*>& registered = eventHandlers[e->type];
+	std::vector<eventHandler*> handlers = registered;
+	for(size_t i = 0; i < handlers.size(); i++)
 	{
-		eventHandler* eH = const_cast<eventHandler*>(*i);
-		// call the handler if the type is the same
-		if(eH->eventType() == e->type)
-		eH->handleEvent(e);
+		if(std::find(registered.begin(), registered.end(), handlers[i]) !=
+		   registered.end())
+			handlers[i]->handleEvent(e);
 	}
 }
 
@@ -326,198 +477,137 @@ DSPManager* visualiserWin::getDSPManager() const
 	return dspman;
 }
 
-int static decodeFrame(AVCodecContext* codecCtx, uint8_t **buffer,
-                       int bufferSize, packetQueue* queue,
-                       SwrContext *swr)
+uint64_t visualiserWin::getFrameTime() const
 {
-	AVPacket packet;
-	AVFrame *decodedAudioFrame = av_frame_alloc();
-	int frameDecoded, framesRead, ret;
-
-	//Get a packet.
-	if (!queue->get(&packet))
-		goto err_out;
-
-	framesRead = avcodec_decode_audio4(codecCtx, decodedAudioFrame,
-	                                   &frameDecoded, &packet);
-
-	av_free_packet(&packet);
-
-	if(framesRead < 0)
-		//Skip this packet if we have an error.
-		goto err_out;
-
-	// Note that the buffer that we're copying into is 3/2 times the
-	// size of a an audio frame, so we shouldn't need to check for a
-	// buffer overflow here.
-	if(frameDecoded) {
-		if (av_samples_alloc(buffer, &ret,
-				     av_get_channel_layout_nb_channels(AV_CH_LAYOUT_STEREO),
-				     decodedAudioFrame->nb_samples,
-				     AV_SAMPLE_FMT_S16, 0) < 0)
-			throw std::runtime_error("Could not allocate decode samples buffer");
-
-		swr_convert(swr, buffer, decodedAudioFrame->nb_samples,
-			    (const uint8_t **)decodedAudioFrame->data,
-			    decodedAudioFrame->nb_samples);
-
-                goto out;
-	}
-
-err_out:
-	*buffer = NULL;
-	ret = 0;
-out:
-	av_frame_unref(decodedAudioFrame);
-	return ret;
+	return frameTime;
 }
 
-void static audioThreadEntryPoint(void* udata, uint8_t* stream, int len)
+void* visualiserWin::decodeThreadEntry(void* arg)
 {
-	sdlargst* args = (sdlargst*)udata;
-	DSPManager* dspman = static_cast<DSPManager*>(args->dspman);
-	AVCodecContext* codecCtx = (AVCodecContext*)args->avcodeccontext;
-	packetQueue* queue = args->queue;
-	SwrContext *swr;
-
-	static uint8_t *buf = NULL;
-	static unsigned int bufLength = 0;
-	static unsigned int bufCurrentIndex = 0;
-	uint8_t* streamIndex = stream;
-
-	// Setup the resample context to ensure out samples are in the
-	// format that SDL expectes them to be.
-	swr = swr_alloc();
-	av_opt_set_int(swr, "in_channel_layout",  codecCtx->channel_layout, 0);
-	av_opt_set_int(swr, "out_channel_layout", AV_CH_LAYOUT_STEREO,  0);
-	av_opt_set_int(swr, "in_sample_rate", codecCtx->sample_rate, 0);
-	av_opt_set_int(swr, "out_sample_rate", codecCtx->sample_rate, 0);
-	av_opt_set_sample_fmt(swr, "in_sample_fmt", codecCtx->sample_fmt, 0);
-	av_opt_set_sample_fmt(swr, "out_sample_fmt", AV_SAMPLE_FMT_S16,  0);
-	swr_init(swr);
-
-	int samplesLeft = len;
-	while(samplesLeft > 0)
+	visualiserWin* win = static_cast<visualiserWin*>(arg);
+	int channels = win->playbackChannels;
+	std::vector<int16_t> block(INPUT_BLOCK_FRAMES * channels);
+
+	while(true)
 	{
-		if(bufCurrentIndex >= bufLength)
+		int noFrames = win->source->read(&block[0], INPUT_BLOCK_FRAMES);
+		if(noFrames == 0)
+			break;
+
+		// Only whole frames are written so that the audio callback
+		// never splits one.
+		size_t noSamples = noFrames * channels;
+		size_t written = 0;
+		while(written < noSamples)
 		{
-retry_decode:
-			// No more data in the buffer, get some
-			// more. Ensure we free the old buffer that we
-			// allocated in the previous decodeFrame call.
-			if (buf)
-				free(buf);
-
-			int decodeSize = decodeFrame(codecCtx, &buf, sizeof(buf), queue, swr);
-			if(decodeSize < 0)
-			{
-				// something went wrong... try again.
-				goto retry_decode;
-			}
-			else
-			{
-			  bufLength = decodeSize;
-			}
-			//Reset the index for the new data.
-			bufCurrentIndex = 0;
-		}
-		int numberOfSamples = bufLength - bufCurrentIndex;
-		if(numberOfSamples > samplesLeft)
-			numberOfSamples = samplesLeft;
-		memcpy(streamIndex, (uint8_t*)buf + bufCurrentIndex, numberOfSamples);
-		samplesLeft -= numberOfSamples;
-		streamIndex += numberOfSamples;
-		bufCurrentIndex += numberOfSamples;
-	}
+			if(__atomic_load_n(&win->playbackStopped, __ATOMIC_ACQUIRE))
+				return NULL;
 
-	dspman->processAudioPCM(NULL, stream, len);
+			size_t space = (win->playbackBuffer->space() / channels) * channels;
+			if(space > noSamples - written)
+				space = noSamples - written;
+			written += win->playbackBuffer->write(&block[written], space);
 
-	
-	if(dspman->cbuf == NULL)
-		dspman->cbuf = new circularBuffer::circularBuffer(CIRCBUFSIZE, sizeof(uint8_t) * len);
-	memcpy(dspman->cbuf->add(), stream, sizeof(uint8_t) * len);
-	memcpy(stream, dspman->cbuf->pop(), sizeof(uint8_t) * len);
+			// Wait for the sound card to make some room.
+			if(written < noSamples)
+				sleepUs(PLAYBACK_WAIT);
+		}
+	}
 
-	swr_free(&swr);
+	return NULL;
 }
 
-bool visualiserWin::play(std::string &file)
+void visualiserWin::audioCallback(void* udata, uint8_t* stream, int len)
 {
-	if(MPDMode)
-	{
-		mpdargst *args = new mpdargst;
-		args->dspman = dspman;
-		args->file = MPDFile;
-		args->win = this;
-		ffmpegworkerthread = new pthread_t;
-		pthread_create(ffmpegworkerthread, NULL, MPDWorkerEntry, args);
-		return true;
-	}
-	//Initalise ffmpeg.
-	av_register_all();
+	visualiserWin* win = static_cast<visualiserWin*>(udata);
+	DSPManager* dspman = win->dspman;
+	int channels = win->playbackChannels;
+	int noSamples = len / sizeof(int16_t);
+	int16_t* out = (int16_t*)stream;
+
+	// Play silence if the decoder has fallen behind or the
+	// source has finished.
+	int available = (win->playbackBuffer->size() / channels) * channels;
+	if(available > noSamples)
+		available = noSamples;
+	int got = win->playbackBuffer->read(out, available);
+	memset(out + got, 0, sizeof(int16_t) * (noSamples - got));
 
-	//Attempt to open the file.
-	AVFormatContext* fmtCtx = NULL;
+	dspman->processAudioPCM(NULL, stream, len);
 
-	if(avformat_open_input(&fmtCtx, file.c_str(), NULL, NULL) != 0)
+	// Push the samples through the delay line. After writing, everything
+	// in the buffer beyond this callback's samples is the current delay.
+	dspman->cbuf->write(out, noSamples);
+	int delay = dspman->cbuf->size() - noSamples;
+
+	// Move towards the delay that the latency manager wants. The change
+	// is limited to a quarter of a callback at a time and kept to whole
+	// frames so the channels don't get swapped.
+	int adjust = dspman->getLatencyManager()->getDelaySamples() - delay;
+	int maxAdjust = ((noSamples / 4) / channels) * channels;
+	if(adjust > maxAdjust)
+		adjust = maxAdjust;
+	if(adjust < -maxAdjust)
+		adjust = -maxAdjust;
+
+	if(adjust > 0)
 	{
-		std::cerr << "Could not open file." << std::endl;
-		return false;
+		// Grow the delay by playing some silence first.
+		memset(out, 0, sizeof(int16_t) * adjust);
+		dspman->cbuf->read(out + adjust, noSamples - adjust);
 	}
-
-	if(avformat_find_stream_info(fmtCtx, NULL) < 0)
+	else
 	{
-		std::cerr << "Could not find stream information." << std::endl;
-		return false;
+		// Shrink the delay by dropping the oldest samples.
+		dspman->cbuf->commitRead(-adjust);
+		dspman->cbuf->read(out, noSamples);
 	}
+}
 
-	AVCodecContext* codecCtx;
-	int audioStream = -1;
-	for(int i = 0; i < fmtCtx->nb_streams; i++)
-	{
-		if(fmtCtx->streams[i]->codec->codec_type ==
-		   AVMEDIA_TYPE_AUDIO)
-		{
-			audioStream = i;
-			break;
-		}
-	}
+bool visualiserWin::play(std::string &file)
+{
+	if(MPDMode)
+		source = new fifoReader(MPDFile, MPDFormat);
+	else if(!shmName.empty())
+		source = new shmReader(shmName);
+	else if(useTestSignal)
+		source = new testSignal();
+	else
+		source = new audioDecoder(file);
 
-	if(audioStream == -1)
+	if(!source->open())
 	{
-		std::cerr << "Couldn't find audio stream." << std::endl;
+		std::cerr << "Could not open the audio source." << std::endl;
+		delete source;
+		source = NULL;
+		signalError();
 		return false;
 	}
 
-	codecCtx = fmtCtx->streams[audioStream]->codec;
+	// Let the DSP plugins use the analysis cache for this track.
+	uint64_t trackHash = source->getTrackHash();
+	if(!cacheDir.empty() && trackHash)
+		dspman->setTrack(trackHash, cacheDir);
 
-	AVCodec *codec;
-	codec = avcodec_find_decoder(codecCtx->codec_id);
-	if(!codec)
+	// Audio that is being heard somewhere else goes straight to the
+	// DSP plugins, in fixed size blocks however it arrives.
+	if(source->getMode() == AUDIO_SOURCE_PUSH)
 	{
-		std::cerr << "Could not find codec!" << std::endl;
-		return false;
+		feeder = new sourceFeeder(source, dspman, INPUT_BLOCK_FRAMES);
+		feeder->start();
+		return true;
 	}
-	avcodec_open2(codecCtx, codec, NULL);
 
 	SDL_AudioSpec wantedSpec;
 	SDL_AudioSpec gotSpec;
 
-	packetQueue* queue = new packetQueue;
-
-	sdlargst* SDLArgs = new sdlargst;
-
-	SDLArgs->avcodeccontext = codecCtx;
-	SDLArgs->queue = queue;
-	SDLArgs->dspman = dspman;
-
-	wantedSpec.freq = codecCtx->sample_rate;
+	wantedSpec.freq = source->getFormat().sampleRate;
 	wantedSpec.format = AUDIO_S16SYS;
-	wantedSpec.channels = codecCtx->channels;
+	wantedSpec.channels = source->getFormat().channels;
 	wantedSpec.silence = 0;
 	wantedSpec.samples = 1024;
-	wantedSpec.callback = audioThreadEntryPoint;
-	wantedSpec.userdata = (void*)SDLArgs;
+	wantedSpec.callback = audioCallback;
+	wantedSpec.userdata = (void*)this;
 
 	if(SDL_OpenAudio(&wantedSpec, &gotSpec) < 0)
 	{
@@ -525,20 +615,31 @@ bool visualiserWin::play(std::string &file)
 		return false;
 	}
 
-	SDL_PauseAudio(0);
-
-	//Construct worker thread arguments.
-	ffmpegargst* args = new ffmpegargst;
-	args->audiostream = audioStream;
-	args->avformatcontext = fmtCtx;
-	args->queue = queue;
-
-	//Begin ffmpeg worker thread.
-	ffmpegworkerthread = new pthread_t;
+	// The sound card may not support the source's format.
+	if(!source->setOutputFormat(gotSpec.freq, gotSpec.channels))
+	{
+		std::cerr << "Could not convert the audio for the sound card." << std::endl;
+		SDL_CloseAudio();
+		return false;
+	}
 
-	//Run the thread.
-	pthread_create(ffmpegworkerthread, NULL, ffmpegWorkerEntry, args);
+	playbackChannels = gotSpec.channels;
+	playbackBuffer = new circularBuffer::circularBuffer<int16_t>(
+		PLAYBACK_BUFFER_FRAMES * gotSpec.channels);
+
+	// Create the delay line, large enough for the longest delay
+	// and a callback's worth of samples.
+	int maxDelaySamples = gotSpec.freq * gotSpec.channels * MAX_AUDIO_DELAY;
+	dspman->cbuf = new circularBuffer::circularBuffer<int16_t>(
+		maxDelaySamples + (gotSpec.samples * gotSpec.channels));
+	dspman->getLatencyManager()->setAudioFormat(gotSpec.freq, gotSpec.channels,
+	                                            gotSpec.samples, maxDelaySamples);
+	dspman->setAudioFormat(gotSpec.freq, gotSpec.channels);
+
+	// Start decoding, then the sound.
+	decodeThread = new pthread_t;
+	pthread_create(decodeThread, NULL, decodeThreadEntry, this);
+	SDL_PauseAudio(0);
 
-	// Also run the sound.
-	return false;
+	return true;
 }
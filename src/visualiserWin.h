@@ -26,34 +26,19 @@
 
 #include <SDL/SDL_video.h>
 #include <SDL/SDL_events.h>
-#include <set>
+#include <vector>
 #include <string>
-#include "packetqueue.h"
+#include <pthread.h>
+#include <stdint.h>
+#include "pcmFormat.h"
+#include "circularBuffer.h"
 class visualiser;
 class DSPManager;
 class eventHandler;
 class visualiserWin;
-
-struct ffmpegargst
-{
-	void* avformatcontext;
-	int audiostream;
-	packetQueue* queue;
-};
-
-struct sdlargst
-{
-	void* avcodeccontext;
-	packetQueue* queue;
-	DSPManager* dspman;
-};
-
-struct mpdargst
-{
-	DSPManager* dspman;
-	std::string file;
-	visualiserWin* win;
-};
+class audioSource;
+class sourceFeeder;
+class frameScheduler;
 
 /**
  * A visualiser window.
@@ -126,6 +111,15 @@ class visualiserWin
 		 */
 		void registerEventHandler(eventHandler* eH);
 
+		/**
+		 * Stop an event handler from being called. The window no
+		 * longer owns it, so it is up to the caller to delete it.
+		 * Handlers may register and unregister handlers, including
+		 * themselves, from handleEvent().
+		 * @param eH the event handler to unregister.
+		 */
+		void unregisterEventHandler(eventHandler* eH);
+
 		/**
 		 * This is the main event loop for the window.
 		 * It is implemented in the base class to abstract
@@ -169,6 +163,22 @@ class visualiserWin
 		 */
 		DSPManager* getDSPManager() const;
 
+		/**
+		 * Get the time that the frame currently being drawn is
+		 * expected to be shown on the screen. Pass this to
+		 * DSP::getDSPDataAt() to get the data for the audio that
+		 * is heard at the same time.
+		 * @returns the time in microseconds, from monotonicTimeUs().
+		 */
+		uint64_t getFrameTime() const;
+
+		/**
+		 * Get the scheduler that paces the frames, eg to find out
+		 * how much time there is to draw a frame.
+		 * @returns a pointer to this window's frame scheduler.
+		 */
+		frameScheduler* getFrameScheduler() const;
+
 		/**
 		 * the width and height of the window.
 		 */
@@ -187,17 +197,58 @@ class visualiserWin
 		 */
 		void initialiseStockEventHandlers();
 
+		/**
+		 * The decode thread entry point. This reads a source that is
+		 * played through the sound card into the playback buffer.
+		 */
+		static void* decodeThreadEntry(void* arg);
+
+		/**
+		 * Give the visualiser any spare time and handle events until
+		 * the next frame is due.
+		 */
+		void waitForNextFrame();
+
+		/**
+		 * The SDL audio callback, it plays the playback buffer
+		 * through the delay line.
+		 */
+		static void audioCallback(void* udata, uint8_t* stream, int len);
+
 		SDL_Surface* drawContext;
 		int desiredFrameRate;
+
+		// The quality level to draw at, 0 to let the visualiser
+		// adjust its own.
+		int fixedQuality;
 		bool shouldVsync;
 		bool shouldCloseWindow;
 		bool mpdError;
 		visualiser* currentVis;
 		DSPManager* dspman;
-		std::set<eventHandler*> eventHandlers;
-		pthread_t* ffmpegworkerthread;
+
+		// The registered event handlers for each type of event.
+		std::vector<eventHandler*> eventHandlers[SDL_NUMEVENTS];
 		bool MPDMode;
 		std::string MPDFile;
+		pcmFormat MPDFormat;
+		std::string shmName;
+		bool useTestSignal;
+
+		// Where the audio comes from.
+		audioSource* source;
+
+		// Passes a source that isn't played by us to the DSP plugins.
+		sourceFeeder* feeder;
+
+		// Audio decoded ahead of the sound card.
+		circularBuffer::circularBuffer<int16_t>* playbackBuffer;
+		pthread_t* decodeThread;
+		bool playbackStopped;
+		int playbackChannels;
+		std::string cacheDir;
+		uint64_t frameTime;
+		frameScheduler* scheduler;
 };
 
 #endif
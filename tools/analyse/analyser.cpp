@@ -0,0 +1,315 @@
+/****************************************
+ *
+ * analyser.cpp
+ * Define the batch analyser.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <ctype.h>
+#include <math.h>
+#include <stdint.h>
+#include <iostream>
+#include <algorithm>
+#include <audioDecoder.h>
+#include <dsp/fft.h>
+#include "analyser.h"
+
+static const char* audioExtensions[] = {
+	"mp3", "flac", "ogg", "oga", "opus", "wav", "m4a", "aac",
+	"wma", "aif", "aiff", "ape", "wv", "mpc", NULL
+};
+
+analyser::analyser(const std::string& cacheDir, int noThreads, int noSampleSets)
+{
+	this->cacheDir = cacheDir;
+	this->noThreads = noThreads < 1 ? 1 : noThreads;
+	this->noSampleSets = noSampleSets;
+	nextTrack = 0;
+	noDone = 0;
+	queueMutex = new pthread_mutex_t;
+	pthread_mutex_init(queueMutex, NULL);
+}
+
+analyser::~analyser()
+{
+	pthread_mutex_destroy(queueMutex);
+	delete queueMutex;
+}
+
+bool analyser::isAudioFile(const std::string& name)
+{
+	size_t dot = name.rfind('.');
+	if(dot == std::string::npos)
+		return false;
+
+	std::string ext = name.substr(dot + 1);
+	for(size_t i = 0; i < ext.size(); i++)
+		ext[i] = tolower(ext[i]);
+
+	for(int i = 0; audioExtensions[i]; i++)
+		if(ext == audioExtensions[i])
+			return true;
+
+	return false;
+}
+
+bool analyser::addPath(const std::string& path)
+{
+	struct stat st;
+	if(stat(path.c_str(), &st) != 0)
+		return false;
+
+	if(!S_ISDIR(st.st_mode))
+	{
+		trackSummary track;
+		track.file = path;
+		track.analysed = false;
+		track.duration = 0;
+		track.bpm = 0;
+		track.loudness = 0;
+		tracks.push_back(track);
+		return true;
+	}
+
+	DIR* dir = opendir(path.c_str());
+	if(!dir)
+		return false;
+
+	// Sort the entries so the tracks are always in the same order.
+	std::vector<std::string> names;
+	struct dirent* entry;
+	while((entry = readdir(dir)) != NULL)
+	{
+		std::string name(entry->d_name);
+		if(name.empty() || name[0] == '.')
+			continue;
+		names.push_back(name);
+	}
+	closedir(dir);
+	std::sort(names.begin(), names.end());
+
+	for(size_t i = 0; i < names.size(); i++)
+	{
+		std::string child = path + "/" + names[i];
+		if(stat(child.c_str(), &st) != 0)
+			continue;
+		if(S_ISDIR(st.st_mode) || isAudioFile(names[i]))
+			addPath(child);
+	}
+
+	return true;
+}
+
+size_t analyser::getNoTracks() const
+{
+	return tracks.size();
+}
+
+const std::vector<trackSummary>& analyser::getSummaries() const
+{
+	return tracks;
+}
+
+void analyser::run()
+{
+	nextTrack = 0;
+	noDone = 0;
+
+	std::vector<pthread_t> workers(noThreads);
+	for(int i = 0; i < noThreads; i++)
+		pthread_create(&workers[i], NULL, workerEntry, this);
+
+	for(int i = 0; i < noThreads; i++)
+		pthread_join(workers[i], NULL);
+}
+
+void* analyser::workerEntry(void* arg)
+{
+	static_cast<analyser*>(arg)->work();
+	return NULL;
+}
+
+void analyser::work()
+{
+	while(true)
+	{
+		pthread_mutex_lock(queueMutex);
+		if(nextTrack == tracks.size())
+		{
+			pthread_mutex_unlock(queueMutex);
+			return;
+		}
+		trackSummary* track = &tracks[nextTrack++];
+		pthread_mutex_unlock(queueMutex);
+
+		track->analysed = analyseTrack(track);
+
+		pthread_mutex_lock(queueMutex);
+		noDone++;
+		std::cerr << "[" << noDone << "/" << tracks.size() << "] "
+		          << (track->analysed ? "" : "failed: ")
+		          << track->file << std::endl;
+		pthread_mutex_unlock(queueMutex);
+	}
+}
+
+bool analyser::analyseTrack(trackSummary* track)
+{
+	audioDecoder decoder(track->file);
+	if(!decoder.open())
+		return false;
+
+	int sampleRate = decoder.getFormat().sampleRate;
+	int channels = decoder.getFormat().channels;
+	if(sampleRate <= 0)
+		return false;
+
+	// A FFT for each track, as the format can change between tracks.
+	// Its plans come from the plan cache so this is cheap.
+	FFT fft(noSampleSets);
+	if(!cacheDir.empty())
+		fft.setTrack(decoder.getTrackHash(), cacheDir);
+
+	std::vector<int16_t> buffer(ANALYSER_BLOCK_FRAMES * channels);
+	std::vector<float> onsets;
+	double sumSquares = 0;
+	uint64_t position = 0;
+	int SEQ = 0;
+
+	while(true)
+	{
+		int noFrames = decoder.read(&buffer[0], ANALYSER_BLOCK_FRAMES);
+		if(noFrames == 0)
+			break;
+
+		int noSamples = noFrames * channels;
+		for(int i = 0; i < noSamples; i++)
+			sumSquares += (double)buffer[i] * buffer[i];
+
+		// The FFT and the cache work on whole blocks, so pad the
+		// last one with silence.
+		for(int i = noSamples; i < (int)buffer.size(); i++)
+			buffer[i] = 0;
+
+		PCMBlock block;
+		block.data = &buffer[0];
+		block.dataLength = buffer.size();
+		block.SEQ = SEQ++;
+		block.sampleRate = sampleRate;
+		block.channels = channels;
+		block.layout = pcmLayoutFor(channels);
+		block.noFrames = ANALYSER_BLOCK_FRAMES;
+		block.samplePosition = position;
+		block.presentationTime = (position * 1000000) / sampleRate;
+
+		// Let the FFT split the channels out itself.
+		for(int i = 0; i < PCM_MAX_CHANNELS; i++)
+			block.planes[i] = NULL;
+		fft.processPCMBlock(&block);
+
+		FFTData* data = (FFTData*)fft.getDSPData();
+		if(data)
+		{
+			onsets.push_back(data->onset);
+			fft.relenquishDSPData();
+		}
+
+		position += noFrames;
+	}
+
+	// Finish off the cache file.
+	fft.setTrack(0, "");
+
+	if(position == 0)
+		return false;
+
+	track->duration = (double)position / sampleRate;
+
+	double meanSquare = sumSquares / ((double)position * channels);
+	track->loudness = meanSquare > 0 ? 10 * log10(meanSquare / (32768.0 * 32768.0)) :
+	                                   -INFINITY;
+
+	track->bpm = estimateBPM(onsets, (double)sampleRate / ANALYSER_BLOCK_FRAMES);
+	return true;
+}
+
+double analyser::estimateBPM(const std::vector<float>& onsets,
+                             double blocksPerSecond)
+{
+	int minLag = (int)floor((60 * blocksPerSecond) / ANALYSER_MAX_BPM);
+	int maxLag = (int)ceil((60 * blocksPerSecond) / ANALYSER_MIN_BPM);
+	int n = onsets.size();
+	if(minLag < 1)
+		minLag = 1;
+	if(n < maxLag * 4)
+		return 0;
+
+	double mean = 0;
+	for(int i = 0; i < n; i++)
+		mean += onsets[i];
+	mean /= n;
+
+	// Autocorrelate the onset strength over the lags that fall in
+	// the tempo range, with one more either side for interpolation.
+	std::vector<double> corr(maxLag + 2, 0);
+	for(int lag = minLag - 1; lag <= maxLag + 1; lag++)
+	{
+		if(lag < 1)
+			continue;
+		double sum = 0;
+		for(int i = lag; i < n; i++)
+			sum += (onsets[i] - mean) * (onsets[i - lag] - mean);
+		corr[lag] = sum / (n - lag);
+	}
+
+	int best = minLag;
+	for(int lag = minLag; lag <= maxLag; lag++)
+		if(corr[lag] > corr[best])
+			best = lag;
+
+	if(corr[best] <= 0)
+		return 0;
+
+	// The autocorrelation also peaks at multiples of the beat, which
+	// can come out on top when the beat doesn't fall on a whole number
+	// of blocks. Prefer half the lag if it is nearly as strong.
+	while(best / 2 >= minLag)
+	{
+		int half = best / 2;
+		if(corr[half + 1] > corr[half])
+			half++;
+		if(corr[half] < corr[best] * 0.5)
+			break;
+		best = half;
+	}
+
+	// Fit a parabola through the peak to get a fractional lag.
+	double lag = best;
+	double a = corr[best - 1];
+	double b = corr[best];
+	double c = corr[best + 1];
+	double denom = a - (2 * b) + c;
+	if(best > 1 && denom < 0)
+		lag += (0.5 * (a - c)) / denom;
+
+	return (60 * blocksPerSecond) / lag;
+}
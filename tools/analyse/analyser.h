@@ -0,0 +1,144 @@
+/****************************************
+ *
+ * analyser.h
+ * Declare the batch analyser.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _ANALYSER_H_
+#define _ANALYSER_H_
+
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+// The number of frames given to the FFT at a time, the same as the
+// size of the audio buffer that the visualiser window asks for.
+#define ANALYSER_BLOCK_FRAMES 1024
+
+// The range of tempos that are searched for.
+#define ANALYSER_MIN_BPM 60
+#define ANALYSER_MAX_BPM 200
+
+/**
+ * The summary of a track once it has been analysed.
+ */
+typedef struct
+{
+	std::string file;
+	bool analysed;
+
+	// The length of the track in seconds.
+	double duration;
+
+	// The estimated tempo in beats per minute.
+	double bpm;
+
+	// The RMS level of the whole track in dBFS.
+	double loudness;
+}trackSummary;
+
+/**
+ * Analyse lots of tracks at once, writing their analysis cache files
+ * and working out a summary of each one.
+ *
+ * Each worker thread decodes its own tracks and runs the same FFT plugin
+ * as the visualisers, so the cache files are the same as if the tracks
+ * had been played.
+ */
+class analyser
+{
+	public:
+		/**
+		 * Create an analyser.
+		 * @param cacheDir where to write the cache files, if this is
+		 * empty only the summaries are worked out.
+		 * @param noThreads the number of worker threads.
+		 * @param noSampleSets the number of blocks the FFT is run over,
+		 * this must match the visualisers that will use the cache.
+		 */
+		analyser(const std::string& cacheDir, int noThreads, int noSampleSets);
+		virtual ~analyser();
+
+		/**
+		 * Add a file, or every audio file below a directory.
+		 * @returns false if the path couldn't be read.
+		 */
+		bool addPath(const std::string& path);
+
+		/**
+		 * @returns the number of tracks that will be analysed.
+		 */
+		size_t getNoTracks() const;
+
+		/**
+		 * Analyse all of the tracks, returning once they are done.
+		 */
+		void run();
+
+		/**
+		 * @returns the summary of each track, in the order they
+		 * were added.
+		 */
+		const std::vector<trackSummary>& getSummaries() const;
+
+	private:
+		static void* workerEntry(void* arg);
+
+		/**
+		 * Take tracks from the queue and analyse them until there
+		 * are none left.
+		 */
+		void work();
+
+		/**
+		 * Decode a track and run it through the FFT.
+		 * @returns false if the track couldn't be decoded.
+		 */
+		bool analyseTrack(trackSummary* track);
+
+		/**
+		 * Estimate the tempo from the autocorrelation of the onset
+		 * strength.
+		 * @param onsets the onset strength of each block.
+		 * @param blocksPerSecond the rate of the onset strengths.
+		 * @returns the tempo in beats per minute or 0 if there isn't
+		 * enough to go on.
+		 */
+		static double estimateBPM(const std::vector<float>& onsets,
+		                          double blocksPerSecond);
+
+		/**
+		 * @returns true if the file name has an audio extension.
+		 */
+		static bool isAudioFile(const std::string& name);
+
+		std::string cacheDir;
+		int noThreads;
+		int noSampleSets;
+
+		std::vector<trackSummary> tracks;
+
+		// The next track for a worker to take and the number done.
+		size_t nextTrack;
+		size_t noDone;
+		pthread_mutex_t* queueMutex;
+};
+
+#endif
@@ -0,0 +1,134 @@
+/****************************************
+ *
+ * main.cpp
+ * Analyse a music library ahead of time.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <stdlib.h>
+#include <unistd.h>
+#include "analyser.h"
+
+void usage(const char* fileName, const char* error = NULL)
+{
+	if(error)
+		std::cout << error << std::endl;
+	std::cout << "Usage: " << fileName
+	          << " [-C CACHE_DIR] [-j THREADS] [-b SAMPLE_SETS] [-o SUMMARY]"
+	          << " PATH..." << std::endl;
+	std::cout << "  -C CACHE_DIR   Write the analysis cache files to CACHE_DIR." << std::endl
+	          << "  -j THREADS     Analyse THREADS tracks at once, default is the"
+	          << " number of CPUs." << std::endl
+	          << "  -b SAMPLE_SETS The number of blocks the FFT is run over, this"
+	          << " must match the visualiser, default 1." << std::endl
+	          << "  -o SUMMARY     Write the summary to SUMMARY rather than stdout."
+	          << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	std::string cacheDir;
+	std::string summaryFile;
+	int noThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	int noSampleSets = 1;
+
+	int opt;
+	while((opt = getopt(argc, argv, "C:j:b:o:h")) != -1)
+	{
+		switch(opt)
+		{
+			case 'C':
+				cacheDir = optarg;
+				break;
+			case 'j':
+				noThreads = atoi(optarg);
+				if(noThreads < 1)
+				{
+					usage(argv[0], "Invalid number of threads.");
+					return EXIT_FAILURE;
+				}
+				break;
+			case 'b':
+				noSampleSets = atoi(optarg);
+				if(noSampleSets < 1)
+				{
+					usage(argv[0], "Invalid number of sample sets.");
+					return EXIT_FAILURE;
+				}
+				break;
+			case 'o':
+				summaryFile = optarg;
+				break;
+			default:
+				usage(argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+
+	if(optind >= argc)
+	{
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if(noThreads < 1)
+		noThreads = 1;
+
+	analyser a(cacheDir, noThreads, noSampleSets);
+	for(int i = optind; i < argc; i++)
+		if(!a.addPath(argv[i]))
+			std::cerr << "Could not read " << argv[i] << std::endl;
+
+	a.run();
+
+	std::ofstream summaryStream;
+	if(!summaryFile.empty())
+	{
+		summaryStream.open(summaryFile.c_str());
+		if(!summaryStream)
+		{
+			std::cerr << "Could not open " << summaryFile << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+	std::ostream& out = summaryFile.empty() ? std::cout : summaryStream;
+
+	// One tab separated line per track.
+	const std::vector<trackSummary>& tracks = a.getSummaries();
+	int noFailed = 0;
+	out << "# bpm\tloudness_dbfs\tduration_s\tfile" << std::endl;
+	out << std::fixed;
+	for(size_t i = 0; i < tracks.size(); i++)
+	{
+		if(!tracks[i].analysed)
+		{
+			noFailed++;
+			continue;
+		}
+		out << std::setprecision(1) << tracks[i].bpm << "\t"
+		    << tracks[i].loudness << "\t"
+		    << tracks[i].duration << "\t"
+		    << tracks[i].file << std::endl;
+	}
+
+	return noFailed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,184 @@
+/****************************************
+ *
+ * main.cpp
+ * Time the FFT with different numbers of threads.
+ *
+ * This file is part of mattulizer.
+ *
+ * Copyright 2014 (c) Matthew Leach.
+ *
+ * Mattulizer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Mattulizer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Mattulizer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <stdlib.h>
+#include <unistd.h>
+#include <dsp/fftPlanCache.h>
+#include <util/clock.h>
+
+void usage(const char* fileName, const char* error = NULL)
+{
+	if(error)
+		std::cout << error << std::endl;
+	std::cout << "Usage: " << fileName
+	          << " [-j THREADS] [-s MIN_SIZE] [-S MAX_SIZE] [-T MS]" << std::endl;
+	std::cout << "  -j THREADS  The most threads to try, default is the number"
+	          << " of CPUs." << std::endl
+	          << "  -s MIN_SIZE The smallest transform, default 256." << std::endl
+	          << "  -S MAX_SIZE The largest transform, default 262144." << std::endl
+	          << "  -T MS       How long to time each one for, default 200ms."
+	          << std::endl;
+}
+
+/**
+ * Time a real to complex transform of n points.
+ * @returns the mean time of a transform in microseconds.
+ */
+double timeTransform(int n, int noThreads, uint64_t duration)
+{
+	fftPlanCache::setThreads(noThreads, 0);
+	fftw_plan plan = fftPlanCache::getR2C(n);
+
+	double* in = (double*)fftw_malloc(sizeof(double) * n);
+	fftw_complex* out = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * ((n / 2) + 1));
+	for(int i = 0; i < n; i++)
+		in[i] = (rand() / (double)RAND_MAX) - 0.5;
+
+	// Once to warm the caches and start the threads.
+	fftw_execute_dft_r2c(plan, in, out);
+
+	uint64_t start = monotonicTimeUs();
+	uint64_t elapsed = 0;
+	int count = 0;
+	while(elapsed < duration)
+	{
+		fftw_execute_dft_r2c(plan, in, out);
+		count++;
+		elapsed = monotonicTimeUs() - start;
+	}
+
+	fftw_free(in);
+	fftw_free(out);
+	return (double)elapsed / count;
+}
+
+int main(int argc, char* argv[])
+{
+	int maxThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	int minSize = 256;
+	int maxSize = 262144;
+	uint64_t duration = 200000;
+
+	int opt;
+	while((opt = getopt(argc, argv, "j:s:S:T:h")) != -1)
+	{
+		switch(opt)
+		{
+			case 'j':
+				maxThreads = atoi(optarg);
+				if(maxThreads < 1)
+				{
+					usage(argv[0], "Invalid number of threads.");
+					return EXIT_FAILURE;
+				}
+				break;
+			case 's':
+				minSize = atoi(optarg);
+				break;
+			case 'S':
+				maxSize = atoi(optarg);
+				break;
+			case 'T':
+				duration = (uint64_t)atoi(optarg) * 1000;
+				break;
+			default:
+				usage(argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+
+	if(minSize < 2 || maxSize < minSize)
+	{
+		usage(argv[0], "Invalid transform sizes.");
+		return EXIT_FAILURE;
+	}
+
+	if(maxThreads > 1 && !fftPlanCache::setThreads(maxThreads))
+	{
+		std::cerr << "FFTW wasn't built with threads, only timing one thread."
+		          << std::endl;
+		maxThreads = 1;
+	}
+
+	// Try doubling numbers of threads and the most asked for.
+	std::vector<int> threadCounts;
+	for(int t = 1; t < maxThreads; t *= 2)
+		threadCounts.push_back(t);
+	threadCounts.push_back(maxThreads);
+
+	// One tab separated line per size, the time of a transform in
+	// microseconds for each number of threads.
+	std::cout << "# size";
+	for(size_t t = 0; t < threadCounts.size(); t++)
+		std::cout << "\t" << threadCounts[t] << "_threads_us";
+	std::cout << "\tbest_threads" << std::endl;
+	std::cout << std::fixed << std::setprecision(1);
+
+	// The smallest size from which threads were always quicker.
+	int crossover = 0;
+	for(int n = minSize; n <= maxSize; n *= 2)
+	{
+		std::cout << n;
+		double single = 0;
+		double best = 0;
+		int bestThreads = 1;
+		for(size_t t = 0; t < threadCounts.size(); t++)
+		{
+			double us = timeTransform(n, threadCounts[t], duration);
+			std::cout << "\t" << us;
+			if(t == 0)
+				single = us;
+			if(t == 0 || us < best)
+			{
+				best = us;
+				bestThreads = threadCounts[t];
+			}
+		}
+		std::cout << "\t" << bestThreads << std::endl;
+
+		// Count threads as quicker if they save a tenth of the time.
+		if(bestThreads > 1 && best < single * 0.9)
+		{
+			if(crossover == 0)
+				crossover = n;
+		}
+		else
+		{
+			crossover = 0;
+		}
+	}
+
+	if(crossover)
+		std::cout << "# Threads help from " << crossover << " points, the default"
+		          << " threshold is " << FFT_PLAN_THREAD_THRESHOLD << "." << std::endl;
+	else
+		std::cout << "# Threads didn't help up to " << maxSize << " points."
+		          << std::endl;
+	std::cout << "# The FFT plugin's transforms are the block length times the"
+	          << " number of sample sets." << std::endl;
+
+	return EXIT_SUCCESS;
+}